@@ -2,11 +2,17 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <memory>
+#include <sstream>
 
 #include "miniml/Context.h"
 #include "miniml/BytecodeFile.h"
+#include "miniml/CodeAnalysis.h"
+#include "miniml/DebugInfo.h"
+#include "miniml/Opcode.h"
 #include "miniml/Value.h"
 #include "minirt/Runtime.h"
 using namespace miniml;
@@ -29,6 +35,210 @@ static void dumpStrings(Context &, Section *section) {
   }
 }
 
+// -----------------------------------------------------------------------------
+static void dumpDebug(Context &ctx, Section *section) {
+  DebugInfo debug(ctx, section);
+  for (size_t i = 0, n = debug.size(); i < n; ++i) {
+    SourceLocation loc;
+    const uint64_t pc = debug.getEvent(i, loc);
+    std::cout << "  " << pc << ": " << loc.module;
+    if (*loc.def) {
+      std::cout << " " << loc.def;
+    }
+    std::cout << " " << loc.file << ":" << loc.line << ":"
+              << loc.startChar << "-" << loc.endChar << std::endl;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+static void printInstruction(
+    const uint32_t *code,
+    uint64_t pc,
+    const std::vector<std::string> &prims)
+{
+  auto target = [code](uint64_t base, uint64_t ofs) {
+    return base + static_cast<int32_t>(code[ofs]);
+  };
+  auto prim = [&prims](uint32_t p) {
+    return p < prims.size() ? prims[p] : "<" + std::to_string(p) + ">";
+  };
+
+  const uint32_t op = code[pc];
+  std::cout << std::setw(8) << pc << "  " << getOpcodeName(op);
+  switch (op) {
+    case BRANCH: case BRANCHIF: case BRANCHIFNOT:
+    case PUSHTRAP: case PUSH_RETADDR: {
+      std::cout << " @" << target(pc + 1, pc + 1);
+      break;
+    }
+    case BEQ: case BNEQ: case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+    case BULTINT: case BUGEINT: {
+      std::cout << " " << static_cast<int32_t>(code[pc + 1]);
+      std::cout << ", @" << target(pc + 2, pc + 2);
+      break;
+    }
+    case CLOSURE: {
+      std::cout << " " << code[pc + 1] << ", @" << target(pc + 2, pc + 2);
+      break;
+    }
+    case CLOSUREREC: {
+      std::cout << " " << code[pc + 1] << ", " << code[pc + 2];
+      for (uint32_t i = 0; i < code[pc + 1]; ++i) {
+        std::cout << ", @" << target(pc + 3, pc + 3 + i);
+      }
+      break;
+    }
+    case SWITCH: {
+      const uint32_t n = code[pc + 1];
+      for (uint32_t i = 0; i < (n & 0xFFFF); ++i) {
+        std::cout << std::endl << "            int " << i << " -> @"
+                  << target(pc + 2, pc + 2 + i);
+      }
+      for (uint32_t i = 0; i < (n >> 16); ++i) {
+        std::cout << std::endl << "            tag " << i << " -> @"
+                  << target(pc + 2, pc + 2 + (n & 0xFFFF) + i);
+      }
+      break;
+    }
+    case C_CALL1: case C_CALL2: case C_CALL3: case C_CALL4: case C_CALL5: {
+      std::cout << " " << prim(code[pc + 1]);
+      break;
+    }
+    case C_CALLN: {
+      std::cout << " " << code[pc + 1] << ", " << prim(code[pc + 2]);
+      break;
+    }
+    case CONSTINT: case PUSHCONSTINT: case OFFSETINT: case OFFSETREF:
+    case OFFSETCLOSURE: case PUSHOFFSETCLOSURE: {
+      std::cout << " " << static_cast<int32_t>(code[pc + 1]);
+      break;
+    }
+    default: {
+      for (size_t i = 1, n = getInstructionLength(code, pc); i < n; ++i) {
+        std::cout << (i == 1 ? " " : ", ") << code[pc + i];
+      }
+      break;
+    }
+  }
+  std::cout << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+static void dumpCode(Context &ctx, BytecodeFile &file, Section *section) {
+  const uint32_t *code = reinterpret_cast<const uint32_t *>(section->getData());
+  const size_t size = section->getSize() / sizeof(uint32_t);
+
+  std::vector<std::string> prims;
+  if (auto primSection = file.findSection(PRIM)) {
+    MemoryStreamReader stream(primSection->getData(), primSection->getSize());
+    while (!stream.eof()) {
+      prims.push_back(stream.getString());
+    }
+  }
+
+  DebugInfo debug(ctx, file.findSection(DBUG));
+  CodeAnalysis analysis(code, size);
+  const auto &functions = analysis.getFunctions();
+
+  std::map<uint64_t, const FunctionInfo *> entries;
+  for (const auto &fn : functions) {
+    entries[fn.entry] = &fn;
+  }
+
+  // Names functions after their first debug event.
+  auto name = [&](const FunctionInfo &fn) {
+    std::ostringstream os;
+    os << "@" << fn.entry;
+    auto next = entries.upper_bound(fn.entry);
+    const uint64_t end = next == entries.end() ? size : next->first;
+    SourceLocation loc;
+    if (debug.findFirst(fn.entry, end, loc)) {
+      os << " " << (*loc.def ? loc.def : loc.module);
+      os << " (" << loc.file << ":" << loc.line << ")";
+    }
+    return os.str();
+  };
+
+  // Listing, with function entries and basic blocks.
+  std::vector<uint64_t> mix(kNumOpcodes + 1, 0);
+  size_t count = 0;
+  for (uint64_t pc = 0; pc < size; pc += getInstructionLength(code, pc)) {
+    auto it = entries.find(pc);
+    if (it != entries.end()) {
+      std::cout << std::endl << "function " << name(*it->second) << ":";
+      std::cout << std::endl;
+    }
+    if (analysis.isLeader(pc)) {
+      std::cout << "  L" << pc << ":" << std::endl;
+    }
+    printInstruction(code, pc, prims);
+    mix[std::min<uint32_t>(code[pc], kNumOpcodes)] += 1;
+    count += 1;
+  }
+
+  // Call graph, through statically known closures.
+  std::cout << std::endl << "Call graph:" << std::endl;
+  for (const auto &fn : functions) {
+    std::cout << "  " << name(fn) << std::endl;
+    for (uint64_t callee : fn.callees) {
+      std::cout << "    calls @" << callee << std::endl;
+    }
+    for (uint64_t closure : fn.closures) {
+      std::cout << "    allocates @" << closure << std::endl;
+    }
+  }
+
+  // Static statistics.
+  size_t closures = 0;
+  for (uint64_t pc = 0; pc < size; pc += getInstructionLength(code, pc)) {
+    if (code[pc] == CLOSURE || code[pc] == CLOSUREREC) {
+      closures += 1;
+    }
+  }
+  std::cout << std::endl << "Statistics:" << std::endl;
+  std::cout << "  instructions: " << count << std::endl;
+  std::cout << "  functions: " << functions.size() << std::endl;
+  std::cout << "  closure allocations: " << closures << std::endl;
+
+  std::cout << "  functions by maximal stack depth:" << std::endl;
+  std::vector<const FunctionInfo *> byDepth;
+  for (const auto &fn : functions) {
+    byDepth.push_back(&fn);
+  }
+  std::stable_sort(
+      byDepth.begin(), byDepth.end(),
+      [](const FunctionInfo *a, const FunctionInfo *b) {
+        return a->maxDepth > b->maxDepth;
+      });
+  for (const auto *fn : byDepth) {
+    std::cout << "    " << std::setw(6) << fn->maxDepth << "  "
+              << fn->blocks.size() << " blocks, "
+              << fn->instructions << " instructions  " << name(*fn);
+    if (fn->inconsistent) {
+      std::cout << " [inconsistent stack]";
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << "  instruction mix:" << std::endl;
+  std::vector<std::pair<uint64_t, uint32_t>> ops;
+  for (uint32_t op = 0; op <= kNumOpcodes; ++op) {
+    if (mix[op]) {
+      ops.emplace_back(mix[op], op);
+    }
+  }
+  std::sort(ops.rbegin(), ops.rend());
+  for (const auto &op : ops) {
+    std::cout << "    " << std::setw(8) << op.first << "  "
+              << std::fixed << std::setprecision(2) << std::setw(6)
+              << 100.0 * op.first / count << "%  "
+              << getOpcodeName(op.second) << std::endl;
+  }
+}
+
+
 
 // -----------------------------------------------------------------------------
 int main(int argc, char **argv) {
@@ -52,7 +262,7 @@ int main(int argc, char **argv) {
 
         switch (section->getType()) {
         case CODE:
-          // TODO: code.
+          dumpCode(ctx, file, section);
           break;
         case PRIM: case DLLS: case DLPT:
           dumpStrings(ctx, section);
@@ -61,7 +271,10 @@ int main(int argc, char **argv) {
         case CRCS:
           dumpData(ctx, section);
           break;
-        case DBUG: case SYMB:
+        case DBUG:
+          dumpDebug(ctx, section);
+          break;
+        case SYMB:
           break;
         }
       }
@@ -2,9 +2,11 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <cstdlib>
 #include <iostream>
 #include <memory>
 #include <iomanip>
+#include <vector>
 
 #include "miniml/Context.h"
 #include "miniml/BytecodeFile.h"
@@ -28,13 +30,36 @@ int main(int argc, char **argv) {
     ctx.registerOperations(&int64_ops);
     ctx.registerOperations(&nativeint_ops);
 
+    // Sample allocations if MLMEMPROF is set to a sampling rate.
+    const char *memprofOut = getenv("MLMEMPROF_OUT");
+    if (const char *rate = getenv("MLMEMPROF")) {
+      const char *depth = getenv("MLMEMPROF_DEPTH");
+      ctx.startMemprof(atof(rate), depth ? atoi(depth) : 16);
+    }
+
+    // Sample the CPU if MLPROF is set to an interval in microseconds.
+    const char *profOut = getenv("MLPROF_OUT");
+    const bool profRaw = getenv("MLPROF_RAW") != nullptr;
+    if (const char *interval = getenv("MLPROF")) {
+      const char *depth = getenv("MLPROF_DEPTH");
+      ctx.startProfiler(atoll(interval), depth ? atoi(depth) : 64);
+    }
+
+    // Optimize programs and run them as register code unless MLNOOPT is set.
+    ctx.setOptimize(getenv("MLNOOPT") == nullptr);
+
+    // Files are kept alive for the debug information used in reports.
+    std::vector<std::unique_ptr<BytecodeFile>> files;
     for (int i = 1; i < argc; ++i) {
-      BytecodeFile file(argv[i]);
-      auto result = ctx.run(file);
+      files.emplace_back(new BytecodeFile(argv[i]));
+      auto result = ctx.run(*files.back());
       if (result != kUnit) {
         printValue(ctx, result, std::cerr);
       }
     }
+
+    ctx.writeMemprof(memprofOut ? memprofOut : "memprof");
+    ctx.writeProfile(profOut ? profOut : "cpuprof", profRaw);
     return EXIT_SUCCESS;
   } catch (std::exception &e) {
     std::cerr << "[Exception]: " << e.what() << std::endl;
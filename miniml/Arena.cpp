@@ -0,0 +1,148 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdint>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "miniml/Arena.h"
+using namespace miniml;
+
+
+/// Size of huge pages.
+static const size_t kHugePageSize = 2 << 20;
+
+/// Preferred node memory policy.
+static const int kPolicyPreferred = 1;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static size_t roundUp(size_t size, size_t align) {
+  return (size + align - 1) & ~(align - 1);
+}
+
+static void *mapAligned(size_t size, size_t align) {
+  // Over-allocate, then trim the unaligned ends.
+  void *ptr = mmap(
+      nullptr,
+      size + align,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (ptr == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto start = reinterpret_cast<uintptr_t>(ptr);
+  auto aligned = roundUp(start, align);
+  if (aligned > start) {
+    munmap(ptr, aligned - start);
+  }
+  if (aligned < start + align) {
+    munmap(reinterpret_cast<void *>(aligned + size),
+           start + align - aligned);
+  }
+  return reinterpret_cast<void *>(aligned);
+}
+
+static void bindToNode(void *ptr, size_t size, int node) {
+#ifdef SYS_mbind
+  if (node < 0 || node >= 64) {
+    return;
+  }
+  // Failures are ignored: the kernel places pages on its own.
+  unsigned long mask = 1ul << node;
+  syscall(
+      SYS_mbind,
+      ptr,
+      size,
+      kPolicyPreferred,
+      &mask,
+      sizeof(mask) * 8 + 1,
+      0);
+#else
+  (void) ptr;
+  (void) size;
+  (void) node;
+#endif
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Arena
+// -----------------------------------------------------------------------------
+void *miniml::allocArena(size_t &size, HugePageMode mode, int node) {
+  void *ptr = nullptr;
+
+#ifdef MAP_HUGETLB
+  if (mode == kHugePagesExplicit) {
+    size_t hugeSize = roundUp(size, kHugePageSize);
+    ptr = mmap(
+        nullptr,
+        hugeSize,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+        -1,
+        0);
+    if (ptr == MAP_FAILED) {
+      ptr = nullptr;
+      mode = kHugePagesTransparent;
+    } else {
+      size = hugeSize;
+    }
+  }
+#endif
+
+  if (ptr == nullptr) {
+    if (mode != kHugePagesOff && size >= kHugePageSize) {
+      size = roundUp(size, kHugePageSize);
+      ptr = mapAligned(size, kHugePageSize);
+#ifdef MADV_HUGEPAGE
+      if (ptr) {
+        madvise(ptr, size, MADV_HUGEPAGE);
+      }
+#endif
+    } else {
+      size = roundUp(size, sysconf(_SC_PAGESIZE));
+      ptr = mmap(
+          nullptr,
+          size,
+          PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS,
+          -1,
+          0);
+      if (ptr == MAP_FAILED) {
+        ptr = nullptr;
+      }
+    }
+  }
+
+  if (ptr) {
+    bindToNode(ptr, size, node);
+  }
+  return ptr;
+}
+
+void miniml::freeArena(void *start, size_t size) {
+  if (start) {
+    munmap(start, size);
+  }
+}
+
+int miniml::getCurrentNode() {
+#ifdef SYS_getcpu
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return node;
+  }
+#endif
+  return -1;
+}
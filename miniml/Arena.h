@@ -0,0 +1,31 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+
+
+
+namespace miniml {
+
+/// Page backing of heap arenas.
+enum HugePageMode {
+  kHugePagesOff         = 0,
+  kHugePagesTransparent = 1,
+  kHugePagesExplicit    = 2,
+};
+
+/// Maps an arena of at least size bytes, rounding size up to the page size.
+/// Explicit huge pages fall back to transparent ones if none are reserved.
+/// If node is not negative, the memory is preferably placed on that node.
+void *allocArena(size_t &size, HugePageMode mode, int node);
+
+/// Unmaps an arena.
+void freeArena(void *start, size_t size);
+
+/// Returns the NUMA node the calling thread runs on, or -1 if unknown.
+int getCurrentNode();
+
+} // namespace miniml
@@ -139,12 +139,19 @@ Section *BytecodeFile::getSection(unsigned i) const {
 }
 
 Section *BytecodeFile::getSection(SectionType type) const {
+  if (auto section = findSection(type)) {
+    return section;
+  }
+  throw std::runtime_error("Section type not found");
+}
+
+Section *BytecodeFile::findSection(SectionType type) const {
   for (const auto &section : sections_) {
     if (section->getType() == type) {
       return section;
     }
   }
-  throw std::runtime_error("Section type not found");
+  return nullptr;
 }
 
 
@@ -39,6 +39,9 @@ class BytecodeFile {
   /// Finds a section by type.
   Section *getSection(SectionType type) const;
 
+  /// Finds a section by type, returning null if it is missing.
+  Section *findSection(SectionType type) const;
+
  private:
   /// Pointer to the mmapped region.
   uint8_t *start_;
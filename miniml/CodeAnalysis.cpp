@@ -0,0 +1,390 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+
+#include "miniml/CodeAnalysis.h"
+#include "miniml/Opcode.h"
+using namespace miniml;
+
+
+/// Marker for values which are not known closures.
+static const uint64_t kUnknown = UINT64_MAX;
+
+
+
+// -----------------------------------------------------------------------------
+// CodeAnalysis
+// -----------------------------------------------------------------------------
+CodeAnalysis::CodeAnalysis(const uint32_t *code, size_t size)
+  : code_(code)
+  , size_(size)
+{
+  // Record the functions allocated together, to resolve OFFSETCLOSURE.
+  for (uint64_t pc = 0; pc < size_; pc += getInstructionLength(code_, pc)) {
+    switch (code_[pc]) {
+      case CLOSURE: {
+        const uint64_t entry = pc + 2 + static_cast<int32_t>(code_[pc + 2]);
+        groups_[entry] = { { entry }, 0 };
+        break;
+      }
+      case CLOSUREREC: {
+        std::vector<uint64_t> group;
+        const uint64_t ofs = pc + 3;
+        for (uint32_t i = 0, n = code_[pc + 1]; i < n; ++i) {
+          group.push_back(ofs + static_cast<int32_t>(code_[ofs + i]));
+        }
+        for (size_t i = 0; i < group.size(); ++i) {
+          groups_[group[i]] = { group, i };
+        }
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  findLeaders();
+  for (uint64_t entry : findFunctions(code_, size_)) {
+    if (entry >= size_) {
+      continue;
+    }
+    FunctionInfo fn;
+    fn.entry = entry;
+    fn.instructions = 0;
+    fn.maxDepth = 0;
+    fn.inconsistent = false;
+    analyse(fn);
+    for (const auto &block : fn.blocks) {
+      owner_.emplace(block.first, functions_.size());
+    }
+    functions_.push_back(std::move(fn));
+  }
+}
+
+const FunctionInfo *CodeAnalysis::findFunction(uint64_t pc) const {
+  auto it = owner_.upper_bound(pc);
+  if (it == owner_.begin()) {
+    return nullptr;
+  }
+  --it;
+  const FunctionInfo &fn = functions_[it->second];
+  return pc < fn.blocks.at(it->first).end ? &fn : nullptr;
+}
+
+bool CodeAnalysis::getTargets(
+    const uint32_t *code,
+    uint64_t pc,
+    std::vector<uint64_t> &targets)
+{
+  switch (code[pc]) {
+    case BRANCH: {
+      targets.push_back(pc + 1 + static_cast<int32_t>(code[pc + 1]));
+      return false;
+    }
+    case BRANCHIF: case BRANCHIFNOT: case PUSHTRAP: {
+      targets.push_back(pc + 1 + static_cast<int32_t>(code[pc + 1]));
+      return true;
+    }
+    case BEQ: case BNEQ: case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+    case BULTINT: case BUGEINT: {
+      targets.push_back(pc + 2 + static_cast<int32_t>(code[pc + 2]));
+      return true;
+    }
+    case SWITCH: {
+      const uint32_t n = code[pc + 1];
+      for (uint32_t i = 0; i < (n & 0xFFFF) + (n >> 16); ++i) {
+        targets.push_back(pc + 2 + static_cast<int32_t>(code[pc + 2 + i]));
+      }
+      return false;
+    }
+    case RETURN: case APPTERM: case APPTERM1: case APPTERM2: case APPTERM3:
+    case RAISE: case STOP: {
+      return false;
+    }
+    default: {
+      return true;
+    }
+  }
+}
+
+int64_t CodeAnalysis::getStackEffect(const uint32_t *code, uint64_t pc) {
+  switch (code[pc]) {
+    case PUSH: case PUSHACC0: case PUSHACC1: case PUSHACC2: case PUSHACC3:
+    case PUSHACC4: case PUSHACC5: case PUSHACC6: case PUSHACC7: case PUSHACC:
+    case PUSHENVACC1: case PUSHENVACC2: case PUSHENVACC3: case PUSHENVACC4:
+    case PUSHENVACC:
+    case PUSHOFFSETCLOSUREM2: case PUSHOFFSETCLOSURE0:
+    case PUSHOFFSETCLOSURE2: case PUSHOFFSETCLOSURE:
+    case PUSHGETGLOBAL: case PUSHGETGLOBALFIELD:
+    case PUSHATOM0: case PUSHATOM:
+    case PUSHCONST0: case PUSHCONST1: case PUSHCONST2: case PUSHCONST3:
+    case PUSHCONSTINT:
+    case GETPUBMET:
+      return 1;
+    case POP:
+      return -static_cast<int64_t>(code[pc + 1]);
+    case PUSH_RETADDR:
+      return 3;
+    case APPLY:
+      return -static_cast<int64_t>(code[pc + 1]) - 3;
+    case APPLY1:
+      return -1;
+    case APPLY2:
+      return -2;
+    case APPLY3:
+      return -3;
+    case CLOSURE: {
+      const int64_t n = code[pc + 1];
+      return n > 0 ? 1 - n : 0;
+    }
+    case CLOSUREREC: {
+      const int64_t f = code[pc + 1];
+      const int64_t v = code[pc + 2];
+      return f - v + (v > 0 ? 1 : 0);
+    }
+    case MAKEBLOCK:
+    case MAKEFLOATBLOCK:
+      return 1 - static_cast<int64_t>(code[pc + 1]);
+    case MAKEBLOCK2:
+      return -1;
+    case MAKEBLOCK3:
+      return -2;
+    case SETFIELD0: case SETFIELD1: case SETFIELD2: case SETFIELD3:
+    case SETFIELD: case SETFLOATFIELD:
+    case GETVECTITEM: case GETSTRINGCHAR:
+    case ADDINT: case SUBINT: case MULINT: case DIVINT: case MODINT:
+    case ANDINT: case ORINT: case XORINT: case LSLINT: case LSRINT:
+    case ASRINT:
+    case EQ: case NEQ: case LTINT: case LEINT: case GTINT: case GEINT:
+    case ULTINT: case UGEINT:
+      return -1;
+    case SETVECTITEM: case SETSTRINGCHAR:
+      return -2;
+    case PUSHTRAP:
+      return 4;
+    case POPTRAP:
+      return -4;
+    case C_CALL2:
+      return -1;
+    case C_CALL3:
+      return -2;
+    case C_CALL4:
+      return -3;
+    case C_CALL5:
+      return -4;
+    case C_CALLN:
+      return 1 - static_cast<int64_t>(code[pc + 1]);
+    default:
+      return 0;
+  }
+}
+
+void CodeAnalysis::findLeaders() {
+  std::vector<uint64_t> targets;
+  for (uint64_t entry : findFunctions(code_, size_)) {
+    leaders_.insert(entry);
+  }
+  for (uint64_t pc = 0; pc < size_; ) {
+    targets.clear();
+    const bool fallthrough = getTargets(code_, pc, targets);
+    const uint64_t next = pc + getInstructionLength(code_, pc);
+    leaders_.insert(targets.begin(), targets.end());
+    if (!targets.empty() || !fallthrough) {
+      leaders_.insert(next);
+    }
+    pc = next;
+  }
+}
+
+void CodeAnalysis::analyse(FunctionInfo &fn) {
+  std::vector<uint64_t> queue{ fn.entry };
+  std::vector<uint64_t> targets;
+  fn.blocks[fn.entry] = { fn.entry, fn.entry, {}, 0 };
+  while (!queue.empty()) {
+    BasicBlock &block = fn.blocks[queue.back()];
+    queue.pop_back();
+
+    // Find the end of the block, tracking the stack depth.
+    int64_t depth = block.depth;
+    bool fallthrough = true;
+    uint32_t op = STOP;
+    uint64_t pc = block.start;
+    targets.clear();
+    while (pc < size_) {
+      op = code_[pc];
+      fn.instructions += 1;
+      fallthrough = getTargets(code_, pc, targets);
+      depth += getStackEffect(code_, pc);
+      fn.maxDepth = std::max(fn.maxDepth, depth);
+      pc += getInstructionLength(code_, pc);
+      if (!targets.empty() || !fallthrough || isLeader(pc)) {
+        break;
+      }
+    }
+    block.end = pc;
+    if (fallthrough && pc < size_) {
+      targets.push_back(pc);
+    }
+    scan(fn, block);
+
+    // Visit successors, checking the stack depth at merge points. Handlers
+    // run once the trap frame is popped.
+    for (size_t i = 0; i < targets.size(); ++i) {
+      const uint64_t succ = targets[i];
+      if (succ >= size_) {
+        continue;
+      }
+      block.succs.push_back(succ);
+      const int64_t succDepth = op == PUSHTRAP && i == 0 ? depth - 4 : depth;
+      auto it = fn.blocks.find(succ);
+      if (it == fn.blocks.end()) {
+        fn.blocks[succ] = { succ, succ, {}, succDepth };
+        queue.push_back(succ);
+      } else if (it->second.depth != succDepth) {
+        fn.inconsistent = true;
+      }
+    }
+  }
+}
+
+void CodeAnalysis::scan(FunctionInfo &fn, BasicBlock &block) {
+  // The accumulator and the stack slots pushed in the block are tracked.
+  uint64_t acc = kUnknown;
+  std::vector<uint64_t> stack;
+  auto peek = [&stack](uint64_t n) {
+    return n < stack.size() ? stack[stack.size() - n - 1] : kUnknown;
+  };
+  auto pop = [&stack](uint64_t n) {
+    stack.resize(stack.size() - std::min<uint64_t>(n, stack.size()));
+  };
+  auto sibling = [this, &fn](int64_t ofs) {
+    auto it = groups_.find(fn.entry);
+    if (it == groups_.end()) {
+      return kUnknown;
+    }
+    const auto &group = it->second.first;
+    const int64_t index = it->second.second + ofs / 2;
+    if (index < 0 || static_cast<size_t>(index) >= group.size()) {
+      return kUnknown;
+    }
+    return group[index];
+  };
+
+  for (uint64_t pc = block.start; pc < block.end; ) {
+    const uint32_t op = code_[pc];
+    switch (op) {
+      case ACC0: case ACC1: case ACC2: case ACC3:
+      case ACC4: case ACC5: case ACC6: case ACC7: {
+        acc = peek(op - ACC0);
+        break;
+      }
+      case ACC: {
+        acc = peek(code_[pc + 1]);
+        break;
+      }
+      case PUSH: case PUSHACC0: {
+        stack.push_back(acc);
+        break;
+      }
+      case PUSHACC1: case PUSHACC2: case PUSHACC3: case PUSHACC4:
+      case PUSHACC5: case PUSHACC6: case PUSHACC7: {
+        stack.push_back(acc);
+        acc = peek(op - PUSHACC0);
+        break;
+      }
+      case PUSHACC: {
+        stack.push_back(acc);
+        acc = peek(code_[pc + 1]);
+        break;
+      }
+      case POP: {
+        pop(code_[pc + 1]);
+        break;
+      }
+      case OFFSETCLOSUREM2: case PUSHOFFSETCLOSUREM2: {
+        if (op == PUSHOFFSETCLOSUREM2) {
+          stack.push_back(acc);
+        }
+        acc = sibling(-2);
+        break;
+      }
+      case OFFSETCLOSURE0: case PUSHOFFSETCLOSURE0: {
+        if (op == PUSHOFFSETCLOSURE0) {
+          stack.push_back(acc);
+        }
+        acc = sibling(0);
+        break;
+      }
+      case OFFSETCLOSURE2: case PUSHOFFSETCLOSURE2: {
+        if (op == PUSHOFFSETCLOSURE2) {
+          stack.push_back(acc);
+        }
+        acc = sibling(2);
+        break;
+      }
+      case OFFSETCLOSURE: case PUSHOFFSETCLOSURE: {
+        if (op == PUSHOFFSETCLOSURE) {
+          stack.push_back(acc);
+        }
+        acc = sibling(static_cast<int32_t>(code_[pc + 1]));
+        break;
+      }
+      case CLOSURE: {
+        const uint32_t n = code_[pc + 1];
+        if (n > 0) {
+          stack.push_back(acc);
+        }
+        pop(n);
+        acc = pc + 2 + static_cast<int32_t>(code_[pc + 2]);
+        fn.closures.insert(acc);
+        break;
+      }
+      case CLOSUREREC: {
+        const uint32_t f = code_[pc + 1];
+        const uint32_t v = code_[pc + 2];
+        if (v > 0) {
+          stack.push_back(acc);
+        }
+        pop(v);
+        const uint64_t ofs = pc + 3;
+        for (uint32_t i = 0; i < f; ++i) {
+          const uint64_t entry = ofs + static_cast<int32_t>(code_[ofs + i]);
+          fn.closures.insert(entry);
+          stack.push_back(entry);
+        }
+        acc = f > 0 ? ofs + static_cast<int32_t>(code_[ofs]) : kUnknown;
+        break;
+      }
+      case APPLY: case APPLY1: case APPLY2: case APPLY3:
+      case APPTERM: case APPTERM1: case APPTERM2: case APPTERM3: {
+        if (acc != kUnknown) {
+          fn.callees.insert(acc);
+        }
+        pop(std::max<int64_t>(-getStackEffect(code_, pc), 0));
+        acc = kUnknown;
+        break;
+      }
+      case PUSH_RETADDR: case PUSHTRAP: {
+        stack.resize(stack.size() + getStackEffect(code_, pc), kUnknown);
+        break;
+      }
+      default: {
+        // Other instructions clobber the accumulator; pushes and pops
+        // are modelled through their stack effect.
+        const int64_t effect = getStackEffect(code_, pc);
+        if (effect > 0) {
+          stack.push_back(acc);
+          stack.resize(stack.size() + effect - 1, kUnknown);
+        } else {
+          pop(-effect);
+        }
+        acc = kUnknown;
+        break;
+      }
+    }
+    pc += getInstructionLength(code_, pc);
+  }
+}
@@ -0,0 +1,93 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+
+
+namespace miniml {
+
+/// Sequence of instructions in [start, end) with a single entry.
+struct BasicBlock {
+  /// PC of the first instruction.
+  uint64_t start;
+  /// PC past the last instruction.
+  uint64_t end;
+  /// Successors, including exception handlers.
+  std::vector<uint64_t> succs;
+  /// Stack depth on entry, relative to the entry of the function.
+  int64_t depth;
+};
+
+/// Function, formed by the blocks reachable from an entry point.
+struct FunctionInfo {
+  /// Entry point.
+  uint64_t entry;
+  /// Blocks, indexed by their start PC.
+  std::map<uint64_t, BasicBlock> blocks;
+  /// Functions applied through closures known statically.
+  std::set<uint64_t> callees;
+  /// Functions whose closures are allocated.
+  std::set<uint64_t> closures;
+  /// Number of instructions.
+  size_t instructions;
+  /// Maximal stack depth, relative to the entry.
+  int64_t maxDepth;
+  /// Flag set if a block is reached with different stack depths.
+  bool inconsistent;
+};
+
+/// Control flow and stack analysis of bytecode.
+class CodeAnalysis {
+ public:
+  /// Analyses a code section.
+  CodeAnalysis(const uint32_t *code, size_t size);
+
+  /// Returns the functions, sorted by entry point.
+  const std::vector<FunctionInfo> &getFunctions() const { return functions_; }
+  /// Returns the function a PC belongs to, or null if it is unreachable.
+  const FunctionInfo *findFunction(uint64_t pc) const;
+  /// Checks if a PC starts a basic block.
+  bool isLeader(uint64_t pc) const { return leaders_.count(pc) != 0; }
+
+  /// Finds the targets of the instruction at pc. Returns true if the
+  /// instruction can also fall through to the next one.
+  static bool getTargets(
+      const uint32_t *code,
+      uint64_t pc,
+      std::vector<uint64_t> &targets);
+  /// Returns the change in stack depth caused by an instruction.
+  static int64_t getStackEffect(const uint32_t *code, uint64_t pc);
+
+ private:
+  /// Finds the first instructions of all basic blocks.
+  void findLeaders();
+  /// Finds the blocks, stack depths and closures of a function.
+  void analyse(FunctionInfo &fn);
+  /// Scans a block, tracking the closures held in registers.
+  void scan(FunctionInfo &fn, BasicBlock &block);
+
+ private:
+  /// Code being analysed.
+  const uint32_t *code_;
+  /// Number of words in the code.
+  size_t size_;
+  /// Functions, sorted by entry.
+  std::vector<FunctionInfo> functions_;
+  /// Start PCs of basic blocks.
+  std::set<uint64_t> leaders_;
+  /// Entries of the functions allocated together with each function,
+  /// by CLOSUREREC, and the index of the function in that group.
+  std::map<uint64_t, std::pair<std::vector<uint64_t>, size_t>> groups_;
+  /// Function owning each block, by start PC.
+  std::map<uint64_t, size_t> owner_;
+};
+
+} // namespace miniml
@@ -2,13 +2,22 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
 #include <dlfcn.h>
 
 #include "miniml/BytecodeFile.h"
 #include "miniml/Context.h"
+#include "miniml/FloatOps.h"
 #include "miniml/Stream.h"
 #include "miniml/Value.h"
 #include "miniml/Interpreter.h"
+#include "miniml/Opcode.h"
+#include "miniml/Optimizer.h"
+#include "miniml/RegisterCode.h"
+#include "miniml/Verifier.h"
 using namespace miniml;
 
 
@@ -16,8 +25,32 @@ using namespace miniml;
 // -----------------------------------------------------------------------------
 // Context
 // -----------------------------------------------------------------------------
+static HeapParams readHeapParams() {
+  HeapParams params;
+  if (const char *str = getenv("OCAMLRUNPARAM")) {
+    params.parse(str);
+  } else if (const char *str = getenv("CAMLRUNPARAM")) {
+    params.parse(str);
+  }
+  return params;
+}
+
+static std::string formatPC(uint64_t pc) {
+  std::ostringstream os;
+  os << "0x" << std::hex << pc;
+  return os.str();
+}
+
 Context::Context()
-  : heap_()
+  : heap_(*this, readHeapParams())
+  , backtraceActive_(false)
+  , backtraceExn_(kUnit)
+  , backtraceLength_(0)
+  , interp_(nullptr)
+  , optimize_(true)
+#ifdef MINIML_OPCODE_STATS
+  , opcodeStats_(getenv("MLOPSTATS") ? getenv("MLOPSTATS") : "opstats.json")
+#endif
 {
   for (size_t i = 0; i < 256; ++i) {
     atom_[i] = allocBlock(0, i);
@@ -55,6 +88,46 @@ Value Context::allocAtom(uint8_t id) {
   return atom_[id];
 }
 
+Value Context::allocEphemeron(size_t keys) {
+  return heap_.allocEphemeron(keys);
+}
+
+void Context::setField(value block, size_t n, value val) {
+  heap_.setField(block, n, val);
+}
+
+void Context::setEphemeronField(value ephe, size_t n, value val) {
+  heap_.setEphemeronField(ephe, n, val);
+}
+
+void Context::rememberFields(value block, size_t start, size_t n) {
+  heap_.rememberFields(block, start, n);
+}
+
+void Context::minorCollection() {
+  heap_.minorCollection();
+}
+
+void Context::majorCollection() {
+  heap_.majorCollection();
+}
+
+HeapStats Context::getStats(bool walk) const {
+  return heap_.getStats(walk);
+}
+
+size_t Context::getMinorFree() const {
+  return heap_.getMinorFree();
+}
+
+const HeapParams &Context::getHeapParams() const {
+  return heap_.getParams();
+}
+
+void Context::setHeapParams(const HeapParams &params) {
+  heap_.setParams(params);
+}
+
 void Context::registerOperations(CustomOperations *value) {
   custom_[value->identifier] = value;
 }
@@ -101,9 +174,153 @@ Value Context::run(BytecodeFile &file) {
     dlclose(handle);
   };
 
-  // Link methods from the runtime.
+  // Link methods from the runtime. Programs refer to many externals the
+  // runtime does not provide, which are left null and only fail if called.
   link(nullptr);
 
+  // Debug information is only decoded when needed.
+  debug_.reset(new DebugInfo(*this, file.findSection(DBUG)));
+
+  // Check the code once, allowing the interpreter to skip checks.
+  size_t codeSize = codeSection->getSize() / sizeof(uint32_t);
+  verifyCode(code, codeSize, prim.size());
+
+  // Run an optimized copy of the code, moving debug events along. The copy
+  // is kept by the context since closures point into it.
+  if (optimize_) {
+    std::vector<uint32_t> optimized, pcMap;
+    optimizeCode(code, codeSize, optimized, pcMap);
+    debug_->setCodeMap(std::move(pcMap));
+    code_.push_back(std::move(optimized));
+    code = code_.back().data();
+    codeSize = code_.back().size();
+  }
+
+  // Translate functions to register code and keep float results unboxed
+  // in the bytecode. Opcode counts are only exact if everything runs in
+  // the bytecode interpreter, with the original opcodes.
+  std::unique_ptr<RegisterCode> regCode;
+#ifndef MINIML_OPCODE_STATS
+  if (optimize_) {
+    std::vector<int32_t> floatPrims;
+    for (const auto &sym : primSyms) {
+      floatPrims.push_back(findFloatPrimitive(sym));
+    }
+    regCode.reset(new RegisterCode(code, codeSize, floatPrims));
+    rewriteFloatOps(code_.back().data(), codeSize, floatPrims);
+  }
+#endif
+
   // Run the interpreter.
-  return Interpreter(*this, code, global, prim).run();
+  Interpreter interp(
+      *this,
+      code,
+      codeSize,
+      global,
+      prim,
+      primSyms,
+      regCode.get()
+  );
+  Interpreter *prev = interp_;
+  interp_ = &interp;
+  try {
+    Value result = interp.run();
+    interp_ = prev;
+    return result;
+  } catch (...) {
+    interp_ = prev;
+    throw;
+  }
+}
+
+size_t Context::backtrace(uint64_t *pcs, size_t depth) {
+  return interp_ ? interp_->backtrace(pcs, depth) : 0;
+}
+
+void Context::startProfiler(uint64_t interval, size_t depth) {
+  profiler_.reset(new Profiler(depth));
+  profiler_->start(interval);
+}
+
+void Context::sampleProfiler() {
+  if (!profiler_) {
+    return;
+  }
+  std::vector<uint64_t> pcs(profiler_->getDepth());
+  profiler_->record(pcs.data(), backtrace(pcs.data(), pcs.size()));
+}
+
+void Context::writeProfile(const std::string &path, bool raw) {
+  if (!profiler_) {
+    return;
+  }
+  profiler_->stop();
+
+  std::ofstream os(path);
+  if (!os) {
+    throw std::runtime_error("Cannot write " + path);
+  }
+  if (raw) {
+    profiler_->write(os, formatPC);
+  } else {
+    profiler_->write(os, [this](uint64_t pc) { return symbolize(pc); });
+  }
+}
+
+void Context::undefinedPrimitive(const std::string &name) {
+  uint64_t pc;
+  if (backtrace(&pc, 1) == 0) {
+    throw std::runtime_error("Undefined primitive " + name);
+  }
+  throw std::runtime_error(
+      "Undefined primitive " + name + " at " + symbolize(pc)
+  );
+}
+
+std::string Context::symbolize(uint64_t pc) {
+  return debug_ ? debug_->symbolize(pc) : formatPC(pc);
+}
+
+void Context::setBacktraceActive(bool active) {
+  if (active != backtraceActive_) {
+    backtraceActive_ = active;
+    backtraceExn_ = kUnit;
+    backtraceLength_ = 0;
+  }
+}
+
+void Context::beginBacktrace(value exn) {
+  if (exn != backtraceExn_) {
+    backtraceExn_ = exn;
+    backtraceLength_ = 0;
+  }
+}
+
+void Context::startMemprof(double rate, size_t depth) {
+  memprof_.reset(new Memprof(rate, depth));
+  heap_.setMemprof(memprof_.get());
+}
+
+void Context::writeMemprof(const std::string &prefix) {
+  if (!memprof_) {
+    return;
+  }
+
+  static const struct {
+    const char *suffix;
+    Memprof::Metric metric;
+  } kReports[] = {
+    { ".alloc", Memprof::kAllocated },
+    { ".promoted", Memprof::kPromoted },
+    { ".live", Memprof::kLive },
+  };
+  for (const auto &report : kReports) {
+    std::ofstream os(prefix + report.suffix);
+    if (!os) {
+      throw std::runtime_error("Cannot write " + prefix + report.suffix);
+    }
+    memprof_->write(os, report.metric, [this](uint64_t pc) {
+      return symbolize(pc);
+    });
+  }
 }
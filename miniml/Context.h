@@ -4,17 +4,24 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "miniml/Value.h"
+#include "miniml/DebugInfo.h"
 #include "miniml/Heap.h"
+#include "miniml/Memprof.h"
+#include "miniml/OpcodeStats.h"
+#include "miniml/Profiler.h"
 
 
 
 namespace miniml {
 class Heap;
 class BytecodeFile;
+class Interpreter;
 
 /// Context providing access to the environment.
 class Context {
@@ -32,6 +39,27 @@ class Context {
   Value allocBlock(size_t n, uint8_t tag);
   Value allocCustom(CustomOperations *op, size_t size);
   Value allocAtom(uint8_t id);
+  Value allocEphemeron(size_t keys);
+
+  // Updates fields of blocks, going through the write barrier.
+  void setField(value block, size_t n, value val);
+  void setEphemeronField(value ephe, size_t n, value val);
+  void rememberFields(value block, size_t start, size_t n);
+
+  // Registers a range of roots, such as the registers of a frame.
+  void setRoots(value *roots, size_t n) { heap_.setRoots(roots, n); }
+
+  // Triggers garbage collection.
+  void minorCollection();
+  void majorCollection();
+
+  // Queries the garbage collector.
+  HeapStats getStats(bool walk) const;
+  size_t getMinorFree() const;
+
+  // Tunes the garbage collector.
+  const HeapParams &getHeapParams() const;
+  void setHeapParams(const HeapParams &params);
 
   // Custom value operations.
   void registerOperations(CustomOperations *value);
@@ -40,15 +68,103 @@ class Context {
   // Executes a bytecode file.
   Value run(BytecodeFile &file);
 
+  /// Returns the debug information of the last program run. It is decoded
+  /// on first use, so the bytecode file must be kept alive until then.
+  DebugInfo *getDebugInfo() { return debug_.get(); }
+
+  /// Records the PCs of at most depth frames of the running program.
+  size_t backtrace(uint64_t *pcs, size_t depth);
+
+#ifdef MINIML_OPCODE_STATS
+  /// Returns the execution counters of the instrumented interpreter.
+  OpcodeStats &getOpcodeStats() { return opcodeStats_; }
+#endif
+
+  /// Enables or disables the optimization of programs run from now on.
+  void setOptimize(bool optimize) { optimize_ = optimize; }
+
+  /// Enables or disables the recording of exception backtraces.
+  void setBacktraceActive(bool active);
+  /// Checks if exception backtraces are recorded.
+  bool isBacktraceActive() const { return backtraceActive_; }
+  /// Starts a backtrace for an exception, unless the exception is being
+  /// re-raised, in which case frames are appended to its backtrace.
+  void beginBacktrace(value exn);
+  /// Appends a slot to the backtrace. Returns false if the buffer is full.
+  bool recordBacktrace(uint64_t slot) {
+    if (backtraceLength_ == kBacktraceSize) {
+      return false;
+    }
+    backtrace_[backtraceLength_++] = slot;
+    return true;
+  }
+  /// Returns the slots of the last exception backtrace.
+  const uint64_t *getBacktrace() const { return backtrace_; }
+  size_t getBacktraceLength() const { return backtraceLength_; }
+
+  /// Starts sampling allocations, replacing any previous profile.
+  void startMemprof(double rate, size_t depth);
+  /// Returns the allocation profiler, if started.
+  Memprof *getMemprof() { return memprof_.get(); }
+  /// Writes the allocated, promoted and live words of each allocation
+  /// site to prefix.alloc, prefix.promoted and prefix.live.
+  void writeMemprof(const std::string &prefix);
+
+  /// Starts the CPU profiler, sampling every interval microseconds.
+  void startProfiler(uint64_t interval, size_t depth);
+  /// Checks if the CPU profiler was started.
+  bool isProfiling() const { return profiler_ != nullptr; }
+  /// Records a sample of the running program for the CPU profiler.
+  void sampleProfiler();
+  /// Writes the CPU profile in the collapsed stack format. Frames of raw
+  /// profiles are hexadecimal PCs instead of source locations.
+  void writeProfile(const std::string &path, bool raw);
+
+ private:
+  /// Returns the name of the frame at a PC for profiles.
+  std::string symbolize(uint64_t pc);
+  /// Throws an error for a call to a primitive missing from the runtime.
+  [[noreturn]] void undefinedPrimitive(const std::string &name);
+
+ private:
+  /// Maximal number of frames in an exception backtrace.
+  static const size_t kBacktraceSize = 1024;
+
  private:
-  /// Interpreter is a friend.
+  /// Heap is a friend.
   friend class Heap;
+  /// Interpreter reports undefined primitives.
+  friend class Interpreter;
   /// Memory Manager.
   Heap heap_;
   /// List of atoms.
   Value atom_[256];
   /// List of custom values.
   std::unordered_map<std::string, CustomOperations *> custom_;
+  /// Flag indicating whether exception backtraces are recorded.
+  bool backtraceActive_;
+  /// Exception the backtrace belongs to.
+  Value backtraceExn_;
+  /// Slots of the exception backtrace.
+  uint64_t backtrace_[kBacktraceSize];
+  /// Number of slots in the backtrace.
+  size_t backtraceLength_;
+  /// Debug information of the last program run.
+  std::unique_ptr<DebugInfo> debug_;
+  /// Interpreter running the current program.
+  Interpreter *interp_;
+  /// Allocation profiler.
+  std::unique_ptr<Memprof> memprof_;
+  /// CPU profiler.
+  std::unique_ptr<Profiler> profiler_;
+  /// Flag indicating whether programs are optimized before being run.
+  bool optimize_;
+  /// Optimized code of the programs run.
+  std::vector<std::vector<uint32_t>> code_;
+#ifdef MINIML_OPCODE_STATS
+  /// Execution counters.
+  OpcodeStats opcodeStats_;
+#endif
 };
 
 } // namespace miniml
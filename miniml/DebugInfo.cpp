@@ -0,0 +1,202 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "miniml/BytecodeFile.h"
+#include "miniml/Context.h"
+#include "miniml/DebugInfo.h"
+#include "miniml/Stream.h"
+#include "miniml/Value.h"
+using namespace miniml;
+
+
+/// Size of the header of marshalled values.
+static const size_t kValueHeaderSize = 5 * sizeof(uint32_t);
+
+/// Fields of debug events.
+static const size_t kEvPos = 0;
+static const size_t kEvModule = 1;
+static const size_t kEvLoc = 2;
+/// Field holding the definition name, since OCaml 4.11.
+static const size_t kEvDefName = 4;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static uint32_t readUInt32be(const uint8_t *ptr) {
+  return __builtin_bswap32(*reinterpret_cast<const uint32_t *>(ptr));
+}
+
+static uint16_t clampChar(int64_t chr) {
+  return std::min<int64_t>(std::max<int64_t>(chr, 0), UINT16_MAX);
+}
+
+/// Unmarshals a value from a section, advancing the offset past it.
+static Value readValue(
+    Context &ctx,
+    const uint8_t *data,
+    size_t size,
+    size_t &offset)
+{
+  if (offset + kValueHeaderSize > size) {
+    throw std::runtime_error("Truncated debug information.");
+  }
+  const size_t length = kValueHeaderSize + readUInt32be(data + offset + 4);
+  if (offset + length > size) {
+    throw std::runtime_error("Truncated debug information.");
+  }
+  MemoryStreamReader stream(data + offset, length);
+  offset += length;
+  return getValue(ctx, stream);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// DebugInfo
+// -----------------------------------------------------------------------------
+DebugInfo::DebugInfo(Context &ctx, Section *section)
+  : ctx_(ctx)
+  , section_(section)
+{
+}
+
+bool DebugInfo::find(uint64_t pc, SourceLocation &loc) {
+  decode();
+
+  auto it = std::upper_bound(
+      events_.begin(), events_.end(), pc,
+      [](uint64_t pc, const Event &ev) { return pc < ev.pc; });
+  if (it == events_.begin()) {
+    return false;
+  }
+  getLocation(*(it - 1), loc);
+  return true;
+}
+
+bool DebugInfo::findFirst(uint64_t start, uint64_t end, SourceLocation &loc) {
+  decode();
+
+  auto it = std::lower_bound(
+      events_.begin(), events_.end(), start,
+      [](const Event &ev, uint64_t pc) { return ev.pc < pc; });
+  if (it == events_.end() || it->pc >= end) {
+    return false;
+  }
+  getLocation(*it, loc);
+  return true;
+}
+
+uint64_t DebugInfo::getEvent(size_t n, SourceLocation &loc) {
+  decode();
+  getLocation(events_[n], loc);
+  return events_[n].pc;
+}
+
+std::string DebugInfo::symbolize(uint64_t pc) {
+  std::ostringstream os;
+  SourceLocation loc;
+  if (find(pc, loc)) {
+    // Since OCaml 4.11, definition names are already qualified by the
+    // module; names without the prefix are qualified here.
+    const size_t length = strlen(loc.module);
+    if (strncmp(loc.def, loc.module, length) || loc.def[length] != '.') {
+      os << loc.module;
+      if (*loc.def) {
+        os << ".";
+      }
+    }
+    os << loc.def;
+    os << " (" << loc.file << ":" << loc.line << ")";
+  } else {
+    os << "0x" << std::hex << pc;
+  }
+  return os.str();
+}
+
+void DebugInfo::getLocation(const Event &event, SourceLocation &loc) const {
+  loc.module = strings_[event.module].c_str();
+  loc.def = strings_[event.def].c_str();
+  loc.file = strings_[event.file].c_str();
+  loc.line = event.line;
+  loc.startChar = event.startChar;
+  loc.endChar = event.endChar;
+}
+
+void DebugInfo::decodeSection() {
+  const uint8_t *data = section_->getData();
+  const size_t size = section_->getSize();
+  section_ = nullptr;
+
+  std::unordered_map<std::string, uint32_t> index;
+  auto intern = [this, &index](const char *str) {
+    auto it = index.emplace(str, strings_.size());
+    if (it.second) {
+      strings_.emplace_back(str);
+    }
+    return it.first->second;
+  };
+  const uint32_t empty = intern("");
+
+  if (size < sizeof(uint32_t)) {
+    return;
+  }
+  size_t offset = sizeof(uint32_t);
+  for (uint32_t i = 0, n = readUInt32be(data); i < n; ++i) {
+    if (offset + sizeof(uint32_t) > size) {
+      throw std::runtime_error("Truncated debug information.");
+    }
+    const uint32_t orig = readUInt32be(data + offset);
+    offset += sizeof(uint32_t);
+
+    // Each unit has a list of events, followed by a list of directories.
+    Value events = readValue(ctx_, data, size, offset);
+    readValue(ctx_, data, size, offset);
+
+    // The unmarshalled list is only traversed, nothing is allocated.
+    for (value l = events; val_is_block(l); l = val_field(l, 1)) {
+      value ev = val_field(l, 0);
+      value loc = val_field(ev, kEvLoc);
+      value start = val_field(loc, 0);
+      value end = val_field(loc, 1);
+
+      const int64_t bol = val_to_int64(val_field(start, 2));
+      const int64_t startChar = val_to_int64(val_field(start, 3)) - bol;
+      const int64_t endChar = val_to_int64(val_field(end, 3)) - bol;
+
+      uint32_t def = empty;
+      if (val_size(ev) > kEvDefName) {
+        value name = val_field(ev, kEvDefName);
+        if (val_is_block(name) && val_tag(name) == kStringTag) {
+          def = intern(val_to_string(name));
+        }
+      }
+
+      Event event;
+      event.pc = (orig + val_to_int64(val_field(ev, kEvPos))) / 4;
+      if (!codeMap_.empty()) {
+        event.pc = codeMap_[std::min<size_t>(event.pc, codeMap_.size() - 1)];
+      }
+      event.module = intern(val_to_string(val_field(ev, kEvModule)));
+      event.def = def;
+      event.file = intern(val_to_string(val_field(start, 0)));
+      event.line = val_to_int64(val_field(start, 1));
+      event.startChar = clampChar(startChar);
+      event.endChar = clampChar(endChar);
+      events_.push_back(event);
+    }
+  }
+
+  std::stable_sort(
+      events_.begin(), events_.end(),
+      [](const Event &a, const Event &b) { return a.pc < b.pc; });
+  events_.shrink_to_fit();
+}
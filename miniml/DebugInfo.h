@@ -0,0 +1,101 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+namespace miniml {
+class Context;
+class Section;
+
+/// Source location of a debug event.
+struct SourceLocation {
+  /// Name of the module.
+  const char *module;
+  /// Name of the enclosing definition, empty if unknown.
+  const char *def;
+  /// Name of the source file.
+  const char *file;
+  /// Line number.
+  unsigned line;
+  /// Range of characters on the line.
+  unsigned startChar;
+  unsigned endChar;
+};
+
+/// Mapping from PCs to source locations, built from the DBUG section.
+///
+/// The section is decoded on the first lookup into an index of events
+/// sorted by PC, with all names interned. The section must outlive the
+/// object until then.
+class DebugInfo {
+ public:
+  /// Creates the mapping for a section, which can be null.
+  DebugInfo(Context &ctx, Section *section);
+
+  /// Finds the location of the last event at or before a PC.
+  bool find(uint64_t pc, SourceLocation &loc);
+  /// Finds the location of the first event in a range of PCs.
+  bool findFirst(uint64_t start, uint64_t end, SourceLocation &loc);
+  /// Returns a frame name of the form "Module.def (file:line)", or
+  /// "Module (file:line)" if the definition is not known. PCs without
+  /// debug information are printed in hexadecimal.
+  std::string symbolize(uint64_t pc);
+
+  /// Moves events to new PCs after the code was rewritten. The map is
+  /// indexed by original PCs and must be set before the first lookup.
+  void setCodeMap(std::vector<uint32_t> &&map) { codeMap_ = std::move(map); }
+
+  /// Returns the number of events.
+  size_t size() { decode(); return events_.size(); }
+  /// Returns the PC and the location of the nth event.
+  uint64_t getEvent(size_t n, SourceLocation &loc);
+
+ private:
+  /// Decodes the section if not done yet.
+  void decode() {
+    if (section_) {
+      decodeSection();
+    }
+  }
+  /// Decodes all compilation units from the section.
+  void decodeSection();
+
+  /// Compact debug event.
+  struct Event {
+    /// Instruction index.
+    uint32_t pc;
+    /// Indices of the module, definition and file names.
+    uint32_t module;
+    uint32_t def;
+    uint32_t file;
+    /// Line and character range.
+    uint32_t line;
+    uint16_t startChar;
+    uint16_t endChar;
+  };
+
+  /// Expands an event into a location.
+  void getLocation(const Event &event, SourceLocation &loc) const;
+
+ private:
+  /// Context used to unmarshal events.
+  Context &ctx_;
+  /// Section to decode, null once decoded.
+  Section *section_;
+  /// Events, sorted by PC.
+  std::vector<Event> events_;
+  /// Interned names.
+  std::vector<std::string> strings_;
+  /// Map from original PCs to the PCs of the code run.
+  std::vector<uint32_t> codeMap_;
+};
+
+} // namespace miniml
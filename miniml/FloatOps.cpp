@@ -0,0 +1,126 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cmath>
+
+#include "miniml/FloatOps.h"
+#include "miniml/Opcode.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Kernels
+// -----------------------------------------------------------------------------
+namespace {
+
+double negFloat(double x) { return -x; }
+double absFloat(double x) { return std::fabs(x); }
+double sqrtFloat(double x) { return std::sqrt(x); }
+double expFloat(double x) { return std::exp(x); }
+double logFloat(double x) { return std::log(x); }
+double log10Float(double x) { return std::log10(x); }
+double sinFloat(double x) { return std::sin(x); }
+double cosFloat(double x) { return std::cos(x); }
+double tanFloat(double x) { return std::tan(x); }
+double asinFloat(double x) { return std::asin(x); }
+double acosFloat(double x) { return std::acos(x); }
+double atanFloat(double x) { return std::atan(x); }
+double floorFloat(double x) { return std::floor(x); }
+double ceilFloat(double x) { return std::ceil(x); }
+
+double addFloat(double x, double y) { return x + y; }
+double subFloat(double x, double y) { return x - y; }
+double mulFloat(double x, double y) { return x * y; }
+double divFloat(double x, double y) { return x / y; }
+double powFloat(double x, double y) { return std::pow(x, y); }
+double fmodFloat(double x, double y) { return std::fmod(x, y); }
+double atan2Float(double x, double y) { return std::atan2(x, y); }
+
+bool eqFloat(double x, double y) { return x == y; }
+bool neqFloat(double x, double y) { return x != y; }
+bool ltFloat(double x, double y) { return x < y; }
+bool leFloat(double x, double y) { return x <= y; }
+bool gtFloat(double x, double y) { return x > y; }
+bool geFloat(double x, double y) { return x >= y; }
+
+} // namespace
+
+
+
+// -----------------------------------------------------------------------------
+// Float primitives
+// -----------------------------------------------------------------------------
+const FloatPrimitive miniml::kFloatPrimitives[] = {
+  { "caml_neg_float", FloatKind::UNARY, negFloat, nullptr, nullptr },
+  { "caml_abs_float", FloatKind::UNARY, absFloat, nullptr, nullptr },
+  { "caml_sqrt_float", FloatKind::UNARY, sqrtFloat, nullptr, nullptr },
+  { "caml_exp_float", FloatKind::UNARY, expFloat, nullptr, nullptr },
+  { "caml_log_float", FloatKind::UNARY, logFloat, nullptr, nullptr },
+  { "caml_log10_float", FloatKind::UNARY, log10Float, nullptr, nullptr },
+  { "caml_sin_float", FloatKind::UNARY, sinFloat, nullptr, nullptr },
+  { "caml_cos_float", FloatKind::UNARY, cosFloat, nullptr, nullptr },
+  { "caml_tan_float", FloatKind::UNARY, tanFloat, nullptr, nullptr },
+  { "caml_asin_float", FloatKind::UNARY, asinFloat, nullptr, nullptr },
+  { "caml_acos_float", FloatKind::UNARY, acosFloat, nullptr, nullptr },
+  { "caml_atan_float", FloatKind::UNARY, atanFloat, nullptr, nullptr },
+  { "caml_floor_float", FloatKind::UNARY, floorFloat, nullptr, nullptr },
+  { "caml_ceil_float", FloatKind::UNARY, ceilFloat, nullptr, nullptr },
+  { "caml_add_float", FloatKind::BINARY, nullptr, addFloat, nullptr },
+  { "caml_sub_float", FloatKind::BINARY, nullptr, subFloat, nullptr },
+  { "caml_mul_float", FloatKind::BINARY, nullptr, mulFloat, nullptr },
+  { "caml_div_float", FloatKind::BINARY, nullptr, divFloat, nullptr },
+  { "caml_power_float", FloatKind::BINARY, nullptr, powFloat, nullptr },
+  { "caml_fmod_float", FloatKind::BINARY, nullptr, fmodFloat, nullptr },
+  { "caml_atan2_float", FloatKind::BINARY, nullptr, atan2Float, nullptr },
+  { "caml_eq_float", FloatKind::COMPARE, nullptr, nullptr, eqFloat },
+  { "caml_neq_float", FloatKind::COMPARE, nullptr, nullptr, neqFloat },
+  { "caml_lt_float", FloatKind::COMPARE, nullptr, nullptr, ltFloat },
+  { "caml_le_float", FloatKind::COMPARE, nullptr, nullptr, leFloat },
+  { "caml_gt_float", FloatKind::COMPARE, nullptr, nullptr, gtFloat },
+  { "caml_ge_float", FloatKind::COMPARE, nullptr, nullptr, geFloat },
+  { "caml_float_of_int", FloatKind::OF_INT, nullptr, nullptr, nullptr },
+  { "caml_array_get", FloatKind::GET, nullptr, nullptr, nullptr },
+  { "caml_array_unsafe_get", FloatKind::GET, nullptr, nullptr, nullptr },
+  { "caml_array_get_float", FloatKind::GET, nullptr, nullptr, nullptr },
+  { "caml_array_unsafe_get_float", FloatKind::GET, nullptr, nullptr,
+    nullptr },
+  { nullptr, FloatKind::UNARY, nullptr, nullptr, nullptr },
+};
+
+int32_t miniml::findFloatPrimitive(const std::string &name) {
+  for (int32_t i = 0; kFloatPrimitives[i].name; ++i) {
+    if (name == kFloatPrimitives[i].name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Rewriting
+// -----------------------------------------------------------------------------
+void miniml::rewriteFloatOps(
+    uint32_t *code,
+    size_t size,
+    const std::vector<int32_t> &floatPrims)
+{
+  for (uint64_t pc = 0; pc < size; pc += getInstructionLength(code, pc)) {
+    if (code[pc] != C_CALL1 && code[pc] != C_CALL2) {
+      continue;
+    }
+    const int32_t index = floatPrims[code[pc + 1]];
+    if (index < 0) {
+      continue;
+    }
+    const unsigned n = code[pc] == C_CALL1 ? 1 : 2;
+    if (getFloatArgs(kFloatPrimitives[index]) != n) {
+      continue;
+    }
+    code[pc] = FLOATOP;
+    code[pc + 1] = index;
+  }
+}
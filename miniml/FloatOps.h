@@ -0,0 +1,75 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+
+namespace miniml {
+
+/// Kinds of float primitives with an unboxed implementation.
+enum class FloatKind {
+  /// float -> float
+  UNARY,
+  /// float -> float -> float
+  BINARY,
+  /// float -> float -> bool
+  COMPARE,
+  /// int -> float
+  OF_INT,
+  /// 'a array -> int -> 'a, unboxed if the array is a float array.
+  GET,
+};
+
+/// Float primitive, implemented on unboxed doubles.
+///
+/// Calls to these primitives are rewritten when programs are loaded. The
+/// result of an operation feeding the next one through the accumulator is
+/// not boxed, so chains of float operations allocate a single box.
+struct FloatPrimitive {
+  /// Name of the boxed primitive.
+  const char *name;
+  /// Kind of the primitive.
+  FloatKind kind;
+  /// Implementation, depending on the kind.
+  double (*unary)(double);
+  double (*binary)(double, double);
+  bool (*compare)(double, double);
+};
+
+/// Table of float primitives.
+extern const FloatPrimitive kFloatPrimitives[];
+
+/// Returns the index of a float primitive, -1 if the primitive is not one.
+int32_t findFloatPrimitive(const std::string &name);
+
+/// Returns the number of arguments of a float primitive.
+inline unsigned getFloatArgs(const FloatPrimitive &prim) {
+  switch (prim.kind) {
+    case FloatKind::UNARY: case FloatKind::OF_INT: return 1;
+    default: return 2;
+  }
+}
+
+/// Checks if a float primitive takes an unboxed float in the accumulator.
+inline bool takesFloat(const FloatPrimitive &prim) {
+  switch (prim.kind) {
+    case FloatKind::OF_INT: case FloatKind::GET: return false;
+    default: return true;
+  }
+}
+
+/// Rewrites calls to float primitives into FLOATOP instructions, given the
+/// index of the float primitive for each primitive.
+void rewriteFloatOps(
+    uint32_t *code,
+    size_t size,
+    const std::vector<int32_t> &floatPrims);
+
+} // namespace miniml
@@ -2,28 +2,151 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <algorithm>
+#include <cstdlib>
+
+#include "miniml/Context.h"
 #include "miniml/Heap.h"
+#include "miniml/Memprof.h"
 using namespace miniml;
 
 
+/// Colours of major blocks, stored in bits 8-9 of the header.
+static const uint64_t kWhite = 0ull << 8;
+static const uint64_t kBlue  = 2ull << 8;
+static const uint64_t kBlack = 3ull << 8;
+static const uint64_t kColorMask = 3ull << 8;
+
+/// Largest block allocated on the minor heap (in words).
+static const size_t kMaxYoungSize = 256;
+
+/// Minimal number of major words allocated between major collections.
+static const size_t kMinMajorTrigger = 1 << 16;
+
+/// Bounds on the size of the minor heap (words).
+static const size_t kMinMinorHeapSize = 4 << 10;
+static const size_t kMaxMinorHeapSize = 1 << 28;
+
+/// Storage for the empty ephemeron sentinel, outside of the heap.
+static uint64_t epheNone[2] = { 0ull, 0ull };
+const value miniml::kEpheNone = reinterpret_cast<value>(&epheNone[1]);
+
+
+
+// -----------------------------------------------------------------------------
+// HeapParams
+// -----------------------------------------------------------------------------
+HeapParams::HeapParams()
+  : minorHeapSize(256 << 10 /* 2Mb */)
+  , majorIncrement(15 /* % */)
+  , spaceOverhead(80 /* % */)
+  , maxHeapSize(0)
+  , stackLimit(1 << 20 /* 8Mb */)
+  , hugePages(kHugePagesOff)
+  , numa(false)
+{
+}
+
+void HeapParams::parse(const char *str) {
+  while (str && *str) {
+    // Options without a value, such as b, are skipped.
+    const char key = *str++;
+    if (*str == '=') {
+      ++str;
+
+      char *end;
+      size_t val;
+      if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        val = strtoull(str + 2, &end, 16);
+      } else {
+        val = strtoull(str, &end, 10);
+      }
+      switch (*end) {
+        case 'k': val <<= 10; ++end; break;
+        case 'M': val <<= 20; ++end; break;
+        case 'G': val <<= 30; ++end; break;
+        default: break;
+      }
+
+      switch (key) {
+        case 's': minorHeapSize = val; break;
+        case 'i': majorIncrement = val; break;
+        case 'o': spaceOverhead = val; break;
+        case 'M': maxHeapSize = val; break;
+        case 'l': stackLimit = val; break;
+        case 'H': hugePages = static_cast<HugePageMode>(val % 3); break;
+        case 'N': numa = val != 0; break;
+        default: break;
+      }
+      str = end;
+    }
+
+    while (*str && *str != ',') {
+      ++str;
+    }
+    if (*str == ',') {
+      ++str;
+    }
+  }
+}
+
+
 
 // -----------------------------------------------------------------------------
 // Heap
 // -----------------------------------------------------------------------------
-Heap::Heap()
-  : minorHeapSize(512 << 10 /* 4Kb */)
-  , majorNodeSize(512 << 10 /* 4Kb */)
+Heap::Heap(Context &ctx, const HeapParams &params)
+  : ctx_(ctx)
+  , params(params)
+  , node(params.numa ? getCurrentNode() : -1)
+  , minorHeapSize(0)
   , minorStart(nullptr)
   , minorCurrent(nullptr)
-  , major(nullptr)
+  , freeList(0)
+  , majorWords(0)
+  , majorTrigger(kMinMajorTrigger)
+  , stats()
+  , memprof(nullptr)
+  , roots(nullptr)
+  , numRoots(0)
 {
-  minorStart = minorCurrent = reinterpret_cast<uint8_t*>(malloc(minorHeapSize));
+  resizeMinor();
 
-  (void) major;
-  (void) majorNodeSize;
+  for (size_t i = 0; i < 256; ++i) {
+    atoms[i] = i;
+  }
 }
 
 Heap::~Heap() {
+  freeArena(minorStart, minorHeapSize);
+  for (auto &node : major) {
+    freeArena(node.start, node.end - node.start);
+  }
+}
+
+void Heap::setParams(const HeapParams &newParams) {
+  const bool resize = newParams.minorHeapSize != params.minorHeapSize;
+  params = newParams;
+  if (resize) {
+    emptyMinorHeap();
+    resizeMinor();
+  }
+}
+
+void Heap::resizeMinor() {
+  const size_t words = std::min(
+      kMaxMinorHeapSize,
+      std::max(kMinMinorHeapSize, params.minorHeapSize));
+
+  size_t size = words * sizeof(value);
+  auto *start = static_cast<uint8_t*>(allocArena(size, params.hugePages, node));
+  if (start == nullptr) {
+    throw std::runtime_error("Cannot allocate minor heap.");
+  }
+  freeArena(minorStart, minorHeapSize);
+  params.minorHeapSize = size / sizeof(value);
+  minorHeapSize = size;
+  minorStart = minorCurrent = start;
 }
 
 Value Heap::allocInt64(int64_t i) {
@@ -67,35 +190,601 @@ Value Heap::allocBlock(size_t n, uint8_t tag) {
     throw std::runtime_error("Block too large.");
   }
 
-  size_t blkSize = n * sizeof(value) + sizeof(value);
-  if (blkSize > minorHeapSize) {
-    // Major heap allocation.
-    assert(!"alloc on major heap");
-  } else if (minorStart + minorHeapSize < minorCurrent + blkSize) {
-    // Minor heap fill, trigger GC.
-    for (const Value *n = Value::chain; n; n = n->next()) {
-
-    }
-    assert(!"minor gc");
-  } else {
-    void *block = reinterpret_cast<void*>(minorCurrent);
-    minorCurrent += blkSize;
+  // Zero-sized blocks are shared.
+  if (n == 0) {
+    return reinterpret_cast<value>(&atoms[tag] + 1);
+  }
 
-    if (block == nullptr) {
-      throw std::runtime_error("Allocation failed.");
+  // Large blocks go straight to the major heap. Their fields are scanned
+  // during the next minor collection since they are initialised without
+  // going through the write barrier.
+  if (n > kMaxYoungSize) {
+    if (majorWords > majorTrigger) {
+      majorCollection();
     }
-
-    *reinterpret_cast<uint64_t *>(block) = (n << 10) | tag;
+    majorWords += n + 1;
+    stats.majorWords += n + 1;
+    value block = allocMajor(n, tag);
     for (size_t i = 0; i < n; ++i) {
-      *(reinterpret_cast<value *>(block) + i + 1) = 1ull;
+      val_field(block, i) = 1ull;
+    }
+    if (tag < kNoScanTag) {
+      rememberedBlocks.insert(block);
     }
-    return reinterpret_cast<value>(block) + sizeof(uint64_t);
+    if (memprof) {
+      sample(block, n, false);
+    }
+    return block;
+  }
+
+  size_t blkSize = n * sizeof(value) + sizeof(value);
+  if (minorStart + minorHeapSize < minorCurrent + blkSize) {
+    // Minor heap full, trigger GC.
+    minorCollection();
+  }
+
+  void *block = reinterpret_cast<void*>(minorCurrent);
+  minorCurrent += blkSize;
+
+  *reinterpret_cast<uint64_t *>(block) = (n << 10) | tag;
+  for (size_t i = 0; i < n; ++i) {
+    *(reinterpret_cast<value *>(block) + i + 1) = 1ull;
+  }
+  value v = reinterpret_cast<value>(block) + sizeof(uint64_t);
+  if (memprof) {
+    sample(v, n, true);
   }
+  return v;
 }
 
 Value Heap::allocCustom(CustomOperations *op, size_t size) {
   const size_t words = 1 + (size + sizeof(value) - 1) / sizeof(value);
   value b = allocBlock(words, kCustomTag);
   val_field(b, 0) = reinterpret_cast<value>(op);
+  if (op->finalize) {
+    (isMinor(b) ? minorCustom : majorCustom).push_back(b);
+  }
+  return b;
+}
+
+Value Heap::allocEphemeron(size_t keys) {
+  value b = allocBlock(kEpheFirstKey + keys, kNoScanTag);
+  for (size_t i = 0; i < kEpheFirstKey + keys; ++i) {
+    val_field(b, i) = kEpheNone;
+  }
+  (isMinor(b) ? minorEphemerons : majorEphemerons).push_back(b);
   return b;
 }
+
+void Heap::setField(value block, size_t n, value val) {
+  val_field(block, n) = val;
+  if (val_is_block(val) && isMinor(val) && !isMinor(block)) {
+    rememberedFields.push_back(&val_field(block, n));
+  }
+}
+
+void Heap::setEphemeronField(value ephe, size_t n, value val) {
+  val_field(ephe, n) = val;
+  if (val_is_block(val) && isMinor(val) && !isMinor(ephe)) {
+    rememberedEphemerons.push_back(ephe);
+  }
+}
+
+void Heap::rememberFields(value block, size_t start, size_t n) {
+  if (isMinor(block)) {
+    return;
+  }
+
+  // If most of the block was written, the whole block is scanned during
+  // the next minor collection instead of remembering individual fields.
+  const bool whole = n * 2 >= val_size(block);
+  for (size_t i = start; i < start + n; ++i) {
+    const value val = val_field(block, i);
+    if (val_is_block(val) && isMinor(val)) {
+      if (whole) {
+        rememberedBlocks.insert(block);
+        return;
+      }
+      rememberedFields.push_back(&val_field(block, i));
+    }
+  }
+}
+
+bool Heap::isMajor(value val) const {
+  auto ptr = reinterpret_cast<uint8_t *>(val);
+  auto it = std::upper_bound(
+      major.begin(), major.end(), ptr,
+      [](uint8_t *p, const Major &node) { return p < node.start; });
+  if (it == major.begin()) {
+    return false;
+  }
+  --it;
+  return ptr < it->end;
+}
+
+value Heap::allocMajor(size_t n, uint8_t tag) {
+  for (;;) {
+    // First fit: blocks are carved out from the end of free blocks, leaving
+    // the remainder in the free list. Header-only remainders are dropped.
+    value *prev = &freeList;
+    for (value b = freeList; b; prev = &val_field(b, 0), b = *prev) {
+      const size_t size = val_size(b);
+      if (size < n) {
+        continue;
+      }
+
+      value next = val_field(b, 0);
+      value block;
+      if (size == n) {
+        *prev = next;
+        block = b;
+      } else {
+        const size_t rest = size - n - 1;
+        block = b + (rest + 1) * sizeof(value);
+        if (rest == 0) {
+          *prev = next;
+        }
+        val_header(b) = (rest << 10) | kBlue;
+      }
+      val_header(block) = (n << 10) | kWhite | tag;
+      return block;
+    }
+    growMajor(n);
+  }
+}
+
+void Heap::growMajor(size_t n) {
+  size_t words = params.majorIncrement;
+  if (words <= 1000) {
+    words = std::max<size_t>(stats.heapWords * words / 100, 64 << 10);
+  }
+  words = std::max(words, n + 1);
+  if (params.maxHeapSize && stats.heapWords + words > params.maxHeapSize) {
+    words = n + 1;
+    if (stats.heapWords + words > params.maxHeapSize) {
+      throw std::runtime_error("Out of memory: major heap limit reached.");
+    }
+  }
+
+  size_t size = words * sizeof(value);
+  void *arena = allocArena(size, params.hugePages, node);
+  if (arena == nullptr) {
+    throw std::runtime_error("Cannot grow major heap.");
+  }
+  auto *start = static_cast<uint8_t *>(arena);
+
+  // The new node is a single free block.
+  *reinterpret_cast<uint64_t *>(start) =
+      ((size / sizeof(value) - 1) << 10) | kBlue;
+  value block = reinterpret_cast<value>(start + sizeof(value));
+  val_field(block, 0) = freeList;
+  freeList = block;
+
+  stats.heapWords += size / sizeof(value);
+  stats.heapChunks += 1;
+  stats.topHeapWords = std::max(stats.topHeapWords, stats.heapWords);
+
+  Major node = { start, start + size };
+  major.insert(
+      std::upper_bound(
+          major.begin(), major.end(), node,
+          [](const Major &a, const Major &b) { return a.start < b.start; }),
+      node);
+}
+
+void Heap::sample(value block, size_t n, bool young) {
+  if (size_t samples = memprof->sample(n + 1)) {
+    std::vector<uint64_t> pcs(memprof->getDepth());
+    size_t depth = ctx_.backtrace(pcs.data(), pcs.size());
+    memprof->track(block, young, samples, pcs.data(), depth);
+  }
+}
+
+void Heap::finalize(std::vector<value> &dead) {
+  for (value block : dead) {
+    val_ops(block)->finalize(ctx_, block);
+  }
+  dead.clear();
+}
+
+void Heap::recordPause(
+    std::chrono::steady_clock::time_point start,
+    uint64_t &total,
+    uint64_t &max)
+{
+  auto end = std::chrono::steady_clock::now();
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count();
+  total += ns;
+  max = std::max(max, ns);
+}
+
+HeapStats Heap::getStats(bool walk) const {
+  HeapStats s = stats;
+  s.minorWords += (minorCurrent - minorStart) / sizeof(value);
+  if (!walk) {
+    return s;
+  }
+
+  for (auto &node : major) {
+    for (uint8_t *ptr = node.start; ptr < node.end; ) {
+      uint64_t hdr = *reinterpret_cast<uint64_t *>(ptr);
+      uint64_t size = hdr >> 10;
+      if ((hdr & kColorMask) != kBlue) {
+        s.liveWords += size + 1;
+        s.liveBlocks += 1;
+      } else if (size == 0) {
+        s.fragments += 1;
+      } else {
+        s.freeWords += size + 1;
+        s.freeBlocks += 1;
+        s.largestFree = std::max(s.largestFree, size);
+      }
+      ptr += (size + 1) * sizeof(value);
+    }
+  }
+  return s;
+}
+
+size_t Heap::getMinorFree() const {
+  return (minorStart + minorHeapSize - minorCurrent) / sizeof(value);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Minor collection
+// -----------------------------------------------------------------------------
+void Heap::minorCollection() {
+  emptyMinorHeap();
+  if (majorWords > majorTrigger) {
+    markAndSweep();
+  }
+}
+
+void Heap::emptyMinorHeap() {
+  auto start = std::chrono::steady_clock::now();
+  // Promote everything reachable from roots and old-to-young pointers.
+  for (Value *n = Value::chain; n; n = n->next_) {
+    oldify(n->value_);
+  }
+  for (size_t i = 0; i < numRoots; ++i) {
+    oldify(roots[i]);
+  }
+  for (value *field : rememberedFields) {
+    oldify(*field);
+  }
+  for (value block : rememberedBlocks) {
+    for (size_t i = 0, n = val_size(block); i < n; ++i) {
+      oldify(val_field(block, i));
+    }
+  }
+  oldifyDrain();
+  oldifyEphemerons();
+
+  // Follow sampled blocks to their new location.
+  if (memprof) {
+    memprof->minorCollection([this](value &block) {
+      if (!isOldified(block)) {
+        return false;
+      }
+      block = val_field(block, 0);
+      return true;
+    });
+  }
+
+  // Find dead custom blocks, moving the survivors to the major list.
+  std::vector<value> dead;
+  for (value block : minorCustom) {
+    if (isOldified(block)) {
+      majorCustom.push_back(val_field(block, 0));
+    } else {
+      dead.push_back(block);
+    }
+  }
+  minorCustom.clear();
+
+  // Finalizers run while dead blocks are still intact.
+  finalize(dead);
+
+  stats.minorWords += (minorCurrent - minorStart) / sizeof(value);
+  stats.minorCollections += 1;
+  minorCurrent = minorStart;
+  rememberedFields.clear();
+  rememberedBlocks.clear();
+  rememberedEphemerons.clear();
+
+  recordPause(start, stats.minorPauseTotal, stats.minorPauseMax);
+}
+
+void Heap::oldify(value &val) {
+  value v = val;
+  if (!val_is_block(v) || !isMinor(v)) {
+    return;
+  }
+
+  const uint64_t hdr = val_header(v);
+  if (hdr == 0) {
+    // Already promoted: the first field is the forwarding pointer.
+    val = val_field(v, 0);
+    return;
+  }
+  if ((hdr & 0xFF) == kInfixTag) {
+    // Infix pointers are promoted with their enclosing closure.
+    const size_t offset = (hdr >> 10) * sizeof(value);
+    value base = v - offset;
+    oldify(base);
+    val = base + offset;
+    return;
+  }
+
+  const size_t n = hdr >> 10;
+  const uint8_t tag = hdr & 0xFF;
+  value copy = allocMajor(n, tag);
+  memcpy(val_ptr(copy), val_ptr(v), n * sizeof(value));
+  majorWords += n + 1;
+  stats.promotedWords += n + 1;
+  stats.majorWords += n + 1;
+
+  val_header(v) = 0;
+  val_field(v, 0) = copy;
+  if (tag < kNoScanTag) {
+    oldifyStack.push_back(copy);
+  }
+  val = copy;
+}
+
+void Heap::oldifyDrain() {
+  while (!oldifyStack.empty()) {
+    value block = oldifyStack.back();
+    oldifyStack.pop_back();
+    for (size_t i = 0, n = val_size(block); i < n; ++i) {
+      oldify(val_field(block, i));
+    }
+  }
+}
+
+bool Heap::isOldified(value val) const {
+  if (!val_is_block(val) || !isMinor(val)) {
+    return true;
+  }
+  const uint64_t hdr = val_header(val);
+  if ((hdr & 0xFF) == kInfixTag) {
+    return val_header(val - (hdr >> 10) * sizeof(value)) == 0;
+  }
+  return hdr == 0;
+}
+
+void Heap::oldifyEphemerons() {
+  // Young ephemerons are only examined if they survived, while all old
+  // ephemerons holding young pointers are assumed to be alive.
+  std::vector<value> ephes;
+  for (value ephe : minorEphemerons) {
+    if (isOldified(ephe)) {
+      ephes.push_back(val_field(ephe, 0));
+    }
+  }
+  minorEphemerons.clear();
+  const size_t promoted = ephes.size();
+  ephes.insert(
+      ephes.end(),
+      rememberedEphemerons.begin(),
+      rememberedEphemerons.end());
+
+  // Data is reachable if all the keys are: iterate until a fixpoint is found.
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (value ephe : ephes) {
+      value &data = val_field(ephe, kEpheData);
+      if (isOldified(data)) {
+        continue;
+      }
+      bool alive = true;
+      for (size_t i = kEpheFirstKey, n = val_size(ephe); i < n; ++i) {
+        alive = alive && isOldified(val_field(ephe, i));
+      }
+      if (alive) {
+        oldify(data);
+        oldifyDrain();
+        changed = true;
+      }
+    }
+  }
+
+  // Clear dead keys, along with the data they guard.
+  for (value ephe : ephes) {
+    bool cleared = false;
+    for (size_t i = kEpheFirstKey, n = val_size(ephe); i < n; ++i) {
+      value &key = val_field(ephe, i);
+      if (isOldified(key)) {
+        oldify(key);
+      } else {
+        key = kEpheNone;
+        cleared = true;
+      }
+    }
+    value &data = val_field(ephe, kEpheData);
+    if (cleared || !isOldified(data)) {
+      data = kEpheNone;
+    } else {
+      oldify(data);
+    }
+  }
+
+  majorEphemerons.insert(
+      majorEphemerons.end(),
+      ephes.begin(),
+      ephes.begin() + promoted);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Major collection
+// -----------------------------------------------------------------------------
+void Heap::majorCollection() {
+  emptyMinorHeap();
+  markAndSweep();
+}
+
+void Heap::markAndSweep() {
+  auto start = std::chrono::steady_clock::now();
+
+  for (Value *n = Value::chain; n; n = n->next_) {
+    mark(n->value_);
+  }
+  for (size_t i = 0; i < numRoots; ++i) {
+    mark(roots[i]);
+  }
+  markDrain();
+  markEphemerons();
+
+  if (memprof) {
+    memprof->majorCollection([this](value block) {
+      return isMarked(block);
+    });
+  }
+
+  // Find dead custom blocks and run their finalizers before sweeping.
+  std::vector<value> dead;
+  std::vector<value> alive;
+  for (value block : majorCustom) {
+    (isMarked(block) ? alive : dead).push_back(block);
+  }
+  majorCustom.swap(alive);
+  finalize(dead);
+
+  const size_t liveWords = sweep();
+
+  // Next collection after space_overhead% of live data is allocated.
+  majorWords = 0;
+  majorTrigger = std::max<size_t>(
+      kMinMajorTrigger,
+      liveWords * params.spaceOverhead / 100);
+
+  stats.majorCollections += 1;
+  recordPause(start, stats.majorPauseTotal, stats.majorPauseMax);
+}
+
+void Heap::mark(value val) {
+  if (!val_is_block(val) || !isMajor(val)) {
+    return;
+  }
+
+  uint64_t &hdr = val_header(val);
+  if ((hdr & 0xFF) == kInfixTag) {
+    mark(val - (hdr >> 10) * sizeof(value));
+    return;
+  }
+  if ((hdr & kColorMask) == kBlack) {
+    return;
+  }
+  hdr = (hdr & ~kColorMask) | kBlack;
+  if ((hdr & 0xFF) < kNoScanTag) {
+    markStack.push_back(val);
+  }
+}
+
+void Heap::markDrain() {
+  while (!markStack.empty()) {
+    value block = markStack.back();
+    markStack.pop_back();
+    for (size_t i = 0, n = val_size(block); i < n; ++i) {
+      mark(val_field(block, i));
+    }
+  }
+}
+
+bool Heap::isMarked(value val) const {
+  if (!val_is_block(val) || !isMajor(val)) {
+    return true;
+  }
+  uint64_t hdr = val_header(val);
+  if ((hdr & 0xFF) == kInfixTag) {
+    hdr = val_header(val - (hdr >> 10) * sizeof(value));
+  }
+  return (hdr & kColorMask) == kBlack;
+}
+
+void Heap::markEphemerons() {
+  std::vector<value> ephes;
+  for (value ephe : majorEphemerons) {
+    if (isMarked(ephe)) {
+      ephes.push_back(ephe);
+    }
+  }
+  majorEphemerons.swap(ephes);
+
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (value ephe : majorEphemerons) {
+      value data = val_field(ephe, kEpheData);
+      if (isMarked(data)) {
+        continue;
+      }
+      bool alive = true;
+      for (size_t i = kEpheFirstKey, n = val_size(ephe); i < n; ++i) {
+        alive = alive && isMarked(val_field(ephe, i));
+      }
+      if (alive) {
+        mark(data);
+        markDrain();
+        changed = true;
+      }
+    }
+  }
+
+  for (value ephe : majorEphemerons) {
+    bool cleared = false;
+    for (size_t i = kEpheFirstKey, n = val_size(ephe); i < n; ++i) {
+      value &key = val_field(ephe, i);
+      if (!isMarked(key)) {
+        key = kEpheNone;
+        cleared = true;
+      }
+    }
+    value &data = val_field(ephe, kEpheData);
+    if (cleared || !isMarked(data)) {
+      data = kEpheNone;
+    }
+  }
+}
+
+size_t Heap::sweep() {
+  size_t liveWords = 0;
+  freeList = 0;
+
+  for (auto &node : major) {
+    uint8_t *run = nullptr;
+    auto close = [&run, this](uint8_t *end) {
+      if (!run) {
+        return;
+      }
+      // Coalesce the run into a single free block. Runs of a single word
+      // cannot hold a link, so they remain unused until their neighbours die.
+      const size_t words = (end - run) / sizeof(value);
+      *reinterpret_cast<uint64_t *>(run) = ((words - 1) << 10) | kBlue;
+      if (words > 1) {
+        value block = reinterpret_cast<value>(run + sizeof(value));
+        val_field(block, 0) = freeList;
+        freeList = block;
+      }
+      run = nullptr;
+    };
+
+    for (uint8_t *ptr = node.start; ptr < node.end; ) {
+      uint64_t &hdr = *reinterpret_cast<uint64_t *>(ptr);
+      uint8_t *next = ptr + ((hdr >> 10) + 1) * sizeof(value);
+      if ((hdr & kColorMask) == kBlack) {
+        close(ptr);
+        hdr = (hdr & ~kColorMask) | kWhite;
+        liveWords += (hdr >> 10) + 1;
+      } else if (!run) {
+        run = ptr;
+      }
+      ptr = next;
+    }
+    close(node.end);
+  }
+  return liveWords;
+}
@@ -4,15 +4,98 @@
 
 #pragma once
 
+#include <chrono>
+#include <unordered_set>
+#include <vector>
+
+#include "miniml/Arena.h"
 #include "miniml/Value.h"
 
 namespace miniml {
+class Context;
+class Memprof;
+
+/// Sentinel stored in the empty slots of ephemerons.
+extern const value kEpheNone;
+
+/// Index of the data field of an ephemeron.
+static const size_t kEpheData = 1;
+/// Index of the first key of an ephemeron.
+static const size_t kEpheFirstKey = 2;
+
+
+
+/// Tunable heap parameters, as set by OCAMLRUNPARAM and Gc.set.
+struct HeapParams {
+  /// Size of the minor heap (words).
+  size_t minorHeapSize;
+  /// Major heap increment: percentage of the heap if at most 1000, words
+  /// otherwise.
+  size_t majorIncrement;
+  /// Words allocated in the major heap between collections, as a
+  /// percentage of the live words.
+  size_t spaceOverhead;
+  /// Maximal size of the major heap (words), 0 if unlimited.
+  size_t maxHeapSize;
+  /// Maximal size of the interpreter stack (words).
+  size_t stackLimit;
+  /// Page backing of the minor and major heaps.
+  HugePageMode hugePages;
+  /// Places heap memory on the NUMA node of the thread creating the heap.
+  bool numa;
+
+  /// Creates the default parameters.
+  HeapParams();
+
+  /// Overrides parameters from an OCAMLRUNPARAM string, such as "s=4M,o=120".
+  void parse(const char *str);
+};
+
+
+
+/// Heap statistics, as reported by Gc.stat.
+struct HeapStats {
+  /// Words allocated in the minor heap.
+  uint64_t minorWords;
+  /// Words promoted from the minor heap.
+  uint64_t promotedWords;
+  /// Words allocated in the major heap, including promoted ones.
+  uint64_t majorWords;
+  /// Number of minor collections.
+  uint64_t minorCollections;
+  /// Number of major collections.
+  uint64_t majorCollections;
+  /// Size of the major heap (words).
+  uint64_t heapWords;
+  /// Number of nodes in the major heap.
+  uint64_t heapChunks;
+  /// Largest size the major heap ever reached (words).
+  uint64_t topHeapWords;
+  /// Live words and blocks in the major heap.
+  uint64_t liveWords;
+  uint64_t liveBlocks;
+  /// Free words and blocks in the major heap.
+  uint64_t freeWords;
+  uint64_t freeBlocks;
+  /// Size of the largest free block (words).
+  uint64_t largestFree;
+  /// Number of unusable, header-only free blocks.
+  uint64_t fragments;
+  /// Total and longest pause of minor collections (nanoseconds).
+  uint64_t minorPauseTotal;
+  uint64_t minorPauseMax;
+  /// Total and longest pause of major collections (nanoseconds).
+  uint64_t majorPauseTotal;
+  uint64_t majorPauseMax;
+};
+
+
 
 // Heap managing memory.
 class Heap {
  public:
   /// Initializes the heap.
-  Heap();
+  Heap(Context &ctx, const HeapParams &params);
   /// Destroys the heap.
   ~Heap();
 
@@ -23,12 +106,103 @@ class Heap {
   Value allocString(const char *str, size_t length);
   Value allocBlock(size_t n, uint8_t tag);
   Value allocCustom(CustomOperations *ops, size_t size);
+  Value allocEphemeron(size_t keys);
+
+  /// Stores a value into a field of a block, recording old-to-young pointers.
+  void setField(value block, size_t n, value val);
+  /// Stores a key or the data of an ephemeron.
+  void setEphemeronField(value ephe, size_t n, value val);
+  /// Records the old-to-young pointers among fields written directly.
+  void rememberFields(value block, size_t start, size_t n);
+
+  /// Empties the minor heap, promoting live objects.
+  void minorCollection();
+  /// Empties the minor heap, then collects the major heap.
+  void majorCollection();
+
+  /// Returns heap statistics. Live and free block counts are only filled in
+  /// if walk is set, since they require a traversal of the major heap.
+  HeapStats getStats(bool walk) const;
+  /// Returns the number of free words in the minor heap.
+  size_t getMinorFree() const;
+
+  /// Returns the heap parameters.
+  const HeapParams &getParams() const { return params; }
+  /// Changes the heap parameters, resizing the minor heap if needed.
+  void setParams(const HeapParams &params);
+
+  /// Attaches an allocation profiler, or detaches it if null.
+  void setMemprof(Memprof *memprof) { this->memprof = memprof; }
+
+  /// Adds a range of values to the roots, replacing the previous one.
+  void setRoots(value *roots, size_t n) {
+    this->roots = roots;
+    this->numRoots = n;
+  }
 
  private:
-  /// Size of the minor heap.
+  /// Checks if a value points into the minor heap.
+  bool isMinor(value val) const {
+    auto ptr = reinterpret_cast<uint8_t *>(val);
+    return minorStart <= ptr && ptr < minorStart + minorHeapSize;
+  }
+  /// Checks if a value points into the major heap.
+  bool isMajor(value val) const;
+
+  /// Allocates a white block on the major heap, without triggering a GC.
+  value allocMajor(size_t n, uint8_t tag);
+  /// Adds a new node to the major heap, large enough to hold n words.
+  void growMajor(size_t n);
+  /// Allocates an empty minor heap of the configured size.
+  void resizeMinor();
+
+  /// Promotes all live young blocks and resets the minor heap.
+  void emptyMinorHeap();
+  /// Collects the major heap, assuming the minor heap is empty.
+  void markAndSweep();
+
+  /// Copies a young block to the major heap, updating the reference.
+  void oldify(value &val);
+  /// Scans promoted blocks until all reachable young blocks are copied.
+  void oldifyDrain();
+  /// Checks if a young value survived the minor collection.
+  bool isOldified(value val) const;
+  /// Traces and cleans ephemerons touched during a minor collection.
+  void oldifyEphemerons();
+
+  /// Marks a major block, pushing it onto the mark stack.
+  void mark(value val);
+  /// Marks blocks until the mark stack is empty.
+  void markDrain();
+  /// Checks if a major value was marked.
+  bool isMarked(value val) const;
+  /// Traces and cleans ephemerons during a major collection.
+  void markEphemerons();
+  /// Frees unmarked blocks, rebuilding the free list. Returns live words.
+  size_t sweep();
+
+  /// Reports a block to the allocation profiler if it is sampled.
+  void sample(value block, size_t n, bool young);
+
+  /// Runs the finalizers of dead custom blocks.
+  void finalize(std::vector<value> &dead);
+
+  /// Records the duration of a collection.
+  static void recordPause(
+      std::chrono::steady_clock::time_point start,
+      uint64_t &total,
+      uint64_t &max);
+
+ private:
+  /// Context owning the heap, passed to finalizers.
+  Context &ctx_;
+
+  /// Heap parameters.
+  HeapParams params;
+  /// NUMA node heap memory is placed on, -1 if not bound.
+  int node;
+  /// Size of the minor heap (bytes).
   size_t minorHeapSize;
-  /// Size of a major node.
-  size_t majorNodeSize;
 
   /// Start address of the minor heap.
   uint8_t *minorStart;
@@ -37,16 +211,53 @@ class Heap {
 
   // Major heap node.
   struct Major {
-    /// Next major node.
-    Major *next;
     /// Start address of a major node.
     uint8_t *start;
-    /// Current pointer in the major node.
-    uint8_t *current;
+    /// End address of a major node.
+    uint8_t *end;
   };
 
-  // First heap node.
-  Major *major;
+  /// Major heap nodes, sorted by address.
+  std::vector<Major> major;
+  /// First block in the free list of the major heap.
+  value freeList;
+  /// Number of words allocated in the major heap since the last major GC.
+  size_t majorWords;
+  /// Number of major words triggering a major collection.
+  size_t majorTrigger;
+
+  /// Counters reported through getStats. The minor word count excludes
+  /// the blocks in the minor heap, which are counted on demand.
+  HeapStats stats;
+
+  /// Fields of major blocks pointing to the minor heap.
+  std::vector<value *> rememberedFields;
+  /// Major blocks allocated or bulk-written since the last minor
+  /// collection, scanned entirely. A set, as blocks are written repeatedly.
+  std::unordered_set<value> rememberedBlocks;
+  /// Major ephemerons which were assigned young keys or data.
+  std::vector<value> rememberedEphemerons;
+
+  /// Blocks promoted, but not yet scanned.
+  std::vector<value> oldifyStack;
+  /// Blocks marked, but not yet scanned.
+  std::vector<value> markStack;
+
+  /// Ephemerons in the minor and major heaps.
+  std::vector<value> minorEphemerons;
+  std::vector<value> majorEphemerons;
+  /// Custom blocks with finalizers in the minor and major heaps.
+  std::vector<value> minorCustom;
+  std::vector<value> majorCustom;
+
+  /// Allocation profiler, if attached.
+  Memprof *memprof;
+  /// Range of roots outside the value chain.
+  value *roots;
+  size_t numRoots;
+
+  /// Headers of zero-sized blocks, which are shared and not collected.
+  uint64_t atoms[256];
 };
 
 }
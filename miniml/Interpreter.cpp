@@ -3,8 +3,11 @@
 // (C) Nandor Licker. All rights reserved.
 
 #include "miniml/Context.h"
+#include "miniml/FloatOps.h"
 #include "miniml/Value.h"
 #include "miniml/Interpreter.h"
+#include "miniml/Opcode.h"
+#include "miniml/RegisterCode.h"
 using namespace miniml;
 
 
@@ -46,22 +49,38 @@ void Stack::setSP(unsigned sp) {
 Interpreter::Interpreter(
     Context &ctx,
     const uint32_t *code,
+    size_t codeSize,
     Value global,
-    std::vector<void*> prim)
+    std::vector<void*> prim,
+    std::vector<std::string> primNames,
+    const RegisterCode *regCode)
   : ctx(ctx)
   , code(code)
+  , codeSize(codeSize)
   , A(1ull)
   , trapSP(0)
   , extraArgs(0)
   , global(global)
   , prim(prim)
+  , primNames(primNames)
+  , regCode(regCode)
 {
+  if (regCode) {
+    regs.resize(kMaxRegisters, kUnit);
+  }
 }
 
 Interpreter::~Interpreter() {
+  ctx.setRoots(nullptr, 0);
 }
 
 Value Interpreter::run() {
+  // The profiler poll is only compiled into the loop if it is running.
+  return ctx.isProfiling() ? dispatch<true>() : dispatch<false>();
+}
+
+template <bool kProfile>
+Value Interpreter::dispatch() {
   PC = 0;
 
   if (sigsetjmp(exn, 0)) {
@@ -77,7 +96,15 @@ Value Interpreter::run() {
   }
 
   for (;;) {
-    switch (auto op = code[PC++]) {
+    if (kProfile && Profiler::pending) {
+      Profiler::pending = 0;
+      ctx.sampleProfiler();
+    }
+#ifdef MINIML_OPCODE_STATS
+    ctx.getOpcodeStats().record(PC, code[PC]);
+#endif
+
+    switch (code[PC++]) {
     case   0: runACC(0);                        break;
     case   1: runACC(1);                        break;
     case   2: runACC(2);                        break;
@@ -224,8 +251,10 @@ Value Interpreter::run() {
     case 143: return A;
     case 144: runEVENT();                       break;
     case 145: runBREAK();                       break;
+    case 146: runFLOATOP();                     break;
     default:
-      throw std::runtime_error("Uknonwn opcode: " + std::to_string(op));
+      // Opcodes are checked by the verifier when the program is loaded.
+      __builtin_unreachable();
     }
   }
 }
@@ -272,7 +301,7 @@ void Interpreter::runGETFLOATFIELD(uint32_t n) {
 
 // -----------------------------------------------------------------------------
 void Interpreter::runSETFIELD(uint32_t n) {
-  A.setField(n, stack.pop());
+  ctx.setField(A, n, stack.pop());
   A = kUnit;
 }
 
@@ -296,7 +325,7 @@ void Interpreter::runGETVECTITEM() {
 void Interpreter::runSETVECTITEM() {
   int64_t n = val_to_int64(stack.pop());
   Value v = stack.pop();
-  A.setField(n, v);
+  ctx.setField(A, n, v);
   A = kUnit;
 }
 
@@ -326,9 +355,10 @@ void Interpreter::runPUSHENVACC(uint32_t n) {
 
 // -----------------------------------------------------------------------------
 void Interpreter::runPUSH_RETADDR(int32_t ofs) {
+  checkStack();
   stack.push(val_int64(extraArgs));
   stack.push(env);
-  stack.push(val_int64(PC + ofs - 1));
+  stack.push(retAddr(PC + ofs - 1));
 }
 
 // -----------------------------------------------------------------------------
@@ -336,48 +366,58 @@ void Interpreter::runAPPLY(uint32_t args) {
   PC = A.getCode();
   env = A;
   extraArgs = args - 1;
+  skipGRAB();
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
 void Interpreter::runAPPLY1() {
+  checkStack();
   value arg = stack.pop();
   stack.push(val_int64(extraArgs));
   stack.push(env);
-  stack.push(val_int64(PC));
+  stack.push(retAddr(PC));
   stack.push(arg);
   PC = A.getCode();
   env = A;
   extraArgs = 0;
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
 void Interpreter::runAPPLY2() {
+  checkStack();
   value arg2 = stack.pop();
   value arg1 = stack.pop();
   stack.push(val_int64(extraArgs));
   stack.push(env);
-  stack.push(val_int64(PC));
+  stack.push(retAddr(PC));
   stack.push(arg1);
   stack.push(arg2);
   PC = A.getCode();
   env = A;
   extraArgs = 1;
+  skipGRAB();
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
 void Interpreter::runAPPLY3() {
+  checkStack();
   value arg3 = stack.pop();
   value arg2 = stack.pop();
   value arg1 = stack.pop();
   stack.push(val_int64(extraArgs));
   stack.push(env);
-  stack.push(val_int64(PC));
+  stack.push(retAddr(PC));
   stack.push(arg1);
   stack.push(arg2);
   stack.push(arg3);
   PC = A.getCode();
   env = A;
   extraArgs = 2;
+  skipGRAB();
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
@@ -393,6 +433,8 @@ void Interpreter::runAPPTERM() {
   PC = A.getCode();
   env = A;
   extraArgs += n - 1;
+  skipGRAB();
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
@@ -403,6 +445,8 @@ void Interpreter::runAPPTERM1() {
   stack.push(arg1);
   PC = A.getCode();
   env = A;
+  skipGRAB();
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
@@ -416,6 +460,8 @@ void Interpreter::runAPPTERM2() {
   PC = A.getCode();
   env = A;
   extraArgs += 1;
+  skipGRAB();
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
@@ -431,6 +477,16 @@ void Interpreter::runAPPTERM3() {
   PC = A.getCode();
   env = A;
   extraArgs += 2;
+  skipGRAB();
+  enterRegisters();
+}
+
+// -----------------------------------------------------------------------------
+void Interpreter::skipGRAB() {
+  if (code[PC] == GRAB && code[PC + 1] <= extraArgs) {
+    extraArgs -= code[PC + 1];
+    PC += 2;
+  }
 }
 
 // -----------------------------------------------------------------------------
@@ -454,7 +510,7 @@ void Interpreter::runGRAB(uint32_t n) {
     for (size_t i = 0; i < extraArgs + 1; ++i) {
       A.setField(2 + i, stack.pop());
     }
-    PC = val_to_int64(stack.pop());
+    PC = retPC(stack.pop());
     env = stack.pop();
     extraArgs = val_to_int64(stack.pop());
   }
@@ -492,12 +548,12 @@ void Interpreter::runCLOSUREREC() {
   stack.pop_n(v);
   A.setCode(PC + static_cast<int32_t>(code[PC]));
   stack.push(A);
-  for (uint32_t i = 0; i + 1< f; ++i) {
-    Value header((i * 2) << 10 | kInfixTag);
-    A.setField(1 + i * 2, header);
-    Value ofs(PC + code[PC + i]);
-    A.setField(2 + i * 2, ofs);
-    stack.push(ofs);
+  for (uint32_t i = 1; i < f; ++i) {
+    // The other functions are infix blocks, whose header holds their
+    // offset in words from the start of the closure.
+    A.setField(i * 2 - 1, (i * 2) << 10 | kInfixTag);
+    A.setField(i * 2, PC + static_cast<int32_t>(code[PC + i]));
+    stack.push(A + i * 2 * sizeof(value));
   }
 
   PC += f;
@@ -553,7 +609,7 @@ void Interpreter::runPUSHGETGLOBALFIELD() {
 
 // -----------------------------------------------------------------------------
 void Interpreter::runSETGLOBAL(uint32_t n) {
-  global.setField(n, A);
+  ctx.setField(global, n, A);
   A = kUnit;
 }
 
@@ -660,10 +716,11 @@ void Interpreter::runPUSHCONST(int32_t n) {
 
 // -----------------------------------------------------------------------------
 void Interpreter::runCCALL(uint32_t n) {
-  uint32_t p = code[PC++];
-  auto *ptr = prim[p];
+  // Missing primitives are only reported when called.
+  const uint32_t idx = code[PC++];
+  auto *ptr = prim[idx];
   if (ptr == nullptr) {
-    throw std::runtime_error("Undefined prim " + std::to_string(p));
+    ctx.undefinedPrimitive(primNames[idx]);
   }
 
   stack.push(env);
@@ -695,10 +752,15 @@ void Interpreter::runCCALL(uint32_t n) {
     break;
   }
   default:
+    // Arguments are passed as an array, copied above the environment to
+    // place them in order.
     stack.push(A);
+    for (uint32_t i = 2; i <= n; ++i) {
+      stack.push(stack[2 * i - 2]);
+    }
     auto *fn = ((value(*)(Context&, Value*, uint32_t n))ptr);
-    A = fn(ctx, &stack[0], n);
-    stack.pop();
+    A = fn(ctx, &stack[n - 1], n);
+    stack.pop_n(n);
     break;
   }
 
@@ -706,6 +768,49 @@ void Interpreter::runCCALL(uint32_t n) {
   stack.pop_n(n - 1);
 }
 
+// -----------------------------------------------------------------------------
+void Interpreter::runFLOATOP() {
+  // The result of an operation stays unboxed while it is passed to the next
+  // one through the accumulator, only the last result is boxed.
+  double x = takesFloat(kFloatPrimitives[code[PC]]) ? A.getDouble() : 0;
+  for (;;) {
+    const FloatPrimitive &prim = kFloatPrimitives[code[PC++]];
+    switch (prim.kind) {
+      case FloatKind::UNARY: {
+        x = prim.unary(x);
+        break;
+      }
+      case FloatKind::BINARY: {
+        x = prim.binary(x, val_to_double(stack.pop()));
+        break;
+      }
+      case FloatKind::COMPARE: {
+        A = val_int64(prim.compare(x, val_to_double(stack.pop())));
+        return;
+      }
+      case FloatKind::OF_INT: {
+        x = static_cast<double>(A.getInt64());
+        break;
+      }
+      case FloatKind::GET: {
+        value array = A;
+        int64_t i = val_to_int64(stack.pop());
+        if (val_tag(array) != kDoubleArrayTag) {
+          A = val_field(array, i);
+          return;
+        }
+        x = val_to_dbl(val_field(array, i));
+        break;
+      }
+    }
+    if (code[PC] != FLOATOP || !takesFloat(kFloatPrimitives[code[PC + 1]])) {
+      break;
+    }
+    PC += 1;
+  }
+  A = ctx.allocDouble(x);
+}
+
 // -----------------------------------------------------------------------------
 void Interpreter::runMULINT() {
   int64_t i = val_to_int64(stack.pop());
@@ -734,7 +839,7 @@ void Interpreter::runDIVINT() {
   int64_t i = val_to_int64(stack.pop());
   if (i == 0) {
     A = val_field(global, kZeroDivideExn);
-    siglongjmp(exn, 1);
+    raise(false);
   } else {
     A = ctx.allocInt64(static_cast<uint64_t>(A.getInt64()) / i);
   }
@@ -745,7 +850,7 @@ void Interpreter::runMODINT() {
   int64_t i = val_to_int64(stack.pop());
   if (i == 0) {
     A = val_field(global, kZeroDivideExn);
-    siglongjmp(exn, 1);
+    raise(false);
   } else {
     A = ctx.allocInt64(static_cast<uint64_t>(A.getInt64()) % i);
   }
@@ -883,16 +988,18 @@ void Interpreter::runRETURN(uint32_t n) {
     extraArgs -= 1;
     PC = A.getCode();
     env = A;
+    skipGRAB();
   } else {
-    PC = val_to_int64(stack.pop());
+    PC = retPC(stack.pop());
     env = stack.pop();
     extraArgs = val_to_int64(stack.pop());
   }
+  enterRegisters();
 }
 
 // -----------------------------------------------------------------------------
 void Interpreter::runRAISE() {
-  siglongjmp(exn, 1);
+  raise(true);
 }
 
 // -----------------------------------------------------------------------------
@@ -1015,3 +1122,437 @@ void Interpreter::runEVENT() {
 void Interpreter::runBREAK() {
   throw std::runtime_error("BREAK");
 }
+
+// -----------------------------------------------------------------------------
+void Interpreter::checkStack() {
+  if (stack.getSP() > ctx.getHeapParams().stackLimit) {
+    A = val_field(global, kStackOverflowExn);
+    raise(false);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void Interpreter::raise(bool isRaise) {
+  if (ctx.isBacktraceActive()) {
+    stashBacktrace(isRaise);
+  }
+  siglongjmp(exn, 1);
+}
+
+// -----------------------------------------------------------------------------
+void Interpreter::stashBacktrace(bool isRaise) {
+  ctx.beginBacktrace(A);
+  if (!ctx.recordBacktrace((PC << 1) | (isRaise ? 1 : 0))) {
+    return;
+  }
+
+  // Record the frames unwound up to the handler.
+  for (unsigned i = 0, n = stack.getSP() - trapSP; i < n; ++i) {
+    value v = stack[i];
+    if (isRetAddr(v) && !ctx.recordBacktrace(retPC(v) << 1)) {
+      return;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+size_t Interpreter::backtrace(uint64_t *pcs, size_t depth) {
+  if (depth == 0) {
+    return 0;
+  }
+
+  // The current PC is followed by the return addresses on the stack, which
+  // are the only stack slots pointing into the code.
+  size_t n = 0;
+  pcs[n++] = PC;
+  for (unsigned i = 0, sp = stack.getSP(); i < sp && n < depth; ++i) {
+    value v = stack[i];
+    if (isRetAddr(v)) {
+      pcs[n++] = retPC(v);
+    }
+  }
+  return n;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Register code
+// -----------------------------------------------------------------------------
+void Interpreter::enterRegisters() {
+  if (!regCode) {
+    return;
+  }
+  const RegisterEntry *entry = regCode->find(PC);
+  if (!entry) {
+    return;
+  }
+  const RegisterFunction &fn = regCode->getFunction(entry->function);
+  if (stack.getSP() < fn.window + entry->depth) {
+    return;
+  }
+  runRegisters(*entry);
+}
+
+// -----------------------------------------------------------------------------
+void Interpreter::runRegisters(const RegisterEntry &entry) {
+  const RegisterFunction &fn = regCode->getFunction(entry.function);
+  const RegInst *insts = fn.code.data();
+  const uint32_t *tables = fn.tables.data();
+  const uint32_t window = fn.window;
+  value *r = regs.data();
+
+  // Move the accumulator and the stack slots into registers, leaving the
+  // slots below the entry on the stack.
+  r[0] = A;
+  for (uint32_t i = 0; i < window; ++i) {
+    r[1 + i] = stack[entry.depth + window - 1 - i];
+  }
+  for (uint32_t i = 0; i < entry.depth; ++i) {
+    r[1 + window + i] = stack[entry.depth - 1 - i];
+  }
+  for (uint32_t i = 1 + window + entry.depth; i < fn.numRegs; ++i) {
+    r[i] = kUnit;
+  }
+  const unsigned base = stack.getSP() - entry.depth;
+  stack.setSP(base);
+  ctx.setRoots(r, fn.numRegs);
+
+  // Moves registers back to the stack, resuming the bytecode at a PC.
+  auto exit = [&, this](uint32_t depth, uint64_t pc) {
+    if (fn.writesWindow) {
+      for (uint32_t j = 0; j < window; ++j) {
+        stack[window - 1 - j] = r[1 + j];
+      }
+    }
+    for (uint32_t j = 0; j < depth; ++j) {
+      stack.push(r[1 + window + j]);
+    }
+    A = r[0];
+    PC = pc;
+    ctx.setRoots(nullptr, 0);
+  };
+
+  for (uint32_t i = entry.start; ; ) {
+    const RegInst &inst = insts[i++];
+    switch (inst.op) {
+      case REG_MOV: {
+        r[inst.d] = r[inst.a];
+        break;
+      }
+      case REG_CONST: {
+        r[inst.d] = val_int64(inst.imm);
+        break;
+      }
+      case REG_ENVACC: {
+        r[inst.d] = val_field(env, inst.imm);
+        break;
+      }
+      case REG_GETGLOBAL: {
+        r[inst.d] = val_field(global, inst.imm);
+        break;
+      }
+      case REG_GETGLOBALFIELD: {
+        r[inst.d] = val_field(val_field(global, inst.imm), inst.b);
+        break;
+      }
+      case REG_GETFIELD: {
+        r[inst.d] = val_field(r[inst.a], inst.imm);
+        break;
+      }
+      case REG_SETFIELD: {
+        ctx.setField(r[inst.a], inst.imm, r[inst.b]);
+        break;
+      }
+      case REG_VECTLENGTH: {
+        r[inst.d] = val_int64(val_size(r[inst.a]));
+        break;
+      }
+      case REG_GETVECTITEM: {
+        r[inst.d] = val_field(r[inst.a], val_to_int64(r[inst.b]));
+        break;
+      }
+      case REG_SETVECTITEM: {
+        ctx.setField(r[inst.a], val_to_int64(r[inst.b]), r[inst.d]);
+        break;
+      }
+      case REG_GETSTRINGCHAR: {
+        const int64_t n = val_to_int64(r[inst.b]);
+        r[inst.d] = val_int64(val_to_string(r[inst.a])[n]);
+        break;
+      }
+      case REG_SETSTRINGCHAR: {
+        const int64_t n = val_to_int64(r[inst.b]);
+        val_to_string(r[inst.a])[n] = val_to_int64(r[inst.d]);
+        break;
+      }
+      case REG_OFFSETREF: {
+        val_field(r[inst.a], 0) += inst.imm;
+        break;
+      }
+      case REG_NEGINT: {
+        r[inst.d] = val_int64(-val_to_int64(r[inst.a]));
+        break;
+      }
+      case REG_BOOLNOT: {
+        r[inst.d] = val_int64(!val_to_int64(r[inst.a]));
+        break;
+      }
+      case REG_ISINT: {
+        r[inst.d] = val_int64(val_is_int64(r[inst.a]) ? 1 : 0);
+        break;
+      }
+      case REG_OFFSETINT: {
+        r[inst.d] = r[inst.a] + inst.imm;
+        break;
+      }
+      case REG_ADDINT: {
+        const uint64_t a = val_to_int64(r[inst.a]);
+        r[inst.d] = val_int64(a + val_to_int64(r[inst.b]));
+        break;
+      }
+      case REG_SUBINT: {
+        const uint64_t a = val_to_int64(r[inst.a]);
+        r[inst.d] = val_int64(a - val_to_int64(r[inst.b]));
+        break;
+      }
+      case REG_MULINT: {
+        const uint64_t a = val_to_int64(r[inst.a]);
+        r[inst.d] = val_int64(a * val_to_int64(r[inst.b]));
+        break;
+      }
+      case REG_ANDINT: {
+        r[inst.d] = r[inst.a] & r[inst.b];
+        break;
+      }
+      case REG_ORINT: {
+        r[inst.d] = r[inst.a] | r[inst.b];
+        break;
+      }
+      case REG_XORINT: {
+        r[inst.d] = (r[inst.a] ^ r[inst.b]) | 1;
+        break;
+      }
+      case REG_LSLINT: {
+        r[inst.d] = ((r[inst.a] - 1) << val_to_int64(r[inst.b])) + 1;
+        break;
+      }
+      case REG_LSRINT: case REG_ASRINT: {
+        r[inst.d] = ((r[inst.a] - 1) >> val_to_int64(r[inst.b])) | 1;
+        break;
+      }
+      case REG_EQ: {
+        r[inst.d] = val_int64(r[inst.a] == r[inst.b]);
+        break;
+      }
+      case REG_NEQ: {
+        r[inst.d] = val_int64(r[inst.a] != r[inst.b]);
+        break;
+      }
+      case REG_LTINT: case REG_ULTINT: {
+        r[inst.d] = val_int64(r[inst.a] < r[inst.b]);
+        break;
+      }
+      case REG_LEINT: {
+        r[inst.d] = val_int64(r[inst.a] <= r[inst.b]);
+        break;
+      }
+      case REG_GTINT: case REG_UGEINT: {
+        r[inst.d] = val_int64(r[inst.a] > r[inst.b]);
+        break;
+      }
+      case REG_GEINT: {
+        r[inst.d] = val_int64(r[inst.a] >= r[inst.b]);
+        break;
+      }
+      case REG_BRANCH: {
+        i = inst.target;
+        break;
+      }
+      case REG_BRANCHIF: {
+        if (r[inst.a] != kFalse) {
+          i = inst.target;
+        }
+        break;
+      }
+      case REG_BRANCHIFNOT: {
+        if (r[inst.a] == kFalse) {
+          i = inst.target;
+        }
+        break;
+      }
+      case REG_BEQ: case REG_BNEQ: case REG_BLTINT: case REG_BLEINT:
+      case REG_BGTINT: case REG_BGEINT: {
+        const int64_t a = static_cast<uint32_t>(inst.imm);
+        const int64_t b = val_to_int64(r[inst.a]);
+        bool taken;
+        switch (inst.op) {
+          case REG_BEQ: taken = a == b; break;
+          case REG_BNEQ: taken = a != b; break;
+          case REG_BLTINT: taken = a < b; break;
+          case REG_BLEINT: taken = a <= b; break;
+          case REG_BGTINT: taken = a > b; break;
+          default: taken = a >= b; break;
+        }
+        if (taken) {
+          i = inst.target;
+        }
+        break;
+      }
+      case REG_BULTINT: case REG_BUGEINT: {
+        const uint64_t a = static_cast<uint32_t>(inst.imm);
+        const uint64_t b = val_to_int64(r[inst.a]);
+        if (inst.op == REG_BULTINT ? a < b : a >= b) {
+          i = inst.target;
+        }
+        break;
+      }
+      case REG_SWITCH: {
+        const uint32_t n = tables[inst.target];
+        const uint32_t *table = tables + inst.target + 1;
+        if (val_is_block(r[0])) {
+          int64_t index = val_tag(r[0]);
+          assert((uint64_t) index < (n >> 16));
+          i = table[(n & 0xFFFF) + index];
+        } else {
+          int64_t index = val_to_int64(r[0]);
+          assert((uint64_t) index < (n & 0xFFFF));
+          i = table[index];
+        }
+        break;
+      }
+      case REG_PUSH_RETADDR: {
+        if (base + inst.a > ctx.getHeapParams().stackLimit) {
+          // The bytecode raises Stack_overflow.
+          exit(inst.a, inst.imm);
+          return;
+        }
+        r[inst.d + 0] = val_int64(extraArgs);
+        r[inst.d + 1] = env;
+        r[inst.d + 2] = retAddr(inst.target);
+        break;
+      }
+      case REG_MAKEBLOCK: {
+        PC = inst.target;
+        value block = ctx.allocBlock(inst.d, inst.imm);
+        val_field(block, 0) = r[inst.a];
+        for (uint32_t j = 1; j < inst.d; ++j) {
+          val_field(block, j) = r[inst.b + 1 - j];
+        }
+        r[0] = block;
+        break;
+      }
+      case REG_C_CALL: {
+        PC = inst.target;
+        void *ptr = prim[inst.imm];
+        if (ptr == nullptr) {
+          ctx.undefinedPrimitive(primNames[inst.imm]);
+        }
+        value a = r[inst.a];
+        const value *b = r + inst.b;
+        switch (inst.d) {
+          case 1: {
+            auto *fn = ((value(*)(Context&, value))ptr);
+            r[0] = fn(ctx, a);
+            break;
+          }
+          case 2: {
+            auto *fn = ((value(*)(Context&, value, value))ptr);
+            r[0] = fn(ctx, a, b[0]);
+            break;
+          }
+          case 3: {
+            auto *fn = ((value(*)(Context&, value, value, value))ptr);
+            r[0] = fn(ctx, a, b[0], b[-1]);
+            break;
+          }
+          case 4: {
+            auto *fn = ((value(*)(Context&, value, value, value, value))ptr);
+            r[0] = fn(ctx, a, b[0], b[-1], b[-2]);
+            break;
+          }
+          default: {
+            auto *fn =
+                ((value(*)(Context&, value, value, value, value, value))ptr);
+            r[0] = fn(ctx, a, b[0], b[-1], b[-2], b[-3]);
+            break;
+          }
+        }
+        break;
+      }
+      case REG_FLOAT: {
+        PC = inst.target;
+        const RegInst *op = &inst;
+        bool fused = false;
+        double x = 0;
+        auto arg = [&](uint16_t reg) {
+          return fused && reg == 0 ? x : val_to_double(r[reg]);
+        };
+        for (;;) {
+          const FloatPrimitive &prim = kFloatPrimitives[op->imm];
+          bool boxed = true;
+          switch (prim.kind) {
+            case FloatKind::UNARY: {
+              x = prim.unary(arg(op->a));
+              break;
+            }
+            case FloatKind::BINARY: {
+              x = prim.binary(arg(op->a), arg(op->b));
+              break;
+            }
+            case FloatKind::COMPARE: {
+              r[op->d] = val_int64(prim.compare(arg(op->a), arg(op->b)));
+              boxed = false;
+              break;
+            }
+            case FloatKind::OF_INT: {
+              x = static_cast<double>(val_to_int64(r[op->a]));
+              break;
+            }
+            case FloatKind::GET: {
+              const value array = r[op->a];
+              const value field = val_field(array, val_to_int64(r[op->b]));
+              if (val_tag(array) != kDoubleArrayTag) {
+                r[op->d] = field;
+                boxed = false;
+              } else {
+                x = val_to_dbl(field);
+              }
+              break;
+            }
+          }
+          if (!boxed) {
+            break;
+          }
+
+          // Results flowing into the next operation through the
+          // accumulator are not boxed.
+          const RegInst &next = insts[i];
+          if (op->d == 0 && next.op == REG_FLOAT && next.a == 0 &&
+              takesFloat(kFloatPrimitives[next.imm])) {
+            op = &next;
+            fused = true;
+            PC = next.target;
+            ++i;
+            continue;
+          }
+          r[op->d] = ctx.allocDouble(x);
+          break;
+        }
+        break;
+      }
+      case REG_POLL: {
+        if (Profiler::pending) {
+          Profiler::pending = 0;
+          PC = inst.target;
+          ctx.sampleProfiler();
+        }
+        break;
+      }
+      case REG_EXIT: {
+        exit(inst.a, inst.target);
+        return;
+      }
+    }
+  }
+}
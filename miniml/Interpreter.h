@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include <setjmp.h>
@@ -12,6 +13,8 @@
 
 namespace miniml {
 class Context;
+class RegisterCode;
+struct RegisterEntry;
 
 /// Interpreter stack.
 class Stack {
@@ -42,8 +45,11 @@ class Interpreter {
   Interpreter(
       Context &ctx,
       const uint32_t *code,
+      size_t codeSize,
       Value global,
-      std::vector<void*> prim);
+      std::vector<void*> prim,
+      std::vector<std::string> primNames,
+      const RegisterCode *regCode);
 
   // Frees the interpreter.
   ~Interpreter();
@@ -51,7 +57,16 @@ class Interpreter {
   // Interprets a bytecode file.
   Value run();
 
+  /// Records the PC and the return addresses of at most depth frames,
+  /// innermost first. Returns the number of frames recorded.
+  size_t backtrace(uint64_t *pcs, size_t depth);
+
  private:
+  /// Runs the dispatch loop, polling the CPU profiler before each
+  /// instruction only if kProfile is set.
+  template <bool kProfile>
+  Value dispatch();
+
   void runACC(uint32_t n);
   void runPUSH();
   void runPUSHACC(uint32_t n);
@@ -144,12 +159,49 @@ class Interpreter {
   void runGETDYNMET();
   void runEVENT();
   void runBREAK();
+  void runFLOATOP();
+
+  /// Skips the GRAB at the start of the closure called if it receives all
+  /// its arguments, as the GRAB would only count them.
+  void skipGRAB();
+
+  /// Switches to register code if there is an entry point at the PC,
+  /// following a call or a return.
+  void enterRegisters();
+  /// Runs register code until it exits to the bytecode.
+  void runRegisters(const RegisterEntry &entry);
+
+  /// Raises Stack_overflow if the stack exceeds its limit.
+  void checkStack();
+
+  /// Raises the exception in the accumulator. isRaise distinguishes
+  /// raise instructions from exceptions raised by the interpreter.
+  [[noreturn]] void raise(bool isRaise);
+  /// Records the frames unwound by the exception in the accumulator.
+  void stashBacktrace(bool isRaise);
+
+  /// Return addresses are stored on the stack as pointers into the code,
+  /// distinguishing them from both integers and heap pointers.
+  value retAddr(uint64_t pc) const {
+    return reinterpret_cast<value>(code + pc);
+  }
+  /// Decodes a return address.
+  uint64_t retPC(value addr) const {
+    return reinterpret_cast<const uint32_t *>(addr) - code;
+  }
+  /// Checks if a stack slot holds a return address.
+  bool isRetAddr(value v) const {
+    auto ptr = reinterpret_cast<const uint32_t *>(v);
+    return code <= ptr && ptr < code + codeSize;
+  }
 
  private:
   /// Reference to the context.
   Context &ctx;
   /// Code being executed.
   const uint32_t *code;
+  /// Number of instruction words in the code.
+  size_t codeSize;
   /// Stack.
   Stack stack;
   /// Program counter.
@@ -164,8 +216,14 @@ class Interpreter {
   Value env;
   /// Global state.
   Value global;
-  /// Builtin functions.
+  /// Builtin functions, null if missing from the runtime.
   std::vector<void *> prim;
+  /// Names of the builtin functions.
+  std::vector<std::string> primNames;
+  /// Register code of the functions, null if not used.
+  const RegisterCode *regCode;
+  /// Registers of the running register code.
+  std::vector<value> regs;
   /// Exception buffer.
   sigjmp_buf exn;
 };
@@ -0,0 +1,118 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <stdexcept>
+
+#include "miniml/Memprof.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Memprof
+// -----------------------------------------------------------------------------
+/// Checks the rate before it is used to build the distribution, rejecting
+/// NaN along with values outside (0, 1].
+static double checkRate(double rate) {
+  if (!(rate > 0.0 && rate <= 1.0)) {
+    throw std::runtime_error("Invalid sampling rate.");
+  }
+  return rate;
+}
+
+Memprof::Memprof(double rate, size_t depth)
+  : rate_(checkRate(rate))
+  , depth_(depth)
+  , rng_(std::random_device()())
+  , dist_(rate_)
+  , countdown_(dist_(rng_) + 1)
+{
+}
+
+size_t Memprof::sampleSlow(size_t words) {
+  size_t samples = 0;
+  while (countdown_ <= words) {
+    words -= countdown_;
+    countdown_ = dist_(rng_) + 1;
+    ++samples;
+  }
+  countdown_ -= words;
+  return samples;
+}
+
+void Memprof::track(
+    value block,
+    bool young,
+    size_t samples,
+    const uint64_t *pcs,
+    size_t n)
+{
+  std::vector<uint64_t> stack(pcs, pcs + n);
+  auto it = index_.find(stack);
+  if (it == index_.end()) {
+    it = index_.emplace(stack, sites_.size()).first;
+    sites_.push_back({ stack, 0, 0, 0 });
+  }
+
+  Site &site = sites_[it->second];
+  site.allocated += samples;
+  site.live += samples;
+  if (young) {
+    minor_.push_back({ block, it->second, samples });
+  } else {
+    site.promoted += samples;
+    major_.push_back({ block, it->second, samples });
+  }
+}
+
+void Memprof::minorCollection(const std::function<bool(value &)> &promote) {
+  for (auto &tracked : minor_) {
+    Site &site = sites_[tracked.site];
+    if (promote(tracked.block)) {
+      site.promoted += tracked.samples;
+      major_.push_back(tracked);
+    } else {
+      site.live -= tracked.samples;
+    }
+  }
+  minor_.clear();
+}
+
+void Memprof::majorCollection(const std::function<bool(value)> &alive) {
+  std::vector<Tracked> live;
+  for (auto &tracked : major_) {
+    if (alive(tracked.block)) {
+      live.push_back(tracked);
+    } else {
+      sites_[tracked.site].live -= tracked.samples;
+    }
+  }
+  major_.swap(live);
+}
+
+void Memprof::write(
+    std::ostream &os,
+    Metric metric,
+    const Symbolizer &sym) const
+{
+  for (const auto &site : sites_) {
+    uint64_t samples = 0;
+    switch (metric) {
+      case kAllocated: samples = site.allocated; break;
+      case kPromoted: samples = site.promoted; break;
+      case kLive: samples = site.live; break;
+    }
+    if (samples == 0) {
+      continue;
+    }
+
+    for (auto it = site.stack.rbegin(); it != site.stack.rend(); ++it) {
+      if (it != site.stack.rbegin()) {
+        os << ";";
+      }
+      os << sym(*it);
+    }
+    os << " " << static_cast<uint64_t>(samples / rate_) << "\n";
+  }
+}
@@ -0,0 +1,110 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "miniml/Value.h"
+
+
+
+namespace miniml {
+
+/// Statistical allocation profiler.
+///
+/// Each allocated word is sampled with a fixed probability. Sampled blocks
+/// are attributed to the call stack which allocated them and are tracked
+/// by the GC to find out how many of them are promoted and still alive.
+class Memprof {
+ public:
+  /// Metric reported for each site.
+  enum Metric {
+    kAllocated,
+    kPromoted,
+    kLive,
+  };
+
+  /// Maps a PC to the name of a frame.
+  typedef std::function<std::string(uint64_t)> Symbolizer;
+
+  /// Creates a profiler sampling words with a given rate.
+  Memprof(double rate, size_t depth);
+
+  /// Returns the maximal number of frames recorded.
+  size_t getDepth() const { return depth_; }
+
+  /// Returns the number of samples in a block of n words.
+  size_t sample(size_t words) {
+    if (words < countdown_) {
+      countdown_ -= words;
+      return 0;
+    }
+    return sampleSlow(words);
+  }
+
+  /// Records a sampled block allocated in the minor or major heap.
+  void track(
+      value block,
+      bool young,
+      size_t samples,
+      const uint64_t *pcs,
+      size_t n);
+
+  /// Updates young blocks after a minor collection. The callback returns
+  /// false for dead blocks and updates the address of promoted ones.
+  void minorCollection(const std::function<bool(value &)> &promote);
+  /// Drops dead blocks after a major collection.
+  void majorCollection(const std::function<bool(value)> &alive);
+
+  /// Writes a report in the collapsed stack format used by flamegraphs.
+  /// Frames are ordered from the outermost to the innermost.
+  void write(std::ostream &os, Metric metric, const Symbolizer &sym) const;
+
+ private:
+  /// Draws the number of samples in a block after the countdown expired.
+  size_t sampleSlow(size_t words);
+
+  /// Allocation site: a call stack, innermost frame first.
+  struct Site {
+    std::vector<uint64_t> stack;
+    /// Number of samples allocated, promoted and alive.
+    uint64_t allocated;
+    uint64_t promoted;
+    uint64_t live;
+  };
+
+  /// Sampled block being tracked.
+  struct Tracked {
+    value block;
+    size_t site;
+    size_t samples;
+  };
+
+ private:
+  /// Probability of sampling a word.
+  double rate_;
+  /// Maximal number of frames recorded.
+  size_t depth_;
+  /// Random number generator.
+  std::mt19937_64 rng_;
+  /// Distribution of the distance between samples.
+  std::geometric_distribution<size_t> dist_;
+  /// Words to allocate before the next sample.
+  size_t countdown_;
+  /// Allocation sites.
+  std::vector<Site> sites_;
+  /// Index of sites by call stack.
+  std::map<std::vector<uint64_t>, size_t> index_;
+  /// Sampled blocks in the minor and major heaps.
+  std::vector<Tracked> minor_;
+  std::vector<Tracked> major_;
+};
+
+} // namespace miniml
@@ -0,0 +1,225 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+
+#include "miniml/Opcode.h"
+using namespace miniml;
+
+
+/// Names of opcodes.
+static const char *kNames[] = {
+  "ACC0",
+  "ACC1",
+  "ACC2",
+  "ACC3",
+  "ACC4",
+  "ACC5",
+  "ACC6",
+  "ACC7",
+  "ACC",
+  "PUSH",
+  "PUSHACC0",
+  "PUSHACC1",
+  "PUSHACC2",
+  "PUSHACC3",
+  "PUSHACC4",
+  "PUSHACC5",
+  "PUSHACC6",
+  "PUSHACC7",
+  "PUSHACC",
+  "POP",
+  "ASSIGN",
+  "ENVACC1",
+  "ENVACC2",
+  "ENVACC3",
+  "ENVACC4",
+  "ENVACC",
+  "PUSHENVACC1",
+  "PUSHENVACC2",
+  "PUSHENVACC3",
+  "PUSHENVACC4",
+  "PUSHENVACC",
+  "PUSH_RETADDR",
+  "APPLY",
+  "APPLY1",
+  "APPLY2",
+  "APPLY3",
+  "APPTERM",
+  "APPTERM1",
+  "APPTERM2",
+  "APPTERM3",
+  "RETURN",
+  "RESTART",
+  "GRAB",
+  "CLOSURE",
+  "CLOSUREREC",
+  "OFFSETCLOSUREM2",
+  "OFFSETCLOSURE0",
+  "OFFSETCLOSURE2",
+  "OFFSETCLOSURE",
+  "PUSHOFFSETCLOSUREM2",
+  "PUSHOFFSETCLOSURE0",
+  "PUSHOFFSETCLOSURE2",
+  "PUSHOFFSETCLOSURE",
+  "GETGLOBAL",
+  "PUSHGETGLOBAL",
+  "GETGLOBALFIELD",
+  "PUSHGETGLOBALFIELD",
+  "SETGLOBAL",
+  "ATOM0",
+  "ATOM",
+  "PUSHATOM0",
+  "PUSHATOM",
+  "MAKEBLOCK",
+  "MAKEBLOCK1",
+  "MAKEBLOCK2",
+  "MAKEBLOCK3",
+  "MAKEFLOATBLOCK",
+  "GETFIELD0",
+  "GETFIELD1",
+  "GETFIELD2",
+  "GETFIELD3",
+  "GETFIELD",
+  "GETFLOATFIELD",
+  "SETFIELD0",
+  "SETFIELD1",
+  "SETFIELD2",
+  "SETFIELD3",
+  "SETFIELD",
+  "SETFLOATFIELD",
+  "VECTLENGTH",
+  "GETVECTITEM",
+  "SETVECTITEM",
+  "GETSTRINGCHAR",
+  "SETSTRINGCHAR",
+  "BRANCH",
+  "BRANCHIF",
+  "BRANCHIFNOT",
+  "SWITCH",
+  "BOOLNOT",
+  "PUSHTRAP",
+  "POPTRAP",
+  "RAISE",
+  "CHECK_SIGNALS",
+  "C_CALL1",
+  "C_CALL2",
+  "C_CALL3",
+  "C_CALL4",
+  "C_CALL5",
+  "C_CALLN",
+  "CONST0",
+  "CONST1",
+  "CONST2",
+  "CONST3",
+  "CONSTINT",
+  "PUSHCONST0",
+  "PUSHCONST1",
+  "PUSHCONST2",
+  "PUSHCONST3",
+  "PUSHCONSTINT",
+  "NEGINT",
+  "ADDINT",
+  "SUBINT",
+  "MULINT",
+  "DIVINT",
+  "MODINT",
+  "ANDINT",
+  "ORINT",
+  "XORINT",
+  "LSLINT",
+  "LSRINT",
+  "ASRINT",
+  "EQ",
+  "NEQ",
+  "LTINT",
+  "LEINT",
+  "GTINT",
+  "GEINT",
+  "OFFSETINT",
+  "OFFSETREF",
+  "ISINT",
+  "GETMETHOD",
+  "BEQ",
+  "BNEQ",
+  "BLTINT",
+  "BLEINT",
+  "BGTINT",
+  "BGEINT",
+  "ULTINT",
+  "UGEINT",
+  "BULTINT",
+  "BUGEINT",
+  "GETPUBMET",
+  "GETDYNMET",
+  "STOP",
+  "EVENT",
+  "BREAK",
+};
+
+
+
+// -----------------------------------------------------------------------------
+const char *miniml::getOpcodeName(uint32_t op) {
+  return op < kNumOpcodes ? kNames[op] : "UNKNOWN";
+}
+
+size_t miniml::getInstructionLength(const uint32_t *code, uint64_t pc) {
+  switch (code[pc]) {
+    case ACC: case PUSHACC: case POP: case ASSIGN:
+    case ENVACC: case PUSHENVACC: case PUSH_RETADDR: case APPLY:
+    case APPTERM1: case APPTERM2: case APPTERM3: case RETURN: case GRAB:
+    case OFFSETCLOSURE: case PUSHOFFSETCLOSURE:
+    case GETGLOBAL: case PUSHGETGLOBAL: case SETGLOBAL:
+    case ATOM: case PUSHATOM:
+    case MAKEBLOCK1: case MAKEBLOCK2: case MAKEBLOCK3: case MAKEFLOATBLOCK:
+    case GETFIELD: case GETFLOATFIELD: case SETFIELD: case SETFLOATFIELD:
+    case BRANCH: case BRANCHIF: case BRANCHIFNOT: case PUSHTRAP:
+    case C_CALL1: case C_CALL2: case C_CALL3: case C_CALL4: case C_CALL5:
+    case CONSTINT: case PUSHCONSTINT: case OFFSETINT: case OFFSETREF:
+    case FLOATOP:
+      return 2;
+    case APPTERM: case CLOSURE:
+    case GETGLOBALFIELD: case PUSHGETGLOBALFIELD: case MAKEBLOCK:
+    case C_CALLN:
+    case BEQ: case BNEQ: case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+    case BULTINT: case BUGEINT:
+    case GETPUBMET:
+      return 3;
+    case CLOSUREREC:
+      return 3 + code[pc + 1];
+    case SWITCH: {
+      const uint32_t n = code[pc + 1];
+      return 2 + (n & 0xFFFF) + (n >> 16);
+    }
+    default:
+      return 1;
+  }
+}
+
+std::vector<uint64_t> miniml::findFunctions(const uint32_t *code, size_t size) {
+  std::vector<uint64_t> entries{ 0 };
+  for (uint64_t pc = 0; pc < size; pc += getInstructionLength(code, pc)) {
+    switch (code[pc]) {
+      case CLOSURE: {
+        entries.push_back(pc + 2 + static_cast<int32_t>(code[pc + 2]));
+        break;
+      }
+      case CLOSUREREC: {
+        const uint64_t ofs = pc + 3;
+        for (uint32_t i = 0, n = code[pc + 1]; i < n; ++i) {
+          entries.push_back(ofs + static_cast<int32_t>(code[ofs + i]));
+        }
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  std::sort(entries.begin(), entries.end());
+  entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+  return entries;
+}
@@ -0,0 +1,186 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+namespace miniml {
+
+/// Bytecode instructions.
+enum Opcode {
+  ACC0                =   0,
+  ACC1                =   1,
+  ACC2                =   2,
+  ACC3                =   3,
+  ACC4                =   4,
+  ACC5                =   5,
+  ACC6                =   6,
+  ACC7                =   7,
+  ACC                 =   8,
+  PUSH                =   9,
+  PUSHACC0            =  10,
+  PUSHACC1            =  11,
+  PUSHACC2            =  12,
+  PUSHACC3            =  13,
+  PUSHACC4            =  14,
+  PUSHACC5            =  15,
+  PUSHACC6            =  16,
+  PUSHACC7            =  17,
+  PUSHACC             =  18,
+  POP                 =  19,
+  ASSIGN              =  20,
+  ENVACC1             =  21,
+  ENVACC2             =  22,
+  ENVACC3             =  23,
+  ENVACC4             =  24,
+  ENVACC              =  25,
+  PUSHENVACC1         =  26,
+  PUSHENVACC2         =  27,
+  PUSHENVACC3         =  28,
+  PUSHENVACC4         =  29,
+  PUSHENVACC          =  30,
+  PUSH_RETADDR        =  31,
+  APPLY               =  32,
+  APPLY1              =  33,
+  APPLY2              =  34,
+  APPLY3              =  35,
+  APPTERM             =  36,
+  APPTERM1            =  37,
+  APPTERM2            =  38,
+  APPTERM3            =  39,
+  RETURN              =  40,
+  RESTART             =  41,
+  GRAB                =  42,
+  CLOSURE             =  43,
+  CLOSUREREC          =  44,
+  OFFSETCLOSUREM2     =  45,
+  OFFSETCLOSURE0      =  46,
+  OFFSETCLOSURE2      =  47,
+  OFFSETCLOSURE       =  48,
+  PUSHOFFSETCLOSUREM2 =  49,
+  PUSHOFFSETCLOSURE0  =  50,
+  PUSHOFFSETCLOSURE2  =  51,
+  PUSHOFFSETCLOSURE   =  52,
+  GETGLOBAL           =  53,
+  PUSHGETGLOBAL       =  54,
+  GETGLOBALFIELD      =  55,
+  PUSHGETGLOBALFIELD  =  56,
+  SETGLOBAL           =  57,
+  ATOM0               =  58,
+  ATOM                =  59,
+  PUSHATOM0           =  60,
+  PUSHATOM            =  61,
+  MAKEBLOCK           =  62,
+  MAKEBLOCK1          =  63,
+  MAKEBLOCK2          =  64,
+  MAKEBLOCK3          =  65,
+  MAKEFLOATBLOCK      =  66,
+  GETFIELD0           =  67,
+  GETFIELD1           =  68,
+  GETFIELD2           =  69,
+  GETFIELD3           =  70,
+  GETFIELD            =  71,
+  GETFLOATFIELD       =  72,
+  SETFIELD0           =  73,
+  SETFIELD1           =  74,
+  SETFIELD2           =  75,
+  SETFIELD3           =  76,
+  SETFIELD            =  77,
+  SETFLOATFIELD       =  78,
+  VECTLENGTH          =  79,
+  GETVECTITEM         =  80,
+  SETVECTITEM         =  81,
+  GETSTRINGCHAR       =  82,
+  SETSTRINGCHAR       =  83,
+  BRANCH              =  84,
+  BRANCHIF            =  85,
+  BRANCHIFNOT         =  86,
+  SWITCH              =  87,
+  BOOLNOT             =  88,
+  PUSHTRAP            =  89,
+  POPTRAP             =  90,
+  RAISE               =  91,
+  CHECK_SIGNALS       =  92,
+  C_CALL1             =  93,
+  C_CALL2             =  94,
+  C_CALL3             =  95,
+  C_CALL4             =  96,
+  C_CALL5             =  97,
+  C_CALLN             =  98,
+  CONST0              =  99,
+  CONST1              = 100,
+  CONST2              = 101,
+  CONST3              = 102,
+  CONSTINT            = 103,
+  PUSHCONST0          = 104,
+  PUSHCONST1          = 105,
+  PUSHCONST2          = 106,
+  PUSHCONST3          = 107,
+  PUSHCONSTINT        = 108,
+  NEGINT              = 109,
+  ADDINT              = 110,
+  SUBINT              = 111,
+  MULINT              = 112,
+  DIVINT              = 113,
+  MODINT              = 114,
+  ANDINT              = 115,
+  ORINT               = 116,
+  XORINT              = 117,
+  LSLINT              = 118,
+  LSRINT              = 119,
+  ASRINT              = 120,
+  EQ                  = 121,
+  NEQ                 = 122,
+  LTINT               = 123,
+  LEINT               = 124,
+  GTINT               = 125,
+  GEINT               = 126,
+  OFFSETINT           = 127,
+  OFFSETREF           = 128,
+  ISINT               = 129,
+  GETMETHOD           = 130,
+  BEQ                 = 131,
+  BNEQ                = 132,
+  BLTINT              = 133,
+  BLEINT              = 134,
+  BGTINT              = 135,
+  BGEINT              = 136,
+  ULTINT              = 137,
+  UGEINT              = 138,
+  BULTINT             = 139,
+  BUGEINT             = 140,
+  GETPUBMET           = 141,
+  GETDYNMET           = 142,
+  STOP                = 143,
+  EVENT               = 144,
+  BREAK               = 145,
+};
+
+/// Number of opcodes.
+static const unsigned kNumOpcodes = BREAK + 1;
+
+/// Instructions which code is rewritten into when it is loaded. They are
+/// never found in bytecode files.
+enum InternalOpcode {
+  /// Calls a float primitive, like C_CALL1 or C_CALL2.
+  FLOATOP             = kNumOpcodes,
+};
+
+/// Returns the name of an opcode.
+const char *getOpcodeName(uint32_t op);
+
+/// Returns the number of words of the instruction at pc, including the
+/// opcode and all of its operands.
+size_t getInstructionLength(const uint32_t *code, uint64_t pc);
+
+/// Returns the sorted entry points of the toplevel code and of all
+/// functions created by CLOSURE and CLOSUREREC in the code.
+std::vector<uint64_t> findFunctions(const uint32_t *code, size_t size);
+
+} // namespace miniml
@@ -0,0 +1,127 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+#include <vector>
+
+#include "miniml/OpcodeStats.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// OpcodeStats
+// -----------------------------------------------------------------------------
+volatile sig_atomic_t OpcodeStats::dumpPending = 0;
+
+OpcodeStats::OpcodeStats(const std::string &path)
+  : path_(path)
+  , lastOp_(kNumOpcodes)
+  , lastPC_(0)
+  , lastBranch_(false)
+{
+  memset(counts_, 0, sizeof(counts_));
+  memset(pairs_, 0, sizeof(pairs_));
+
+  struct sigaction sa;
+  sa.sa_handler = [](int) { dumpPending = 1; };
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR2, &sa, nullptr);
+}
+
+OpcodeStats::~OpcodeStats() {
+  write();
+}
+
+bool OpcodeStats::isBranch(uint32_t op) {
+  switch (op) {
+    case BRANCHIF: case BRANCHIFNOT:
+    case BEQ: case BNEQ:
+    case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+    case BULTINT: case BUGEINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void OpcodeStats::recordBranch(uint64_t pc) {
+  // Conditional branches fall through past their operands: one offset,
+  // preceded by a constant for the compare-and-branch instructions.
+  const uint64_t next = lastPC_ + (lastOp_ <= BRANCHIFNOT ? 2 : 3);
+  Branch &branch = branches_[lastPC_];
+  branch.executed += 1;
+  if (pc != next) {
+    branch.taken += 1;
+  }
+}
+
+void OpcodeStats::write() {
+  std::ofstream os(path_);
+  if (os) {
+    write(os);
+  }
+}
+
+void OpcodeStats::write(std::ostream &os) const {
+  os << "{\n  \"opcodes\": {";
+  bool first = true;
+  for (unsigned op = 0; op < kNumOpcodes; ++op) {
+    if (counts_[op] == 0) {
+      continue;
+    }
+    os << (first ? "\n" : ",\n");
+    os << "    \"" << getOpcodeName(op) << "\": " << counts_[op];
+    first = false;
+  }
+  os << "\n  },\n";
+
+  // Pairs and branches are sorted by decreasing count.
+  std::vector<std::tuple<uint64_t, unsigned, unsigned>> pairs;
+  for (unsigned i = 0; i < kNumOpcodes; ++i) {
+    for (unsigned j = 0; j < kNumOpcodes; ++j) {
+      if (pairs_[i][j]) {
+        pairs.emplace_back(pairs_[i][j], i, j);
+      }
+    }
+  }
+  std::sort(pairs.rbegin(), pairs.rend());
+
+  os << "  \"pairs\": [";
+  first = true;
+  for (const auto &pair : pairs) {
+    os << (first ? "\n" : ",\n");
+    os << "    { \"first\": \"" << getOpcodeName(std::get<1>(pair)) << "\", "
+       << "\"second\": \"" << getOpcodeName(std::get<2>(pair)) << "\", "
+       << "\"count\": " << std::get<0>(pair) << " }";
+    first = false;
+  }
+  os << "\n  ],\n";
+
+  std::vector<std::pair<uint64_t, Branch>> branches(
+      branches_.begin(),
+      branches_.end());
+  std::sort(
+      branches.begin(), branches.end(),
+      [](const std::pair<uint64_t, Branch> &a,
+         const std::pair<uint64_t, Branch> &b)
+      {
+        return a.second.taken > b.second.taken;
+      });
+
+  os << "  \"branches\": [";
+  first = true;
+  for (const auto &branch : branches) {
+    os << (first ? "\n" : ",\n");
+    os << "    { \"pc\": " << branch.first << ", "
+       << "\"executed\": " << branch.second.executed << ", "
+       << "\"taken\": " << branch.second.taken << " }";
+    first = false;
+  }
+  os << "\n  ]\n}\n";
+}
@@ -0,0 +1,86 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "miniml/Opcode.h"
+
+
+
+namespace miniml {
+
+/// Execution counters of the instrumented interpreter, built with
+/// MINIML_OPCODE_STATS: counts of opcodes, of pairs of consecutive
+/// opcodes and of taken branches. The counters are written as JSON when
+/// the object is destroyed or when the process receives SIGUSR2.
+class OpcodeStats {
+ public:
+  /// Creates the counters, to be written to a file.
+  OpcodeStats(const std::string &path);
+  /// Writes the counters.
+  ~OpcodeStats();
+
+  /// Records the instruction at pc, about to be executed.
+  void record(uint64_t pc, uint32_t op) {
+    if (op < kNumOpcodes) {
+      counts_[op] += 1;
+      if (lastOp_ < kNumOpcodes) {
+        pairs_[lastOp_][op] += 1;
+      }
+    }
+    if (lastBranch_) {
+      recordBranch(pc);
+    }
+    lastOp_ = op;
+    lastPC_ = pc;
+    lastBranch_ = isBranch(op);
+    if (dumpPending) {
+      dumpPending = 0;
+      write();
+    }
+  }
+
+  /// Writes the counters to the file.
+  void write();
+  /// Writes the counters to a stream.
+  void write(std::ostream &os) const;
+
+ private:
+  /// Flag set by the signal handler when the counters should be written.
+  static volatile sig_atomic_t dumpPending;
+
+  /// Checks if an opcode is a direct branch.
+  static bool isBranch(uint32_t op);
+  /// Records the outcome of the branch at lastPC_, given the next PC.
+  void recordBranch(uint64_t pc);
+
+  /// Execution counts of a branch.
+  struct Branch {
+    uint64_t executed;
+    uint64_t taken;
+  };
+
+ private:
+  /// Path to write the counters to.
+  std::string path_;
+  /// Counts of opcodes.
+  uint64_t counts_[kNumOpcodes];
+  /// Counts of pairs of opcodes.
+  uint64_t pairs_[kNumOpcodes][kNumOpcodes];
+  /// Counts of branches, by PC.
+  std::unordered_map<uint64_t, Branch> branches_;
+  /// Previous instruction.
+  uint32_t lastOp_;
+  uint64_t lastPC_;
+  /// Flag indicating whether the previous instruction was a branch.
+  bool lastBranch_;
+};
+
+} // namespace miniml
@@ -0,0 +1,672 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <limits>
+
+#include "miniml/CodeAnalysis.h"
+#include "miniml/Opcode.h"
+#include "miniml/Optimizer.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+namespace {
+
+/// Maximal number of jumps followed when threading.
+static const unsigned kMaxHops = 16;
+/// Maximal number of rounds of optimization.
+static const unsigned kMaxRounds = 8;
+/// Largest magnitude of an OFFSETINT operand, which is shifted as an int.
+static const int64_t kMaxOffset = (1 << 29) - 1;
+
+/// Operand holding an offset, relative to another word of the instruction.
+struct Reloc {
+  unsigned operand;
+  unsigned base;
+};
+
+/// Finds the operands of an instruction which hold code offsets.
+void getRelocs(const std::vector<uint32_t> &ops, std::vector<Reloc> &relocs) {
+  relocs.clear();
+  switch (ops[0]) {
+    case BRANCH: case BRANCHIF: case BRANCHIFNOT: case PUSHTRAP:
+    case PUSH_RETADDR: {
+      relocs.push_back({ 1, 1 });
+      break;
+    }
+    case BEQ: case BNEQ: case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+    case BULTINT: case BUGEINT: case CLOSURE: {
+      relocs.push_back({ 2, 2 });
+      break;
+    }
+    case SWITCH: {
+      for (uint32_t i = 0; i < (ops[1] & 0xFFFF) + (ops[1] >> 16); ++i) {
+        relocs.push_back({ 2 + i, 2 });
+      }
+      break;
+    }
+    case CLOSUREREC: {
+      for (uint32_t i = 0; i < ops[1]; ++i) {
+        relocs.push_back({ 3 + i, 3 });
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+/// Checks if an instruction is a conditional or unconditional jump.
+bool isJump(uint32_t op) {
+  switch (op) {
+    case BRANCH: case BRANCHIF: case BRANCHIFNOT: case SWITCH:
+    case BEQ: case BNEQ: case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+    case BULTINT: case BUGEINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Checks if an integer fits in an instruction operand.
+bool isInt32(int64_t n) {
+  return std::numeric_limits<int32_t>::min() <= n &&
+         n <= std::numeric_limits<int32_t>::max();
+}
+
+/// Decodes an instruction loading a constant into the accumulator.
+bool getConst(const std::vector<uint32_t> &ops, int64_t &n, bool &push) {
+  switch (ops[0]) {
+    case CONST0: case CONST1: case CONST2: case CONST3: {
+      n = ops[0] - CONST0;
+      push = false;
+      return true;
+    }
+    case CONSTINT: {
+      n = static_cast<int32_t>(ops[1]);
+      push = false;
+      return true;
+    }
+    case PUSHCONST0: case PUSHCONST1: case PUSHCONST2: case PUSHCONST3: {
+      n = ops[0] - PUSHCONST0;
+      push = true;
+      return true;
+    }
+    case PUSHCONSTINT: {
+      n = static_cast<int32_t>(ops[1]);
+      push = true;
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+/// Encodes an instruction loading a constant.
+std::vector<uint32_t> makeConst(int32_t n, bool push) {
+  if (0 <= n && n < 4) {
+    return { static_cast<uint32_t>((push ? PUSHCONST0 : CONST0) + n) };
+  }
+  return { push ? PUSHCONSTINT : CONSTINT, static_cast<uint32_t>(n) };
+}
+
+/// Encodes an instruction loading a stack slot.
+std::vector<uint32_t> makeAcc(uint32_t n, bool push) {
+  if (n < 8) {
+    return { (push ? PUSHACC0 : ACC0) + n };
+  }
+  return { push ? PUSHACC : ACC, n };
+}
+
+/// Removes the push from an instruction pushing the accumulator before
+/// loading a new value into it. The result is empty if nothing is left.
+bool dropPush(std::vector<uint32_t> &ops) {
+  switch (ops[0]) {
+    case PUSH: case PUSHACC0: {
+      ops.clear();
+      return true;
+    }
+    case PUSHACC1: case PUSHACC2: case PUSHACC3: case PUSHACC4:
+    case PUSHACC5: case PUSHACC6: case PUSHACC7: {
+      ops = makeAcc(ops[0] - PUSHACC0 - 1, false);
+      return true;
+    }
+    case PUSHACC: {
+      if (ops[1] == 0) {
+        ops.clear();
+      } else {
+        ops = makeAcc(ops[1] - 1, false);
+      }
+      return true;
+    }
+    case PUSHENVACC1: case PUSHENVACC2: case PUSHENVACC3: case PUSHENVACC4:
+    case PUSHENVACC: {
+      ops[0] = ops[0] - PUSHENVACC1 + ENVACC1;
+      return true;
+    }
+    case PUSHOFFSETCLOSUREM2: case PUSHOFFSETCLOSURE0:
+    case PUSHOFFSETCLOSURE2: case PUSHOFFSETCLOSURE: {
+      ops[0] = ops[0] - PUSHOFFSETCLOSUREM2 + OFFSETCLOSUREM2;
+      return true;
+    }
+    case PUSHGETGLOBAL: {
+      ops[0] = GETGLOBAL;
+      return true;
+    }
+    case PUSHGETGLOBALFIELD: {
+      ops[0] = GETGLOBALFIELD;
+      return true;
+    }
+    case PUSHATOM0: {
+      ops[0] = ATOM0;
+      return true;
+    }
+    case PUSHATOM: {
+      ops[0] = ATOM;
+      return true;
+    }
+    case PUSHCONST0: case PUSHCONST1: case PUSHCONST2: case PUSHCONST3:
+    case PUSHCONSTINT: {
+      ops[0] = ops[0] - PUSHCONST0 + CONST0;
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+/// Evaluates a compare-and-branch on a constant, as the interpreter does.
+bool evalBranch(const std::vector<uint32_t> &ops, int64_t a) {
+  const uint32_t v = ops[1];
+  switch (ops[0]) {
+    case BEQ: return v == a;
+    case BNEQ: return v != a;
+    case BLTINT: return v < a;
+    case BLEINT: return v <= a;
+    case BGTINT: return v > a;
+    case BGEINT: return v >= a;
+    case BULTINT: return static_cast<uint64_t>(v) < static_cast<uint64_t>(a);
+    case BUGEINT: return static_cast<uint64_t>(v) >= static_cast<uint64_t>(a);
+    default: __builtin_unreachable();
+  }
+}
+
+/// Evaluates a unary operation on a constant accumulator.
+bool evalUnary(const std::vector<uint32_t> &ops, int64_t a, int64_t &r) {
+  switch (ops[0]) {
+    case NEGINT: {
+      r = -a;
+      return true;
+    }
+    case OFFSETINT: {
+      const int64_t ofs = static_cast<int32_t>(ops[1]);
+      if (ofs < -kMaxOffset || kMaxOffset < ofs) {
+        return false;
+      }
+      r = a + ofs;
+      return true;
+    }
+    case BOOLNOT: {
+      r = a == 0;
+      return true;
+    }
+    case ISINT: {
+      r = 1;
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+/// Evaluates a binary operation on a constant accumulator and stack top.
+bool evalBinary(uint32_t op, int64_t a, int64_t b, int64_t &r) {
+  switch (op) {
+    case ADDINT: r = a + b; return true;
+    case SUBINT: r = a - b; return true;
+    case MULINT: r = a * b; return true;
+    case ANDINT: r = a & b; return true;
+    case ORINT: r = a | b; return true;
+    case XORINT: r = a ^ b; return true;
+    case DIVINT: case MODINT: {
+      // Division by zero raises an exception at runtime. The interpreter
+      // divides unsigned values, so only positive operands are folded.
+      if (a < 0 || b <= 0) {
+        return false;
+      }
+      r = op == DIVINT ? a / b : a % b;
+      return true;
+    }
+    case LSLINT: case LSRINT: case ASRINT: {
+      // Shifts are folded if they cannot overflow or reach the sign bit.
+      if (b < 0 || b >= 32 || (op == LSRINT && a < 0)) {
+        return false;
+      }
+      r = op == LSLINT ? a * (INT64_C(1) << b) : a >> b;
+      return true;
+    }
+    case EQ: r = a == b; return true;
+    case NEQ: r = a != b; return true;
+    case LTINT: case LEINT: case GTINT: case GEINT: {
+      // The interpreter compares values as unsigned words, which agrees
+      // with signed comparison on non-negative integers only.
+      if (a < 0 || b < 0) {
+        return false;
+      }
+      switch (op) {
+        case LTINT: r = a < b; break;
+        case LEINT: r = a <= b; break;
+        case GTINT: r = a > b; break;
+        default: r = a >= b; break;
+      }
+      return true;
+    }
+    case ULTINT: {
+      r = static_cast<uint64_t>(a) < static_cast<uint64_t>(b);
+      return true;
+    }
+    case UGEINT: {
+      r = static_cast<uint64_t>(a) >= static_cast<uint64_t>(b);
+      return true;
+    }
+    default: {
+      return false;
+    }
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Optimizer
+// -----------------------------------------------------------------------------
+class Optimizer {
+ public:
+  /// Decodes the instructions of a program.
+  Optimizer(const uint32_t *code, size_t size);
+
+  /// Optimizes the program until nothing changes.
+  void run();
+  /// Encodes the optimized program.
+  void emit(std::vector<uint32_t> &optimized, std::vector<uint32_t> &pcMap);
+
+ private:
+  /// Threads jumps to jumps and removes jumps to the next instruction.
+  void thread();
+  /// Follows the jumps from the target of a jump.
+  size_t follow(uint32_t op, size_t target) const;
+  /// Folds constants and removes pushes followed by pops.
+  void fold();
+  /// Folds a pair of instructions. Returns true if they were changed.
+  bool foldPair(size_t i, size_t j, const std::vector<bool> &targeted);
+  /// Removes unreachable instructions.
+  void prune();
+
+  /// Finds the first instruction at or after an index which was kept.
+  size_t resolve(size_t i) const {
+    while (i < insts_.size() && insts_[i].removed) {
+      ++i;
+    }
+    return i;
+  }
+  /// Finds the instruction executed after another one.
+  size_t next(size_t i) const { return resolve(i + 1); }
+  /// Removes an instruction.
+  void remove(size_t i) {
+    insts_[i].removed = true;
+    insts_[i].targets.clear();
+    changed_ = true;
+  }
+
+ private:
+  /// Instruction being optimized.
+  struct Inst {
+    /// PC and length in the original code.
+    uint64_t pc;
+    uint64_t length;
+    /// Opcode and operands.
+    std::vector<uint32_t> ops;
+    /// Indices of the instructions referenced by offsets, in the order of
+    /// the operands holding them.
+    std::vector<size_t> targets;
+    /// Flag indicating whether the instruction was removed.
+    bool removed;
+  };
+
+  /// Size of the original code.
+  size_t size_;
+  /// Instructions, in program order.
+  std::vector<Inst> insts_;
+  /// Flag indicating whether the current round changed anything.
+  bool changed_;
+};
+
+Optimizer::Optimizer(const uint32_t *code, size_t size)
+  : size_(size)
+  , changed_(false)
+{
+  std::vector<size_t> index(size, 0);
+  for (uint64_t pc = 0; pc < size; ) {
+    const uint64_t length = getInstructionLength(code, pc);
+    index[pc] = insts_.size();
+    insts_.push_back({
+        pc,
+        length,
+        std::vector<uint32_t>(code + pc, code + pc + length),
+        {},
+        false
+    });
+    pc += length;
+  }
+
+  std::vector<Reloc> relocs;
+  for (auto &inst : insts_) {
+    getRelocs(inst.ops, relocs);
+    for (const auto &reloc : relocs) {
+      const int32_t ofs = inst.ops[reloc.operand];
+      inst.targets.push_back(index[inst.pc + reloc.base + ofs]);
+    }
+  }
+}
+
+void Optimizer::run() {
+  prune();
+  for (unsigned round = 0; round < kMaxRounds; ++round) {
+    changed_ = false;
+    thread();
+    fold();
+    prune();
+    if (!changed_) {
+      break;
+    }
+  }
+}
+
+void Optimizer::emit(
+    std::vector<uint32_t> &optimized,
+    std::vector<uint32_t> &pcMap)
+{
+  // Removed instructions are placed at the start of the next one.
+  std::vector<uint32_t> position(insts_.size() + 1);
+  uint32_t pc = 0;
+  for (size_t i = 0; i < insts_.size(); ++i) {
+    position[i] = pc;
+    if (!insts_[i].removed) {
+      pc += insts_[i].ops.size();
+    }
+  }
+  position[insts_.size()] = pc;
+
+  pcMap.resize(size_ + 1);
+  for (size_t i = 0; i < insts_.size(); ++i) {
+    const Inst &inst = insts_[i];
+    for (uint64_t j = 0; j < inst.length; ++j) {
+      pcMap[inst.pc + j] = position[i];
+    }
+  }
+  pcMap[size_] = pc;
+
+  optimized.clear();
+  optimized.reserve(pc);
+  std::vector<Reloc> relocs;
+  for (size_t i = 0; i < insts_.size(); ++i) {
+    Inst &inst = insts_[i];
+    if (inst.removed) {
+      continue;
+    }
+    getRelocs(inst.ops, relocs);
+    for (size_t j = 0; j < relocs.size(); ++j) {
+      const int64_t base = position[i] + relocs[j].base;
+      inst.ops[relocs[j].operand] = position[inst.targets[j]] - base;
+    }
+    optimized.insert(optimized.end(), inst.ops.begin(), inst.ops.end());
+  }
+}
+
+void Optimizer::thread() {
+  for (size_t i = resolve(0); i < insts_.size(); i = next(i)) {
+    Inst &inst = insts_[i];
+    if (!isJump(inst.ops[0])) {
+      continue;
+    }
+
+    for (auto &target : inst.targets) {
+      const size_t to = follow(inst.ops[0], target);
+      if (to != target) {
+        target = to;
+        changed_ = true;
+      }
+    }
+
+    if (inst.ops[0] == SWITCH) {
+      continue;
+    }
+    const size_t to = resolve(inst.targets[0]);
+    if (to == next(i)) {
+      // Both outcomes of the jump continue with the next instruction.
+      remove(i);
+    } else if (inst.ops[0] == BRANCH && insts_[to].ops[0] == RETURN) {
+      // Jumps to returns are replaced by returns.
+      inst.ops = insts_[to].ops;
+      inst.targets.clear();
+      changed_ = true;
+    }
+  }
+}
+
+size_t Optimizer::follow(uint32_t op, size_t target) const {
+  // The number of hops is bounded since jumps might form a cycle.
+  for (unsigned hop = 0; hop < kMaxHops; ++hop) {
+    const size_t i = resolve(target);
+    const Inst &inst = insts_[i];
+    switch (inst.ops[0]) {
+      case BRANCH: {
+        target = inst.targets[0];
+        continue;
+      }
+      case BRANCHIF: case BRANCHIFNOT: {
+        // The accumulator does not change along a jump, so the outcome of
+        // a test following a test is known.
+        if (op != BRANCHIF && op != BRANCHIFNOT) {
+          return target;
+        }
+        target = (op == inst.ops[0]) ? inst.targets[0] : i + 1;
+        continue;
+      }
+      default: {
+        return target;
+      }
+    }
+  }
+  return target;
+}
+
+void Optimizer::fold() {
+  // Instructions which are jumped to cannot be folded into others.
+  std::vector<bool> targeted(insts_.size(), false);
+  for (const auto &inst : insts_) {
+    for (size_t target : inst.targets) {
+      const size_t i = resolve(target);
+      if (i < insts_.size()) {
+        targeted[i] = true;
+      }
+    }
+  }
+
+  for (size_t i = resolve(0); i < insts_.size(); i = next(i)) {
+    Inst &inst = insts_[i];
+    if (inst.ops[0] == POP && inst.ops[1] == 0) {
+      remove(i);
+      continue;
+    }
+    const size_t j = next(i);
+    if (j < insts_.size() && !targeted[j] && foldPair(i, j, targeted)) {
+      // Jumps to a removed instruction now reach the next one.
+      if (targeted[i] && insts_[i].removed) {
+        targeted[j] = true;
+      }
+      changed_ = true;
+    }
+  }
+}
+
+bool Optimizer::foldPair(
+    size_t i,
+    size_t j,
+    const std::vector<bool> &targeted)
+{
+  Inst &a = insts_[i];
+  Inst &b = insts_[j];
+
+  // Values pushed and popped right away are not pushed.
+  if (b.ops[0] == POP) {
+    if (a.ops[0] == POP) {
+      a.ops[1] += b.ops[1];
+      remove(j);
+      return true;
+    }
+    if (b.ops[1] > 0 && dropPush(a.ops)) {
+      if (a.ops.empty()) {
+        remove(i);
+      }
+      if (--b.ops[1] == 0) {
+        remove(j);
+      }
+      return true;
+    }
+    return false;
+  }
+
+  int64_t n;
+  bool push;
+  if (!getConst(a.ops, n, push)) {
+    return false;
+  }
+
+  switch (b.ops[0]) {
+    case BRANCHIF: case BRANCHIFNOT: {
+      // Tests of constants jump or fall through.
+      if ((n != 0) == (b.ops[0] == BRANCHIF)) {
+        b.ops[0] = BRANCH;
+      } else {
+        remove(j);
+      }
+      return true;
+    }
+    case BEQ: case BNEQ: case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+    case BULTINT: case BUGEINT: {
+      if (evalBranch(b.ops, n)) {
+        b.ops = { BRANCH, 0 };
+      } else {
+        remove(j);
+      }
+      return true;
+    }
+    case PUSHCONST0: case PUSHCONST1: case PUSHCONST2: case PUSHCONST3:
+    case PUSHCONSTINT: {
+      // Operations on two constants are evaluated.
+      const size_t k = next(j);
+      if (k >= insts_.size() || targeted[k]) {
+        return false;
+      }
+      int64_t m, r;
+      bool mpush;
+      getConst(b.ops, m, mpush);
+      if (!evalBinary(insts_[k].ops[0], m, n, r) || !isInt32(r)) {
+        return false;
+      }
+      a.ops = makeConst(r, push);
+      remove(j);
+      remove(k);
+      return true;
+    }
+    case PUSHACC1: case PUSHACC2: case PUSHACC3: case PUSHACC4:
+    case PUSHACC5: case PUSHACC6: case PUSHACC7: case PUSHACC: {
+      // Constants added to stack slots become offsets.
+      const size_t k = next(j);
+      if (k >= insts_.size() || targeted[k]) {
+        return false;
+      }
+      const uint32_t op = insts_[k].ops[0];
+      if (op != ADDINT && op != SUBINT) {
+        return false;
+      }
+      const uint32_t slot =
+          b.ops[0] == PUSHACC ? b.ops[1] : b.ops[0] - PUSHACC0;
+      if (slot == 0 || n < -kMaxOffset || kMaxOffset < n) {
+        return false;
+      }
+      a.ops = makeAcc(slot - 1, push);
+      b.ops = { OFFSETINT, static_cast<uint32_t>(op == ADDINT ? n : -n) };
+      remove(k);
+      return true;
+    }
+    default: {
+      int64_t r;
+      if (!evalUnary(b.ops, n, r) || !isInt32(r)) {
+        return false;
+      }
+      a.ops = makeConst(r, push);
+      remove(j);
+      return true;
+    }
+  }
+}
+
+void Optimizer::prune() {
+  std::vector<bool> live(insts_.size(), false);
+  std::vector<size_t> queue{ 0 };
+  std::vector<uint64_t> targets;
+  while (!queue.empty()) {
+    const size_t i = resolve(queue.back());
+    queue.pop_back();
+    if (i >= insts_.size() || live[i]) {
+      continue;
+    }
+    live[i] = true;
+
+    const Inst &inst = insts_[i];
+    queue.insert(queue.end(), inst.targets.begin(), inst.targets.end());
+    targets.clear();
+    if (CodeAnalysis::getTargets(inst.ops.data(), 0, targets)) {
+      queue.push_back(i + 1);
+    }
+  }
+
+  for (size_t i = 0; i < insts_.size(); ++i) {
+    if (live[i] || insts_[i].removed) {
+      continue;
+    }
+    // Partial applications resume at the RESTART before a GRAB.
+    if (insts_[i].ops[0] == RESTART && i + 1 < insts_.size() && live[i + 1]) {
+      continue;
+    }
+    remove(i);
+  }
+}
+
+} // namespace
+
+
+
+// -----------------------------------------------------------------------------
+// Entry point
+// -----------------------------------------------------------------------------
+void miniml::optimizeCode(
+    const uint32_t *code,
+    size_t size,
+    std::vector<uint32_t> &optimized,
+    std::vector<uint32_t> &pcMap)
+{
+  Optimizer optimizer(code, size);
+  optimizer.run();
+  optimizer.emit(optimized, pcMap);
+}
@@ -0,0 +1,28 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+namespace miniml {
+
+/// Rewrites verified code into an equivalent, faster program.
+///
+/// Jumps to jumps are threaded, constants are folded into arithmetic and
+/// conditional branches, values pushed and popped immediately are not
+/// pushed at all and unreachable code is removed. The PC map is indexed by
+/// original PCs and points to the new location of each instruction, or to
+/// the instruction following it if it was removed.
+void optimizeCode(
+    const uint32_t *code,
+    size_t size,
+    std::vector<uint32_t> &optimized,
+    std::vector<uint32_t> &pcMap);
+
+} // namespace miniml
@@ -0,0 +1,87 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <stdexcept>
+
+#include <sys/time.h>
+
+#include "miniml/Profiler.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static void setTimer(uint64_t interval) {
+  struct itimerval timer;
+  timer.it_interval.tv_sec = interval / 1000000;
+  timer.it_interval.tv_usec = interval % 1000000;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+static void onProfile(int) {
+  Profiler::pending = 1;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Profiler
+// -----------------------------------------------------------------------------
+volatile sig_atomic_t Profiler::pending = 0;
+
+Profiler::Profiler(size_t depth)
+  : depth_(depth)
+  , running_(false)
+{
+}
+
+Profiler::~Profiler() {
+  stop();
+}
+
+void Profiler::start(uint64_t interval) {
+  if (interval == 0) {
+    throw std::runtime_error("Invalid profiling interval.");
+  }
+  if (!running_) {
+    struct sigaction sa;
+    sa.sa_handler = onProfile;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGPROF, &sa, &prev_) < 0) {
+      throw std::runtime_error("Cannot install SIGPROF handler.");
+    }
+    running_ = true;
+  }
+  setTimer(interval);
+}
+
+void Profiler::stop() {
+  if (running_) {
+    setTimer(0);
+    sigaction(SIGPROF, &prev_, nullptr);
+    running_ = false;
+    pending = 0;
+  }
+}
+
+void Profiler::record(const uint64_t *pcs, size_t n) {
+  samples_[std::vector<uint64_t>(pcs, pcs + n)] += 1;
+}
+
+void Profiler::write(std::ostream &os, const Symbolizer &sym) const {
+  for (const auto &sample : samples_) {
+    const auto &stack = sample.first;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+      if (it != stack.rbegin()) {
+        os << ";";
+      }
+      os << sym(*it);
+    }
+    os << " " << sample.second << "\n";
+  }
+}
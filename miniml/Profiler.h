@@ -0,0 +1,65 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+
+namespace miniml {
+
+/// Sampling CPU profiler driven by SIGPROF.
+///
+/// The signal handler only raises a flag, which the interpreter polls
+/// before dispatching each instruction. The stack is then walked outside
+/// of the handler, when it is in a consistent state.
+///
+/// Bytecode is interpreted, not compiled, so native profilers such as perf
+/// see only the interpreter loop. This profiler is the only one which
+/// attributes time to OCaml functions.
+class Profiler {
+ public:
+  /// Maps a PC to the name of a frame.
+  typedef std::function<std::string(uint64_t)> Symbolizer;
+
+  /// Flag set by the signal handler when a sample is due.
+  static volatile sig_atomic_t pending;
+
+  /// Creates a profiler sampling at most depth frames.
+  Profiler(size_t depth);
+  /// Stops the timer.
+  ~Profiler();
+
+  /// Starts sampling every interval microseconds of CPU time.
+  void start(uint64_t interval);
+  /// Stops sampling.
+  void stop();
+
+  /// Returns the maximal number of frames recorded.
+  size_t getDepth() const { return depth_; }
+  /// Records a sample, innermost frame first.
+  void record(const uint64_t *pcs, size_t n);
+
+  /// Writes the samples in the collapsed stack format used by flamegraphs.
+  void write(std::ostream &os, const Symbolizer &sym) const;
+
+ private:
+  /// Maximal number of frames recorded.
+  size_t depth_;
+  /// Flag indicating whether the timer is running.
+  bool running_;
+  /// Handler replaced by the profiler.
+  struct sigaction prev_;
+  /// Number of samples of each call stack.
+  std::map<std::vector<uint64_t>, uint64_t> samples_;
+};
+
+} // namespace miniml
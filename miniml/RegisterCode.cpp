@@ -0,0 +1,718 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "miniml/CodeAnalysis.h"
+#include "miniml/FloatOps.h"
+#include "miniml/Opcode.h"
+#include "miniml/RegisterCode.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Translator
+// -----------------------------------------------------------------------------
+namespace {
+
+/// Translates the blocks of a single function.
+class Translator {
+ public:
+  Translator(
+      const uint32_t *code,
+      const FunctionInfo &fn,
+      const std::vector<int32_t> &floatPrims,
+      uint32_t window,
+      RegisterFunction &out)
+    : code_(code)
+    , fn_(fn)
+    , floatPrims_(floatPrims)
+    , window_(window)
+    , out_(out)
+    , state_(out.numRegs)
+    , last_(kNone)
+  {
+  }
+
+  /// Translates a block, or the part of the entry block following a GRAB.
+  void translate(const BasicBlock &block, uint64_t start, bool loop);
+  /// Resolves jump targets once all blocks are translated.
+  bool link();
+
+  /// Returns the labels at PCs.
+  const std::map<uint64_t, uint32_t> &getLabels() const { return labels_; }
+  /// Returns the return points of calls, with their depths.
+  const std::vector<std::pair<uint64_t, int64_t>> &getResumes() const {
+    return resumes_;
+  }
+
+ private:
+  /// Value of a register: another register or an immediate.
+  struct Operand {
+    bool imm;
+    int32_t value;
+  };
+
+  /// Returns the register of a stack slot at a depth relative to entry.
+  uint16_t slot(int64_t depth) const { return 1 + window_ + depth; }
+
+  /// Resets all registers to hold their own value.
+  void reset();
+  /// Returns the register holding the value of another, materializing
+  /// immediates.
+  uint16_t use(uint16_t reg);
+  /// Stores the value of a register into it.
+  void materialize(uint16_t reg);
+  /// Materializes registers referring to one about to be overwritten.
+  void clobber(uint16_t reg);
+  /// Copies the value of a register into another.
+  void copy(uint16_t dst, uint16_t src);
+  /// Assigns an immediate to a register.
+  void setImm(uint16_t dst, int32_t imm);
+  /// Drops the value of slots popped off the stack.
+  void pop(int64_t from, int64_t to);
+  /// Stores all registers live at a depth.
+  void flush(int64_t depth);
+
+  /// Emits an instruction defining the accumulator.
+  void define(RegInst inst);
+  /// Emits an instruction.
+  void emit(RegInst inst) {
+    last_ = kNone;
+    out_.code.push_back(inst);
+  }
+  /// Emits a jump to a PC.
+  void jump(RegOpcode op, uint16_t a, int32_t imm, uint64_t target);
+  /// Returns to the bytecode at a PC.
+  void exit(uint64_t pc, int64_t depth);
+  /// Adds a return point following a call. Returns true if it is in the
+  /// block being translated.
+  bool resume(uint64_t pc, int64_t depth, uint64_t end);
+
+ private:
+  /// Marker for no instruction.
+  static const size_t kNone = static_cast<size_t>(-1);
+  /// Bytecode.
+  const uint32_t *code_;
+  /// Function being translated.
+  const FunctionInfo &fn_;
+  /// Index of the float primitive for each primitive, -1 if none.
+  const std::vector<int32_t> &floatPrims_;
+  /// Number of slots below the entry.
+  uint32_t window_;
+  /// Function being built.
+  RegisterFunction &out_;
+  /// Values of all registers.
+  std::vector<Operand> state_;
+  /// Index of the last instruction if it defined the accumulator.
+  size_t last_;
+  /// Index of the instruction at the start of blocks and return points.
+  std::map<uint64_t, uint32_t> labels_;
+  /// Return points of calls, with their depths.
+  std::vector<std::pair<uint64_t, int64_t>> resumes_;
+  /// Jumps to PCs, by instruction or jump table entry.
+  std::vector<std::pair<uint32_t, uint64_t>> jumps_;
+  std::vector<std::pair<uint32_t, uint64_t>> cases_;
+};
+
+void Translator::reset() {
+  for (size_t i = 0; i < state_.size(); ++i) {
+    state_[i] = { false, static_cast<int32_t>(i) };
+  }
+  last_ = kNone;
+}
+
+uint16_t Translator::use(uint16_t reg) {
+  if (state_[reg].imm) {
+    materialize(reg);
+    return reg;
+  }
+  return state_[reg].value;
+}
+
+void Translator::materialize(uint16_t reg) {
+  const Operand op = state_[reg];
+  if (op.imm) {
+    emit({ REG_CONST, reg, 0, 0, op.value, 0 });
+  } else if (op.value != reg) {
+    emit({ REG_MOV, reg, static_cast<uint16_t>(op.value), 0, 0, 0 });
+  }
+  state_[reg] = { false, reg };
+}
+
+void Translator::clobber(uint16_t reg) {
+  for (size_t i = 0; i < state_.size(); ++i) {
+    if (i != reg && !state_[i].imm && state_[i].value == reg) {
+      materialize(i);
+    }
+  }
+}
+
+void Translator::copy(uint16_t dst, uint16_t src) {
+  const Operand op = state_[src];
+  if (!op.imm && op.value == dst) {
+    return;
+  }
+
+  // If the source was just computed into the accumulator, the value can
+  // be computed into the destination instead.
+  if (src == 0 && last_ != kNone && !state_[dst].imm) {
+    bool used = false;
+    for (size_t i = 0; i < state_.size(); ++i) {
+      used = used || (i != dst && !state_[i].imm && state_[i].value == dst);
+    }
+    if (!used && state_[dst].value == dst) {
+      out_.code[last_].d = dst;
+      state_[0] = { false, dst };
+      last_ = kNone;
+      return;
+    }
+  }
+
+  clobber(dst);
+  state_[dst] = op;
+}
+
+void Translator::setImm(uint16_t dst, int32_t imm) {
+  clobber(dst);
+  state_[dst] = { true, imm };
+}
+
+void Translator::pop(int64_t from, int64_t to) {
+  // Popped slots which refer to others can be dropped, no register refers
+  // to them. Slots holding their own value might still be referenced.
+  for (int64_t depth = to; depth < from; ++depth) {
+    const uint16_t reg = slot(depth);
+    state_[reg] = { false, reg };
+  }
+}
+
+void Translator::flush(int64_t depth) {
+  materialize(0);
+  for (int64_t i = -static_cast<int64_t>(window_); i < depth; ++i) {
+    materialize(slot(i));
+  }
+}
+
+void Translator::define(RegInst inst) {
+  clobber(inst.d);
+  emit(inst);
+  state_[inst.d] = { false, inst.d };
+  if (inst.d == 0) {
+    last_ = out_.code.size() - 1;
+  }
+}
+
+void Translator::jump(RegOpcode op, uint16_t a, int32_t imm, uint64_t target) {
+  jumps_.emplace_back(out_.code.size(), target);
+  emit({ op, 0, a, 0, imm, 0 });
+}
+
+void Translator::exit(uint64_t pc, int64_t depth) {
+  flush(depth);
+  emit({ REG_EXIT, 0, static_cast<uint16_t>(depth), 0, 0,
+         static_cast<uint32_t>(pc) });
+}
+
+bool Translator::resume(uint64_t pc, int64_t depth, uint64_t end) {
+  // Calls return to the next block or to the bytecode.
+  resumes_.emplace_back(pc, depth);
+  if (pc == end) {
+    return false;
+  }
+  reset();
+  labels_[pc] = out_.code.size();
+  return true;
+}
+
+void Translator::translate(const BasicBlock &block, uint64_t start, bool loop) {
+  reset();
+  labels_[start] = out_.code.size();
+  if (loop) {
+    emit({ REG_POLL, 0, 0, 0, 0, static_cast<uint32_t>(start) });
+  }
+
+  int64_t d = block.depth;
+  uint64_t pc = start;
+  bool live = true;
+  while (pc < block.end) {
+    const uint32_t op = code_[pc];
+    const uint64_t next = pc + getInstructionLength(code_, pc);
+    const int64_t after = d + CodeAnalysis::getStackEffect(code_, pc);
+    if (!live) {
+      // Instructions after an exit run in the bytecode up to a call.
+      if (APPLY <= op && op <= APPLY3) {
+        live = resume(next, after, block.end);
+      }
+      d = after;
+      pc = next;
+      continue;
+    }
+    switch (op) {
+      case ACC0: case ACC1: case ACC2: case ACC3:
+      case ACC4: case ACC5: case ACC6: case ACC7: {
+        copy(0, slot(d - 1 - (op - ACC0)));
+        break;
+      }
+      case ACC: {
+        copy(0, slot(d - 1 - code_[pc + 1]));
+        break;
+      }
+      case PUSH: {
+        copy(slot(d), 0);
+        break;
+      }
+      case PUSHACC0: case PUSHACC1: case PUSHACC2: case PUSHACC3:
+      case PUSHACC4: case PUSHACC5: case PUSHACC6: case PUSHACC7: {
+        copy(slot(d), 0);
+        copy(0, slot(d - (op - PUSHACC0)));
+        break;
+      }
+      case PUSHACC: {
+        copy(slot(d), 0);
+        copy(0, slot(d - code_[pc + 1]));
+        break;
+      }
+      case POP: {
+        pop(d, after);
+        break;
+      }
+      case ASSIGN: {
+        const int64_t depth = d - 1 - code_[pc + 1];
+        out_.writesWindow = out_.writesWindow || depth < 0;
+        copy(slot(depth), 0);
+        setImm(0, 0);
+        break;
+      }
+      case ENVACC1: case ENVACC2: case ENVACC3: case ENVACC4:
+      case ENVACC: {
+        const int32_t n = op == ENVACC ? code_[pc + 1] : op - ENVACC1 + 1;
+        define({ REG_ENVACC, 0, 0, 0, n, 0 });
+        break;
+      }
+      case PUSHENVACC1: case PUSHENVACC2: case PUSHENVACC3:
+      case PUSHENVACC4: case PUSHENVACC: {
+        const int32_t n =
+            op == PUSHENVACC ? code_[pc + 1] : op - PUSHENVACC1 + 1;
+        copy(slot(d), 0);
+        define({ REG_ENVACC, 0, 0, 0, n, 0 });
+        break;
+      }
+      case GETGLOBAL: case PUSHGETGLOBAL: {
+        if (op == PUSHGETGLOBAL) {
+          copy(slot(d), 0);
+        }
+        const int32_t n = code_[pc + 1];
+        define({ REG_GETGLOBAL, 0, 0, 0, n, 0 });
+        break;
+      }
+      case GETGLOBALFIELD: case PUSHGETGLOBALFIELD: {
+        if (code_[pc + 2] > UINT16_MAX) {
+          exit(pc, d);
+          return;
+        }
+        if (op == PUSHGETGLOBALFIELD) {
+          copy(slot(d), 0);
+        }
+        define({
+            REG_GETGLOBALFIELD, 0, 0, static_cast<uint16_t>(code_[pc + 2]),
+            static_cast<int32_t>(code_[pc + 1]), 0
+        });
+        break;
+      }
+      case CONST0: case CONST1: case CONST2: case CONST3: {
+        setImm(0, op - CONST0);
+        break;
+      }
+      case CONSTINT: {
+        setImm(0, code_[pc + 1]);
+        break;
+      }
+      case PUSHCONST0: case PUSHCONST1: case PUSHCONST2: case PUSHCONST3: {
+        copy(slot(d), 0);
+        setImm(0, op - PUSHCONST0);
+        break;
+      }
+      case PUSHCONSTINT: {
+        copy(slot(d), 0);
+        setImm(0, code_[pc + 1]);
+        break;
+      }
+      case GETFIELD0: case GETFIELD1: case GETFIELD2: case GETFIELD3:
+      case GETFIELD: {
+        const uint32_t n = op == GETFIELD ? code_[pc + 1] : op - GETFIELD0;
+        define({ REG_GETFIELD, 0, use(0), 0, static_cast<int32_t>(n), 0 });
+        break;
+      }
+      case SETFIELD0: case SETFIELD1: case SETFIELD2: case SETFIELD3:
+      case SETFIELD: {
+        const uint32_t n = op == SETFIELD ? code_[pc + 1] : op - SETFIELD0;
+        const uint16_t block = use(0);
+        const uint16_t val = use(slot(d - 1));
+        emit({ REG_SETFIELD, 0, block, val, static_cast<int32_t>(n), 0 });
+        pop(d, after);
+        setImm(0, 0);
+        break;
+      }
+      case VECTLENGTH: case NEGINT: case BOOLNOT: case ISINT: {
+        RegOpcode rop;
+        switch (op) {
+          case VECTLENGTH: rop = REG_VECTLENGTH; break;
+          case NEGINT: rop = REG_NEGINT; break;
+          case BOOLNOT: rop = REG_BOOLNOT; break;
+          default: rop = REG_ISINT; break;
+        }
+        define({ rop, 0, use(0), 0, 0, 0 });
+        break;
+      }
+      case OFFSETINT: {
+        // Replicates the int arithmetic of the bytecode interpreter.
+        const int32_t ofs = static_cast<uint32_t>(code_[pc + 1]) << 1;
+        define({ REG_OFFSETINT, 0, use(0), 0, ofs, 0 });
+        break;
+      }
+      case OFFSETREF: {
+        const int32_t ofs = static_cast<uint32_t>(code_[pc + 1]) << 1;
+        emit({ REG_OFFSETREF, 0, use(0), 0, ofs, 0 });
+        setImm(0, 0);
+        break;
+      }
+      case GETVECTITEM: case GETSTRINGCHAR:
+      case ADDINT: case SUBINT: case MULINT: case ANDINT: case ORINT:
+      case XORINT: case LSLINT: case LSRINT: case ASRINT:
+      case EQ: case NEQ: case LTINT: case LEINT: case GTINT: case GEINT:
+      case ULTINT: case UGEINT: {
+        RegOpcode rop;
+        switch (op) {
+          case GETVECTITEM: rop = REG_GETVECTITEM; break;
+          case GETSTRINGCHAR: rop = REG_GETSTRINGCHAR; break;
+          case ADDINT: rop = REG_ADDINT; break;
+          case SUBINT: rop = REG_SUBINT; break;
+          case MULINT: rop = REG_MULINT; break;
+          case ANDINT: rop = REG_ANDINT; break;
+          case ORINT: rop = REG_ORINT; break;
+          case XORINT: rop = REG_XORINT; break;
+          case LSLINT: rop = REG_LSLINT; break;
+          case LSRINT: rop = REG_LSRINT; break;
+          case ASRINT: rop = REG_ASRINT; break;
+          case EQ: rop = REG_EQ; break;
+          case NEQ: rop = REG_NEQ; break;
+          case LTINT: rop = REG_LTINT; break;
+          case LEINT: rop = REG_LEINT; break;
+          case GTINT: rop = REG_GTINT; break;
+          case GEINT: rop = REG_GEINT; break;
+          case ULTINT: rop = REG_ULTINT; break;
+          default: rop = REG_UGEINT; break;
+        }
+        const uint16_t a = use(0);
+        const uint16_t b = use(slot(d - 1));
+        define({ rop, 0, a, b, 0, 0 });
+        pop(d, after);
+        break;
+      }
+      case SETVECTITEM: case SETSTRINGCHAR: {
+        const uint16_t block = use(0);
+        const uint16_t index = use(slot(d - 1));
+        const uint16_t val = use(slot(d - 2));
+        const RegOpcode rop =
+            op == SETVECTITEM ? REG_SETVECTITEM : REG_SETSTRINGCHAR;
+        emit({ rop, val, block, index, 0, 0 });
+        pop(d, after);
+        if (op == SETVECTITEM) {
+          setImm(0, 0);
+        }
+        break;
+      }
+      case MAKEBLOCK: case MAKEBLOCK1: case MAKEBLOCK2: case MAKEBLOCK3:
+      case C_CALL1: case C_CALL2: case C_CALL3: case C_CALL4: case C_CALL5: {
+        // Float primitives take their arguments from any registers.
+        if (op == C_CALL1 || op == C_CALL2) {
+          const int32_t index = floatPrims_[code_[pc + 1]];
+          const uint32_t n = op - C_CALL1 + 1;
+          if (index >= 0 && getFloatArgs(kFloatPrimitives[index]) == n) {
+            const uint16_t b = n == 2 ? use(slot(d - 1)) : 0;
+            const uint16_t a = use(0);
+            define({
+                REG_FLOAT, 0, a, b, index, static_cast<uint32_t>(pc)
+            });
+            pop(d, after);
+            break;
+          }
+        }
+        // Fields and arguments are read from consecutive registers.
+        uint32_t n;
+        int32_t imm;
+        RegOpcode rop;
+        if (op == MAKEBLOCK) {
+          n = code_[pc + 1];
+          imm = code_[pc + 2];
+          rop = REG_MAKEBLOCK;
+        } else if (op <= MAKEBLOCK3) {
+          n = op - MAKEBLOCK1 + 1;
+          imm = code_[pc + 1];
+          rop = REG_MAKEBLOCK;
+        } else {
+          n = op - C_CALL1 + 1;
+          imm = code_[pc + 1];
+          rop = REG_C_CALL;
+        }
+        for (uint32_t i = 1; i < n; ++i) {
+          materialize(slot(d - i));
+        }
+        const uint16_t a = use(0);
+        define({
+            rop, 0, a, slot(d - 1), imm, static_cast<uint32_t>(pc)
+        });
+        out_.code.back().d = n;
+        last_ = kNone;
+        pop(d, after);
+        break;
+      }
+      case PUSH_RETADDR: {
+        // The stack is checked for overflow, exiting to the bytecode to
+        // raise the exception, so all values must be in place.
+        flush(d);
+        const int32_t ofs = code_[pc + 1];
+        emit({
+            REG_PUSH_RETADDR, slot(d), static_cast<uint16_t>(d), 0,
+            static_cast<int32_t>(pc), static_cast<uint32_t>(pc + 1 + ofs)
+        });
+        break;
+      }
+      case BRANCH: {
+        flush(d);
+        jump(REG_BRANCH, 0, 0, pc + 1 + static_cast<int32_t>(code_[pc + 1]));
+        return;
+      }
+      case BRANCHIF: case BRANCHIFNOT: {
+        flush(d);
+        const RegOpcode rop = op == BRANCHIF ? REG_BRANCHIF : REG_BRANCHIFNOT;
+        jump(rop, 0, 0, pc + 1 + static_cast<int32_t>(code_[pc + 1]));
+        break;
+      }
+      case BEQ: case BNEQ: case BLTINT: case BLEINT: case BGTINT: case BGEINT:
+      case BULTINT: case BUGEINT: {
+        flush(d);
+        const RegOpcode rop = op <= BGEINT
+            ? static_cast<RegOpcode>(REG_BEQ + (op - BEQ))
+            : static_cast<RegOpcode>(REG_BULTINT + (op - BULTINT));
+        const uint64_t target = pc + 2 + static_cast<int32_t>(code_[pc + 2]);
+        jump(rop, 0, code_[pc + 1], target);
+        break;
+      }
+      case SWITCH: {
+        flush(d);
+        const uint32_t n = code_[pc + 1];
+        emit({
+            REG_SWITCH, 0, 0, 0, 0, static_cast<uint32_t>(out_.tables.size())
+        });
+        out_.tables.push_back(n);
+        for (uint32_t i = 0; i < (n & 0xFFFF) + (n >> 16); ++i) {
+          const int32_t ofs = code_[pc + 2 + i];
+          cases_.emplace_back(out_.tables.size(), pc + 2 + ofs);
+          out_.tables.push_back(0);
+        }
+        return;
+      }
+      case APPLY: case APPLY1: case APPLY2: case APPLY3: {
+        exit(pc, d);
+        live = resume(next, after, block.end);
+        break;
+      }
+      case CHECK_SIGNALS: {
+        break;
+      }
+      default: {
+        exit(pc, d);
+        live = false;
+        break;
+      }
+    }
+    d = after;
+    pc = next;
+  }
+
+  // Fall through to the next block.
+  if (!live) {
+    return;
+  }
+  flush(d);
+  if (fn_.blocks.count(block.end)) {
+    jump(REG_BRANCH, 0, 0, block.end);
+  } else {
+    exit(block.end, d);
+  }
+}
+
+bool Translator::link() {
+  for (const auto &jump : jumps_) {
+    auto it = labels_.find(jump.second);
+    if (it == labels_.end()) {
+      return false;
+    }
+    out_.code[jump.first].target = it->second;
+  }
+  for (const auto &entry : cases_) {
+    auto it = labels_.find(entry.second);
+    if (it == labels_.end()) {
+      return false;
+    }
+    out_.tables[entry.first] = it->second;
+  }
+
+  // Drop jumps to the next instruction, which are frequent at the end of
+  // blocks, renumbering the instructions.
+  std::vector<uint32_t> index(out_.code.size() + 1);
+  uint32_t n = 0;
+  for (size_t i = 0; i < out_.code.size(); ++i) {
+    const RegInst &inst = out_.code[i];
+    index[i] = n;
+    if (inst.op != REG_BRANCH || inst.target != i + 1) {
+      out_.code[n++] = inst;
+    }
+  }
+  index[out_.code.size()] = n;
+  out_.code.resize(n);
+
+  for (auto &inst : out_.code) {
+    switch (inst.op) {
+      case REG_BRANCH: case REG_BRANCHIF: case REG_BRANCHIFNOT:
+      case REG_BEQ: case REG_BNEQ: case REG_BLTINT: case REG_BLEINT:
+      case REG_BGTINT: case REG_BGEINT: case REG_BULTINT: case REG_BUGEINT: {
+        inst.target = index[inst.target];
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+  for (const auto &entry : cases_) {
+    out_.tables[entry.first] = index[out_.tables[entry.first]];
+  }
+  for (auto &label : labels_) {
+    label.second = index[label.second];
+  }
+  return true;
+}
+
+} // namespace
+
+
+
+// -----------------------------------------------------------------------------
+// RegisterCode
+// -----------------------------------------------------------------------------
+RegisterCode::RegisterCode(
+    const uint32_t *code,
+    size_t size,
+    const std::vector<int32_t> &floatPrims)
+  : index_(size, -1)
+{
+  CodeAnalysis analysis(code, size);
+  for (const auto &fn : analysis.getFunctions()) {
+    // The top-level code is not entered through a call.
+    if (fn.entry != 0 && !fn.inconsistent) {
+      translate(code, fn, floatPrims);
+    }
+  }
+}
+
+void RegisterCode::translate(
+    const uint32_t *code,
+    const FunctionInfo &fn,
+    const std::vector<int32_t> &floatPrims)
+{
+  // Find the slots below the entry which are accessed, along with the
+  // headers of loops. Jumps to the entry would skip the GRAB.
+  int64_t lowest = 0;
+  std::set<uint64_t> loops;
+  for (const auto &entry : fn.blocks) {
+    const BasicBlock &block = entry.second;
+    for (uint64_t succ : block.succs) {
+      if (succ == fn.entry) {
+        return;
+      }
+      if (succ <= block.start) {
+        loops.insert(succ);
+      }
+    }
+
+    int64_t d = block.depth;
+    for (uint64_t pc = block.start; pc < block.end; ) {
+      int64_t depth = 0;
+      switch (code[pc]) {
+        case ACC0: case ACC1: case ACC2: case ACC3:
+        case ACC4: case ACC5: case ACC6: case ACC7: {
+          depth = d - 1 - (code[pc] - ACC0);
+          break;
+        }
+        case PUSHACC0: case PUSHACC1: case PUSHACC2: case PUSHACC3:
+        case PUSHACC4: case PUSHACC5: case PUSHACC6: case PUSHACC7: {
+          depth = d - (code[pc] - PUSHACC0);
+          break;
+        }
+        case ACC: case ASSIGN: {
+          depth = d - 1 - static_cast<int64_t>(code[pc + 1]);
+          break;
+        }
+        case PUSHACC: {
+          depth = d - static_cast<int64_t>(code[pc + 1]);
+          break;
+        }
+        default: {
+          break;
+        }
+      }
+      lowest = std::min(lowest, depth);
+      d += CodeAnalysis::getStackEffect(code, pc);
+      pc += getInstructionLength(code, pc);
+    }
+  }
+
+  RegisterFunction func;
+  func.window = -lowest;
+  func.numRegs = 1 + func.window + fn.maxDepth;
+  func.writesWindow = false;
+  if (func.numRegs > kMaxRegisters) {
+    return;
+  }
+
+  // The GRAB at the entry of a function is skipped by calls passing all
+  // arguments, which enter the function after it.
+  Translator translator(code, fn, floatPrims, func.window, func);
+  uint64_t entry = fn.entry;
+  for (const auto &it : fn.blocks) {
+    const BasicBlock &block = it.second;
+    uint64_t start = block.start;
+    if (start == fn.entry && code[start] == GRAB) {
+      start += 2;
+      entry = start;
+    }
+    translator.translate(block, start, loops.count(block.start) != 0);
+  }
+  if (!translator.link()) {
+    return;
+  }
+
+  // Add entry points, unless they return to the bytecode right away.
+  const uint32_t index = functions_.size();
+  const auto &labels = translator.getLabels();
+  auto add = [&, this](uint64_t pc, int64_t depth) {
+    auto it = labels.find(pc);
+    if (it == labels.end() || func.code[it->second].op == REG_EXIT) {
+      return;
+    }
+    index_[pc] = entries_.size();
+    entries_.push_back({ index, it->second, static_cast<uint32_t>(depth) });
+  };
+  add(entry, 0);
+  for (const auto &resume : translator.getResumes()) {
+    add(resume.first, resume.second);
+  }
+  functions_.push_back(std::move(func));
+}
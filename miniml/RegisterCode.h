@@ -0,0 +1,190 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+namespace miniml {
+struct FunctionInfo;
+
+/// Maximal number of registers of a translated function.
+static const size_t kMaxRegisters = 256;
+
+/// Opcodes of the register code.
+///
+/// Operands name the registers of a frame: register 0 is the accumulator,
+/// followed by the stack slots below the stack pointer at entry which are
+/// accessed by the function, followed by the slots it pushes. Immediate
+/// integers are untagged.
+enum RegOpcode : uint16_t {
+  /// d = a
+  REG_MOV,
+  /// d = imm
+  REG_CONST,
+  /// d = env[imm]
+  REG_ENVACC,
+  /// d = global[imm]
+  REG_GETGLOBAL,
+  /// d = global[imm][b]
+  REG_GETGLOBALFIELD,
+  /// d = a[imm]
+  REG_GETFIELD,
+  /// a[imm] = b
+  REG_SETFIELD,
+  /// d = length of a
+  REG_VECTLENGTH,
+  /// d = a[b]
+  REG_GETVECTITEM,
+  /// a[b] = d
+  REG_SETVECTITEM,
+  /// d = a.[b]
+  REG_GETSTRINGCHAR,
+  /// a.[b] = d
+  REG_SETSTRINGCHAR,
+  /// a[0] += imm
+  REG_OFFSETREF,
+  /// d = op a
+  REG_NEGINT,
+  REG_BOOLNOT,
+  REG_ISINT,
+  /// d = a + imm
+  REG_OFFSETINT,
+  /// d = a op b
+  REG_ADDINT,
+  REG_SUBINT,
+  REG_MULINT,
+  REG_ANDINT,
+  REG_ORINT,
+  REG_XORINT,
+  REG_LSLINT,
+  REG_LSRINT,
+  REG_ASRINT,
+  REG_EQ,
+  REG_NEQ,
+  REG_LTINT,
+  REG_LEINT,
+  REG_GTINT,
+  REG_GEINT,
+  REG_ULTINT,
+  REG_UGEINT,
+  /// Jumps to target.
+  REG_BRANCH,
+  /// Jumps to target if a is true or false.
+  REG_BRANCHIF,
+  REG_BRANCHIFNOT,
+  /// Jumps to target if imm compares to a.
+  REG_BEQ,
+  REG_BNEQ,
+  REG_BLTINT,
+  REG_BLEINT,
+  REG_BGTINT,
+  REG_BGEINT,
+  REG_BULTINT,
+  REG_BUGEINT,
+  /// Jumps through the table at target, indexed by a.
+  REG_SWITCH,
+  /// Stores a return frame to target into d, d + 1 and d + 2. If the
+  /// stack would overflow at depth a, returns to the bytecode at imm.
+  REG_PUSH_RETADDR,
+  /// Allocates a block of d fields with tag imm: the first one is a, the
+  /// others are b, b - 1, ... The block is stored in the accumulator.
+  REG_MAKEBLOCK,
+  /// Calls primitive imm with d arguments: a, b, b - 1, ... The result is
+  /// stored in the accumulator.
+  REG_C_CALL,
+  /// Applies float primitive imm to a and b, storing the result in d. An
+  /// instruction taking the accumulator defined by the previous one uses
+  /// its result unboxed, only the last result of a chain being boxed.
+  REG_FLOAT,
+  /// Samples the CPU profiler if a sample is pending.
+  REG_POLL,
+  /// Returns to the bytecode at target, with a depth of a.
+  REG_EXIT,
+};
+
+/// Instruction of the register code. The PC of the bytecode instruction
+/// is kept in target for instructions which might inspect the stack.
+struct RegInst {
+  RegOpcode op;
+  uint16_t d;
+  uint16_t a;
+  uint16_t b;
+  int32_t imm;
+  uint32_t target;
+};
+
+/// Register code of a function.
+struct RegisterFunction {
+  /// Instructions.
+  std::vector<RegInst> code;
+  /// Jump tables: the SWITCH operand, followed by the targets.
+  std::vector<uint32_t> tables;
+  /// Number of slots below the stack pointer at entry used.
+  uint32_t window;
+  /// Total number of registers.
+  uint32_t numRegs;
+  /// Flag indicating whether the slots below the entry are written.
+  bool writesWindow;
+};
+
+/// Point where the bytecode can switch to register code: the entry of a
+/// function or the return point of a call.
+struct RegisterEntry {
+  /// Index of the function.
+  uint32_t function;
+  /// Index of the first instruction.
+  uint32_t start;
+  /// Depth of the stack, relative to the entry of the function.
+  uint32_t depth;
+};
+
+/// Register code translated from the stack bytecode of a program.
+///
+/// Functions are translated block by block, tracking the value of each
+/// stack slot and of the accumulator. Pushes, pops and moves become
+/// register renamings and operations name their operands explicitly,
+/// values only being stored where control flow merges. Instructions which
+/// are not translated, such as calls, return to the bytecode, execution
+/// resuming in register code when calls return.
+class RegisterCode {
+ public:
+  /// Translates the functions of verified code, given the index of the
+  /// float primitive for each primitive, -1 if it is not one.
+  RegisterCode(
+      const uint32_t *code,
+      size_t size,
+      const std::vector<int32_t> &floatPrims);
+
+  /// Finds the entry point at a PC, if there is one.
+  const RegisterEntry *find(uint64_t pc) const {
+    const int32_t i = index_[pc];
+    return i < 0 ? nullptr : &entries_[i];
+  }
+  /// Returns a function.
+  const RegisterFunction &getFunction(uint32_t i) const {
+    return functions_[i];
+  }
+
+ private:
+  /// Translates a function, adding its entry points.
+  void translate(
+      const uint32_t *code,
+      const FunctionInfo &fn,
+      const std::vector<int32_t> &floatPrims);
+
+ private:
+  /// Translated functions.
+  std::vector<RegisterFunction> functions_;
+  /// Entry points.
+  std::vector<RegisterEntry> entries_;
+  /// Index of the entry point at each PC, -1 if none.
+  std::vector<int32_t> index_;
+};
+
+} // namespace miniml
@@ -77,7 +77,8 @@ class ValueReader {
       Value val = ctx_.allocBlock(size, tag);
       objects_[index_++] = val;
       for (size_t i = 0; i < size; ++i) {
-        val.setField(i, read());
+        Value field = read();
+        ctx_.setField(val, i, field);
       }
       return val;
     }
@@ -142,7 +143,8 @@ class ValueReader {
       Value val = ctx_.allocBlock(size, tag);
       objects_[index_++] = val;
       for (size_t i = 0; i < size; ++i) {
-        val.setField(i, read());
+        Value field = read();
+        ctx_.setField(val, i, field);
       }
       return val;
     }
@@ -164,7 +166,8 @@ class ValueReader {
       Value val = ctx_.allocBlock(size, code & 0xF);
       objects_[index_++] = val;
       for (size_t i = 0; i < size; ++i) {
-        val.setField(i, read());
+        Value field = read();
+        ctx_.setField(val, i, field);
       }
       return val;
     }
@@ -35,6 +35,7 @@ static const uint8_t kUndefinedRecursiveModuleExn = 11;
 static const uint8_t kClosureTag     = 247;
 static const uint8_t kObjectTag      = 248;
 static const uint8_t kInfixTag       = 249;
+static const uint8_t kForwardTag     = 250;
 static const uint8_t kNoScanTag      = 251;
 static const uint8_t kStringTag      = 252;
 static const uint8_t kDoubleTag      = 253;
@@ -107,9 +108,12 @@ inline CustomOperations *val_ops(value val) {
   assert(val_tag(val) == kCustomTag && "Value is not custom.");
   return reinterpret_cast<CustomOperations*>(val_field(val, 0));
 }
-/// Returns the code value of a closure.
+/// Returns the code value of a closure or of a function in its infix block.
 inline uint64_t &val_code(value val) {
-  assert(val_tag(val) == kClosureTag && "Value is not a closure.");
+  assert(
+      (val_tag(val) == kClosureTag || val_tag(val) == kInfixTag) &&
+      "Value is not a closure."
+  );
   return reinterpret_cast<uint64_t&>(val_field(val, 0));
 }
 /// Extracts the int value.
@@ -257,7 +261,8 @@ class Value final {
     val_code(value_) = code;
   }
 
-  /// Sets a field of the block.
+  /// Initialises a field of a freshly allocated block. Fields of blocks
+  /// which might have been promoted must be set through Context::setField.
   inline void setField(size_t n, Value value) {
     val_field(value_, n) = value.value_;
   }
@@ -276,6 +281,9 @@ class Value final {
   }
 
  private:
+  /// The GC updates values when moving blocks.
+  friend class Heap;
+
   /// Links the value into the chain.
   void link();
   /// Unlinks the value from the chain.
@@ -0,0 +1,123 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "miniml/CodeAnalysis.h"
+#include "miniml/Opcode.h"
+#include "miniml/Verifier.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+[[noreturn]] static void fail(uint64_t pc, const std::string &msg) {
+  throw std::runtime_error(
+      "Invalid bytecode at " + std::to_string(pc) + ": " + msg);
+}
+
+static size_t getPrimIndexOperand(uint32_t op) {
+  switch (op) {
+    case C_CALL1: case C_CALL2: case C_CALL3: case C_CALL4: case C_CALL5:
+      return 1;
+    case C_CALLN:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Verifier
+// -----------------------------------------------------------------------------
+void miniml::verifyCode(const uint32_t *code, size_t size, size_t numPrims) {
+  // Decode all instructions, checking opcodes and operands.
+  std::vector<bool> starts(size, false);
+  uint64_t last = 0;
+  for (uint64_t pc = 0; pc < size; ) {
+    const uint32_t op = code[pc];
+    if (op >= kNumOpcodes) {
+      fail(pc, "unknown opcode " + std::to_string(op));
+    }
+    // Variable-length instructions have their size as the first operand.
+    if ((op == SWITCH || op == CLOSUREREC) && pc + 1 >= size) {
+      fail(pc, "truncated instruction");
+    }
+    const size_t length = getInstructionLength(code, pc);
+    if (pc + length > size) {
+      fail(pc, "truncated instruction");
+    }
+
+    if (size_t index = getPrimIndexOperand(op)) {
+      const uint32_t p = code[pc + index];
+      if (p >= numPrims) {
+        fail(pc, "primitive " + std::to_string(p) + " out of range");
+      }
+    }
+    if (op == C_CALLN && code[pc + 1] == 0) {
+      fail(pc, "primitive call without arguments");
+    }
+    if (op == CLOSUREREC && code[pc + 1] == 0) {
+      fail(pc, "empty recursive closure");
+    }
+
+    starts[pc] = true;
+    last = pc;
+    pc += length;
+  }
+
+  // Control must not run off the end of the code.
+  std::vector<uint64_t> targets;
+  if (size == 0 || CodeAnalysis::getTargets(code, last, targets)) {
+    fail(size, "code falls through its end");
+  }
+
+  // All targets, including closure entries and return addresses, must
+  // start instructions.
+  auto check = [&](uint64_t pc, uint64_t target) {
+    if (target >= size || !starts[target]) {
+      fail(pc, "invalid target " + std::to_string(target));
+    }
+  };
+  for (uint64_t pc = 0; pc < size; pc += getInstructionLength(code, pc)) {
+    targets.clear();
+    CodeAnalysis::getTargets(code, pc, targets);
+    for (uint64_t target : targets) {
+      check(pc, target);
+    }
+    switch (code[pc]) {
+      case PUSH_RETADDR: {
+        check(pc, pc + 1 + static_cast<int32_t>(code[pc + 1]));
+        break;
+      }
+      case CLOSURE: {
+        check(pc, pc + 2 + static_cast<int32_t>(code[pc + 2]));
+        break;
+      }
+      case CLOSUREREC: {
+        for (uint32_t i = 0, n = code[pc + 1]; i < n; ++i) {
+          check(pc, pc + 3 + static_cast<int32_t>(code[pc + 3 + i]));
+        }
+        break;
+      }
+      default: {
+        break;
+      }
+    }
+  }
+
+  // Stack depths must agree where control flow merges.
+  CodeAnalysis analysis(code, size);
+  for (const auto &fn : analysis.getFunctions()) {
+    if (fn.inconsistent) {
+      fail(fn.entry, "inconsistent stack depth in function");
+    }
+  }
+}
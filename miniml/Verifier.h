@@ -0,0 +1,23 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+
+namespace miniml {
+
+/// Checks the code of a program before it is run, throwing an exception
+/// if it is malformed: all opcodes must be known and their operands must
+/// fit in the code, branch, switch, trap and closure targets must be
+/// instructions, the stack depth must agree wherever control flow merges
+/// and all primitives called must be in the table of numPrims primitives.
+///
+/// The interpreter relies on these properties and does not check them.
+void verifyCode(const uint32_t *code, size_t size, size_t numPrims);
+
+} // namespace miniml
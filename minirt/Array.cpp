@@ -2,6 +2,9 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <algorithm>
+#include <cstring>
+
 #include "miniml/Context.h"
 using namespace miniml;
 
@@ -15,13 +18,23 @@ extern "C" value caml_make_vect(
     value len,
     value init)
 {
-  if (val_tag(init) == kDoubleTag) {
-    assert(!"caml_make_vect");
+  size_t size = val_to_int64(len);
+  if (val_is_block(init) && val_tag(init) == kDoubleTag) {
+    // Arrays of floats are flat, holding unboxed doubles.
+    if (size == 0) {
+      return ctx.allocAtom(0);
+    }
+    const uint64_t bits = dbl_to_val(val_to_double(init));
+    value ret = ctx.allocBlock(size, kDoubleArrayTag);
+    for (size_t i = 0; i < size; ++i) {
+      val_field(ret, i) = bits;
+    }
+    return ret;
   } else {
-    size_t size = val_to_int64(len);
+    Value vinit(init);
     value ret = ctx.allocBlock(size, 0);
     for (size_t i = 0; i < size; ++i) {
-      val_field(ret, i) = init;
+      val_field(ret, i) = vinit;
     }
     return ret;
   }
@@ -45,6 +58,24 @@ extern "C" value caml_array_set_float(
   return kUnit;
 }
 
+extern "C" value caml_array_unsafe_get_float(
+    Context &ctx,
+    value array,
+    value index)
+{
+  return ctx.allocDouble(val_to_dbl(val_field(array, val_to_int64(index))));
+}
+
+extern "C" value caml_array_unsafe_set_float(
+    Context &,
+    value array,
+    value index,
+    value val)
+{
+  val_field(array, val_to_int64(index)) = dbl_to_val(val_to_double(val));
+  return kUnit;
+}
+
 extern "C" value caml_make_float_vect(
     Context &ctx,
     value len)
@@ -67,29 +98,38 @@ extern "C" value caml_array_get_addr(
 
 
 extern "C" value caml_array_set_addr(
-    Context &,
+    Context &ctx,
     value array,
     value index,
     value newval)
 {
-  val_field(array, val_to_int64(index)) = newval;
+  ctx.setField(array, val_to_int64(index), newval);
   return kUnit;
 }
 
 extern "C" value caml_array_unsafe_set(
-    Context &,
+    Context &ctx,
     value array,
     value index,
     value val)
 {
   if (val_tag(array) == kDoubleArrayTag) {
-    assert(false);
+    val_field(array, val_to_int64(index)) = dbl_to_val(val_to_double(val));
   } else {
-    val_field(array, val_to_int64(index)) = val;
+    ctx.setField(array, val_to_int64(index), val);
   }
   return kUnit;
 }
 
+extern "C" value caml_array_set(
+    Context &ctx,
+    value array,
+    value index,
+    value val)
+{
+  return caml_array_unsafe_set(ctx, array, index, val);
+}
+
 extern "C" value caml_array_unsafe_get(
     Context &ctx,
     value array,
@@ -115,21 +155,114 @@ extern "C" value caml_array_get(
 }
 
 extern "C" value caml_array_blit(
-    Context &,
+    Context &ctx,
     value a1,
     value ofs1,
     value a2,
     value ofs2,
     value n)
 {
-  if (val_tag(a2) == kDoubleArrayTag) {
-    assert(!"caml_array_blit");
+  const int64_t count = val_to_int64(n);
+  const int64_t dst = val_to_int64(ofs2);
+  memmove(
+      &val_field(a2, dst),
+      &val_field(a1, val_to_int64(ofs1)),
+      count * sizeof(value));
+
+  // Unboxed doubles are not scanned, only pointers need the barrier.
+  if (val_tag(a2) != kDoubleArrayTag) {
+    ctx.rememberFields(a2, dst, count);
+  }
+  return kUnit;
+}
+
+extern "C" value caml_array_fill(
+    Context &ctx,
+    value array,
+    value vofs,
+    value vlen,
+    value val)
+{
+  const int64_t ofs = val_to_int64(vofs);
+  const int64_t len = val_to_int64(vlen);
+  value *fields = &val_field(array, ofs);
+  if (val_tag(array) == kDoubleArrayTag) {
+    std::fill(fields, fields + len, dbl_to_val(val_to_double(val)));
   } else {
-    value *src = &val_field(a1, val_to_int64(ofs1));
-    value *dst = &val_field(a2, val_to_int64(ofs2));
-    for (int64_t i = 0; i < val_to_int64(n); ++i) {
-      dst[i] = src[i];
+    std::fill(fields, fields + len, val);
+    ctx.rememberFields(array, ofs, len);
+  }
+  return kUnit;
+}
+
+extern "C" value caml_array_sub(
+    Context &ctx,
+    value varray,
+    value vofs,
+    value vlen)
+{
+  const int64_t len = val_to_int64(vlen);
+  if (len == 0) {
+    return ctx.allocAtom(0);
+  }
+
+  // Fresh blocks are either young or scanned by the next minor collection,
+  // so fields are copied in without a barrier.
+  Value array(varray);
+  value ret = ctx.allocBlock(len, val_tag(array));
+  memcpy(
+      &val_field(ret, 0),
+      &val_field(array, val_to_int64(vofs)),
+      len * sizeof(value));
+  return ret;
+}
+
+extern "C" value caml_array_append(
+    Context &ctx,
+    value va1,
+    value va2)
+{
+  const size_t n1 = val_size(va1), n2 = val_size(va2);
+  if (n1 + n2 == 0) {
+    return ctx.allocAtom(0);
+  }
+
+  // Empty arrays do not know whether they hold floats.
+  Value a1(va1), a2(va2);
+  const uint8_t tag = n1 ? val_tag(a1) : val_tag(a2);
+  value ret = ctx.allocBlock(n1 + n2, tag);
+  memcpy(&val_field(ret, 0), val_ptr(a1), n1 * sizeof(value));
+  memcpy(&val_field(ret, n1), val_ptr(a2), n2 * sizeof(value));
+  return ret;
+}
+
+extern "C" value caml_array_concat(
+    Context &ctx,
+    value varrays)
+{
+  size_t size = 0;
+  uint8_t tag = 0;
+  for (value l = varrays; val_is_block(l); l = val_field(l, 1)) {
+    const value array = val_field(l, 0);
+    if (size_t n = val_size(array)) {
+      if (size == 0) {
+        tag = val_tag(array);
+      }
+      size += n;
     }
-    return kUnit;
   }
+  if (size == 0) {
+    return ctx.allocAtom(0);
+  }
+
+  Value arrays(varrays);
+  value ret = ctx.allocBlock(size, tag);
+  value *dst = &val_field(ret, 0);
+  for (value l = arrays; val_is_block(l); l = val_field(l, 1)) {
+    const value array = val_field(l, 0);
+    const size_t n = val_size(array);
+    memcpy(dst, val_ptr(array), n * sizeof(value));
+    dst += n;
+  }
+  return ret;
 }
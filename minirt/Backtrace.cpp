@@ -0,0 +1,127 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "miniml/Context.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static value raw_backtrace(Context &ctx, const uint64_t *slots, size_t n) {
+  if (n == 0) {
+    return ctx.allocAtom(0);
+  }
+  value bt = ctx.allocBlock(n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    val_field(bt, i) = val_int64(slots[i]);
+  }
+  return bt;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Backtraces
+// -----------------------------------------------------------------------------
+extern "C" value caml_record_backtrace(
+    Context &ctx,
+    value flag)
+{
+  ctx.setBacktraceActive(val_to_int64(flag));
+  return kUnit;
+}
+
+extern "C" value caml_backtrace_status(
+    Context &ctx,
+    value)
+{
+  return val_int64(ctx.isBacktraceActive());
+}
+
+extern "C" value caml_get_exception_raw_backtrace(
+    Context &ctx,
+    value)
+{
+  if (!ctx.isBacktraceActive()) {
+    return ctx.allocAtom(0);
+  }
+  return raw_backtrace(
+      ctx,
+      ctx.getBacktrace(),
+      ctx.getBacktraceLength());
+}
+
+extern "C" value caml_get_current_callstack(
+    Context &ctx,
+    value max)
+{
+  std::vector<uint64_t> pcs(std::max<int64_t>(val_to_int64(max), 0));
+  pcs.resize(ctx.backtrace(pcs.data(), pcs.size()));
+  for (auto &pc : pcs) {
+    pc <<= 1;
+  }
+  return raw_backtrace(ctx, pcs.data(), pcs.size());
+}
+
+extern "C" value caml_raw_backtrace_length(
+    Context &,
+    value bt)
+{
+  return val_int64(val_size(bt));
+}
+
+extern "C" value caml_raw_backtrace_slot(
+    Context &,
+    value bt,
+    value index)
+{
+  int64_t i = val_to_int64(index);
+  if (i < 0 || static_cast<uint64_t>(i) >= val_size(bt)) {
+    throw std::runtime_error("Printexc.get_raw_backtrace_slot: index");
+  }
+  return val_field(bt, i);
+}
+
+extern "C" value caml_raw_backtrace_next_slot(
+    Context &,
+    value)
+{
+  // Inlined frames are not tracked, there is no next slot.
+  return val_int64(0);
+}
+
+extern "C" value caml_convert_raw_backtrace_slot(
+    Context &ctx,
+    value slot)
+{
+  // Debug information is only decoded once a backtrace is printed.
+  const uint64_t s = val_to_int64(slot);
+  const value isRaise = val_int64(s & 1);
+  SourceLocation loc;
+  DebugInfo *debug = ctx.getDebugInfo();
+  if (!debug || !debug->find(s >> 1, loc)) {
+    value unknown = ctx.allocBlock(1, 1);
+    val_field(unknown, 0) = isRaise;
+    return unknown;
+  }
+
+  // Known_location, with the layout read by Printexc.
+  Value file = ctx.allocString(loc.file, strlen(loc.file));
+  Value def = ctx.allocString(loc.def, strlen(loc.def));
+  value known = ctx.allocBlock(7, 0);
+  val_field(known, 0) = isRaise;
+  val_field(known, 1) = file;
+  val_field(known, 2) = val_int64(loc.line);
+  val_field(known, 3) = val_int64(loc.startChar);
+  val_field(known, 4) = val_int64(loc.endChar);
+  val_field(known, 5) = val_int64(0);
+  val_field(known, 6) = def;
+  return known;
+}
@@ -0,0 +1,832 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "miniml/Context.h"
+#include "minirt/Runtime.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// bigarray
+// -----------------------------------------------------------------------------
+
+/// Element kinds, numbered like Bigarray.kind.
+enum ba_kind {
+  BA_FLOAT32,
+  BA_FLOAT64,
+  BA_SINT8,
+  BA_UINT8,
+  BA_SINT16,
+  BA_UINT16,
+  BA_INT32,
+  BA_INT64,
+  BA_CAML_INT,
+  BA_NATIVE_INT,
+  BA_COMPLEX32,
+  BA_COMPLEX64,
+  BA_CHAR,
+};
+
+/// Size of an element of each kind.
+static const size_t kBaElementSize[] = {
+  4, 8, 1, 1, 2, 2, 4, 8, 8, 8, 8, 16, 1
+};
+
+/// Layouts, numbered like Bigarray.layout.
+enum ba_layout {
+  BA_C_LAYOUT,
+  BA_FORTRAN_LAYOUT,
+};
+
+/// Maximal number of dimensions.
+static const int64_t kBaMaxDims = 16;
+
+/// Storage shared by a bigarray and its sub-arrays, outside the heap.
+struct ba_proxy {
+  /// Number of bigarrays referring to the storage.
+  int64_t refcount;
+  /// Start of the allocation or of the mapping.
+  void *data;
+  /// Size of the mapping.
+  size_t size;
+  /// Flag indicating whether the storage is a mapped file.
+  bool mapped;
+};
+
+struct bigarray {
+  /// Pointer to the first element.
+  char *data;
+  /// Number of dimensions.
+  int64_t num_dims;
+  /// Kind of the elements.
+  int64_t kind;
+  /// Layout of the elements.
+  int64_t layout;
+  /// Storage, released when the last array referring to it dies.
+  ba_proxy *proxy;
+  /// Dimensions.
+  int64_t dim[kBaMaxDims];
+};
+
+void ba_finalize(Context &, value vba) {
+  auto ba = val_to_custom<bigarray>(vba);
+  if (ba->proxy && --ba->proxy->refcount == 0) {
+    if (ba->proxy->mapped) {
+      munmap(ba->proxy->data, ba->proxy->size);
+    } else {
+      free(ba->proxy->data);
+    }
+    delete ba->proxy;
+  }
+  ba->proxy = nullptr;
+}
+
+int ba_compare(Context &, value, value);
+CustomOperations bigarray_ops = {
+  "_bigarr02",
+  ba_finalize,
+  ba_compare,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+};
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static bigarray *ba_get(value vba) {
+  return val_to_custom<bigarray>(vba);
+}
+
+static size_t ba_num_elems(const bigarray *ba) {
+  size_t n = 1;
+  for (int64_t i = 0; i < ba->num_dims; ++i) {
+    n *= ba->dim[i];
+  }
+  return n;
+}
+
+static size_t ba_byte_size(const bigarray *ba) {
+  return ba_num_elems(ba) * kBaElementSize[ba->kind];
+}
+
+static void ba_read_dims(value vdims, int64_t *dims, const char *fn) {
+  const int64_t num_dims = val_size(vdims);
+  if (num_dims > kBaMaxDims) {
+    throw std::runtime_error(std::string(fn) + ": bad number of dimensions");
+  }
+  for (int64_t i = 0; i < num_dims; ++i) {
+    dims[i] = val_to_int64(val_field(vdims, i));
+  }
+}
+
+static value ba_alloc(
+    Context &ctx,
+    int64_t kind,
+    int64_t layout,
+    int64_t num_dims,
+    const int64_t *dims,
+    char *data,
+    ba_proxy *proxy)
+{
+  Value vba = ctx.allocCustom(&bigarray_ops, sizeof(bigarray));
+  auto ba = ba_get(vba);
+  ba->data = data;
+  ba->num_dims = num_dims;
+  ba->kind = kind;
+  ba->layout = layout;
+  ba->proxy = proxy;
+  for (int64_t i = 0; i < kBaMaxDims; ++i) {
+    ba->dim[i] = i < num_dims ? dims[i] : 0;
+  }
+  return vba;
+}
+
+static value ba_share(
+    Context &ctx,
+    value vsrc,
+    int64_t num_dims,
+    const int64_t *dims,
+    char *data)
+{
+  // Sub-arrays keep the storage of the original alive. The source is
+  // read before allocating, since the allocation might move it.
+  const bigarray *src = ba_get(vsrc);
+  const int64_t kind = src->kind, layout = src->layout;
+  ba_proxy *proxy = src->proxy;
+  proxy->refcount++;
+  return ba_alloc(ctx, kind, layout, num_dims, dims, data, proxy);
+}
+
+static size_t ba_offset(const bigarray *ba, const int64_t *index, int64_t n) {
+  if (n != ba->num_dims) {
+    throw std::runtime_error("Bigarray.get/set: wrong number of indices");
+  }
+  size_t ofs = 0;
+  if (ba->layout == BA_C_LAYOUT) {
+    for (int64_t i = 0; i < n; ++i) {
+      if (index[i] < 0 || index[i] >= ba->dim[i]) {
+        throw std::runtime_error("Bigarray.get/set: index out of bounds");
+      }
+      ofs = ofs * ba->dim[i] + index[i];
+    }
+  } else {
+    for (int64_t i = n - 1; i >= 0; --i) {
+      if (index[i] < 1 || index[i] > ba->dim[i]) {
+        throw std::runtime_error("Bigarray.get/set: index out of bounds");
+      }
+      ofs = ofs * ba->dim[i] + index[i] - 1;
+    }
+  }
+  return ofs;
+}
+
+static value ba_load(Context &ctx, const bigarray *ba, size_t ofs) {
+  void *p = ba->data + ofs * kBaElementSize[ba->kind];
+  switch (ba->kind) {
+    case BA_FLOAT32: return ctx.allocDouble(*static_cast<float *>(p));
+    case BA_FLOAT64: return ctx.allocDouble(*static_cast<double *>(p));
+    case BA_SINT8: return val_int64(*static_cast<int8_t *>(p));
+    case BA_UINT8: return val_int64(*static_cast<uint8_t *>(p));
+    case BA_SINT16: return val_int64(*static_cast<int16_t *>(p));
+    case BA_UINT16: return val_int64(*static_cast<uint16_t *>(p));
+    case BA_CAML_INT: return val_int64(*static_cast<int64_t *>(p));
+    case BA_CHAR: return val_int64(*static_cast<uint8_t *>(p));
+    case BA_INT32: {
+      auto c = ctx.allocCustom(&int32_ops, sizeof(int32_t));
+      *val_to_custom<int32_t>(c) = *static_cast<int32_t *>(p);
+      return c;
+    }
+    case BA_INT64: {
+      auto c = ctx.allocCustom(&int64_ops, sizeof(int64_t));
+      *val_to_custom<int64_t>(c) = *static_cast<int64_t *>(p);
+      return c;
+    }
+    case BA_NATIVE_INT: {
+      auto c = ctx.allocCustom(&nativeint_ops, sizeof(int64_t));
+      *val_to_custom<int64_t>(c) = *static_cast<int64_t *>(p);
+      return c;
+    }
+    case BA_COMPLEX32: {
+      const float *f = static_cast<float *>(p);
+      value c = ctx.allocBlock(2, kDoubleArrayTag);
+      val_field(c, 0) = dbl_to_val(f[0]);
+      val_field(c, 1) = dbl_to_val(f[1]);
+      return c;
+    }
+    case BA_COMPLEX64: {
+      const double *d = static_cast<double *>(p);
+      value c = ctx.allocBlock(2, kDoubleArrayTag);
+      val_field(c, 0) = dbl_to_val(d[0]);
+      val_field(c, 1) = dbl_to_val(d[1]);
+      return c;
+    }
+    default: {
+      throw std::runtime_error("Bigarray: invalid kind");
+    }
+  }
+}
+
+static void ba_store(const bigarray *ba, size_t ofs, value v) {
+  void *p = ba->data + ofs * kBaElementSize[ba->kind];
+  switch (ba->kind) {
+    case BA_FLOAT32: *static_cast<float *>(p) = val_to_double(v); break;
+    case BA_FLOAT64: *static_cast<double *>(p) = val_to_double(v); break;
+    case BA_SINT8: *static_cast<int8_t *>(p) = val_to_int64(v); break;
+    case BA_UINT8: *static_cast<uint8_t *>(p) = val_to_int64(v); break;
+    case BA_SINT16: *static_cast<int16_t *>(p) = val_to_int64(v); break;
+    case BA_UINT16: *static_cast<uint16_t *>(p) = val_to_int64(v); break;
+    case BA_CAML_INT: *static_cast<int64_t *>(p) = val_to_int64(v); break;
+    case BA_CHAR: *static_cast<uint8_t *>(p) = val_to_int64(v); break;
+    case BA_INT32: {
+      *static_cast<int32_t *>(p) = *val_to_custom<int32_t>(v);
+      break;
+    }
+    case BA_INT64: case BA_NATIVE_INT: {
+      *static_cast<int64_t *>(p) = *val_to_custom<int64_t>(v);
+      break;
+    }
+    case BA_COMPLEX32: {
+      float *f = static_cast<float *>(p);
+      f[0] = val_to_dbl(val_field(v, 0));
+      f[1] = val_to_dbl(val_field(v, 1));
+      break;
+    }
+    case BA_COMPLEX64: {
+      double *d = static_cast<double *>(p);
+      d[0] = val_to_dbl(val_field(v, 0));
+      d[1] = val_to_dbl(val_field(v, 1));
+      break;
+    }
+    default: {
+      throw std::runtime_error("Bigarray: invalid kind");
+    }
+  }
+}
+
+template <typename T>
+static int ba_compare_ints(const void *d1, const void *d2, size_t n) {
+  const T *p1 = static_cast<const T *>(d1), *p2 = static_cast<const T *>(d2);
+  for (size_t i = 0; i < n; ++i) {
+    if (p1[i] != p2[i]) {
+      return p1[i] < p2[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+/// Compares floats like compare: NaN is equal to itself and smaller than
+/// any other float, while -0.0 and 0.0 are equal.
+template <typename T>
+static int ba_compare_floats(const void *d1, const void *d2, size_t n) {
+  const T *p1 = static_cast<const T *>(d1), *p2 = static_cast<const T *>(d2);
+  for (size_t i = 0; i < n; ++i) {
+    const T f1 = p1[i], f2 = p2[i];
+    if (f1 < f2) {
+      return -1;
+    }
+    if (f1 > f2) {
+      return 1;
+    }
+    if (f1 != f2) {
+      if (f1 == f1) {
+        return 1;
+      }
+      if (f2 == f2) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+int ba_compare(Context &, value v1, value v2) {
+  const bigarray *b1 = ba_get(v1);
+  const bigarray *b2 = ba_get(v2);
+  if (b1->num_dims != b2->num_dims) {
+    return b1->num_dims < b2->num_dims ? -1 : 1;
+  }
+  for (int64_t i = 0; i < b1->num_dims; ++i) {
+    if (b1->dim[i] != b2->dim[i]) {
+      return b1->dim[i] < b2->dim[i] ? -1 : 1;
+    }
+  }
+  if (b1->kind != b2->kind) {
+    return b1->kind < b2->kind ? -1 : 1;
+  }
+  // Elements are compared by value, complex numbers part by part.
+  const size_t n = ba_num_elems(b1);
+  const void *d1 = b1->data, *d2 = b2->data;
+  switch (b1->kind) {
+    case BA_FLOAT32: return ba_compare_floats<float>(d1, d2, n);
+    case BA_FLOAT64: return ba_compare_floats<double>(d1, d2, n);
+    case BA_COMPLEX32: return ba_compare_floats<float>(d1, d2, n * 2);
+    case BA_COMPLEX64: return ba_compare_floats<double>(d1, d2, n * 2);
+    case BA_SINT8: return ba_compare_ints<int8_t>(d1, d2, n);
+    case BA_UINT8: case BA_CHAR: return ba_compare_ints<uint8_t>(d1, d2, n);
+    case BA_SINT16: return ba_compare_ints<int16_t>(d1, d2, n);
+    case BA_UINT16: return ba_compare_ints<uint16_t>(d1, d2, n);
+    case BA_INT32: return ba_compare_ints<int32_t>(d1, d2, n);
+    case BA_INT64: case BA_CAML_INT: case BA_NATIVE_INT: {
+      return ba_compare_ints<int64_t>(d1, d2, n);
+    }
+  }
+  throw std::runtime_error("Bigarray: invalid kind");
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Creation
+// -----------------------------------------------------------------------------
+extern "C" value caml_ba_init(
+    Context &,
+    value)
+{
+  return kUnit;
+}
+
+extern "C" value caml_ba_create(
+    Context &ctx,
+    value vkind,
+    value vlayout,
+    value vdims)
+{
+  int64_t dims[kBaMaxDims];
+  ba_read_dims(vdims, dims, "Bigarray.create");
+  const int64_t num_dims = val_size(vdims);
+
+  const int64_t kind = val_to_int64(vkind);
+  size_t size = kBaElementSize[kind];
+  for (int64_t i = 0; i < num_dims; ++i) {
+    if (dims[i] < 0) {
+      throw std::runtime_error("Bigarray.create: negative dimension");
+    }
+    size *= dims[i];
+  }
+
+  // The data lives outside the heap, owned by a proxy.
+  char *data = static_cast<char *>(calloc(size ? size : 1, 1));
+  if (!data) {
+    throw std::runtime_error("Bigarray.create: out of memory");
+  }
+  auto proxy = new ba_proxy{ 1, data, size, false };
+  return ba_alloc(
+      ctx, kind, val_to_int64(vlayout), num_dims, dims, data, proxy
+  );
+}
+
+static value ba_map_file(
+    Context &ctx,
+    value vfd,
+    value vkind,
+    value vlayout,
+    value vshared,
+    value vdims,
+    value vstart)
+{
+  const int fd = val_to_int64(vfd);
+  const int64_t kind = val_to_int64(vkind);
+  const int64_t layout = val_to_int64(vlayout);
+  const int64_t start = val_to_int64(vstart);
+  const int64_t num_dims = val_size(vdims);
+  int64_t dims[kBaMaxDims];
+  ba_read_dims(vdims, dims, "Bigarray.map_file");
+  if (num_dims == 0) {
+    throw std::runtime_error("Bigarray.map_file: no dimensions");
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    throw std::runtime_error(
+        std::string("Bigarray.map_file: ") + strerror(errno)
+    );
+  }
+  const uint64_t file_size = st.st_size;
+
+  // The major dimension can be -1, its size being inferred from the file.
+  const int64_t major = layout == BA_C_LAYOUT ? 0 : num_dims - 1;
+  uint64_t size = kBaElementSize[kind];
+  for (int64_t i = 0; i < num_dims; ++i) {
+    if (i != major || dims[i] != -1) {
+      if (dims[i] < 0) {
+        throw std::runtime_error("Bigarray.map_file: negative dimension");
+      }
+      size *= dims[i];
+    }
+  }
+  if (dims[major] == -1) {
+    if (file_size < static_cast<uint64_t>(start) || size == 0) {
+      throw std::runtime_error("Bigarray.map_file: file position mismatch");
+    }
+    if ((file_size - start) % size != 0) {
+      throw std::runtime_error("Bigarray.map_file: file size doesn't match");
+    }
+    dims[major] = (file_size - start) / size;
+    size *= dims[major];
+  } else if (file_size < start + size) {
+    // Files too small are grown to fit the array.
+    if (ftruncate(fd, start + size) < 0) {
+      throw std::runtime_error(
+          std::string("Bigarray.map_file: ") + strerror(errno)
+      );
+    }
+  }
+
+  // Mappings must start at a page boundary.
+  const int64_t page = sysconf(_SC_PAGESIZE);
+  const int64_t delta = start % page;
+  void *addr = nullptr;
+  if (size != 0) {
+    const int flags = val_to_int64(vshared) ? MAP_SHARED : MAP_PRIVATE;
+    addr = mmap(
+        nullptr,
+        size + delta,
+        PROT_READ | PROT_WRITE,
+        flags,
+        fd,
+        start - delta
+    );
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error(
+          std::string("Bigarray.map_file: ") + strerror(errno)
+      );
+    }
+  }
+
+  auto proxy = new ba_proxy{ 1, addr, size + delta, addr != nullptr };
+  char *data = addr ? static_cast<char *>(addr) + delta : nullptr;
+  return ba_alloc(ctx, kind, layout, num_dims, dims, data, proxy);
+}
+
+extern "C" value caml_ba_map_file(
+    Context &ctx,
+    value vfd,
+    value vkind,
+    value vlayout,
+    value vshared,
+    value vdims,
+    value vstart)
+{
+  return ba_map_file(ctx, vfd, vkind, vlayout, vshared, vdims, vstart);
+}
+
+extern "C" value caml_ba_map_file_bytecode(
+    Context &ctx,
+    Value *argv,
+    uint32_t)
+{
+  return ba_map_file(
+      ctx, argv[0], argv[1], argv[2], argv[3], argv[4], argv[5]
+  );
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Access
+// -----------------------------------------------------------------------------
+extern "C" value caml_ba_get_1(
+    Context &ctx,
+    value vba,
+    value i)
+{
+  const int64_t index[] = { val_to_int64(i) };
+  const bigarray *ba = ba_get(vba);
+  return ba_load(ctx, ba, ba_offset(ba, index, 1));
+}
+
+extern "C" value caml_ba_get_2(
+    Context &ctx,
+    value vba,
+    value i,
+    value j)
+{
+  const int64_t index[] = { val_to_int64(i), val_to_int64(j) };
+  const bigarray *ba = ba_get(vba);
+  return ba_load(ctx, ba, ba_offset(ba, index, 2));
+}
+
+extern "C" value caml_ba_get_3(
+    Context &ctx,
+    value vba,
+    value i,
+    value j,
+    value k)
+{
+  const int64_t index[] = {
+    val_to_int64(i), val_to_int64(j), val_to_int64(k)
+  };
+  const bigarray *ba = ba_get(vba);
+  return ba_load(ctx, ba, ba_offset(ba, index, 3));
+}
+
+extern "C" value caml_ba_get_generic(
+    Context &ctx,
+    value vba,
+    value vind)
+{
+  int64_t index[kBaMaxDims];
+  ba_read_dims(vind, index, "Bigarray.Genarray.get");
+  const bigarray *ba = ba_get(vba);
+  return ba_load(ctx, ba, ba_offset(ba, index, val_size(vind)));
+}
+
+extern "C" value caml_ba_set_1(
+    Context &,
+    value vba,
+    value i,
+    value v)
+{
+  const int64_t index[] = { val_to_int64(i) };
+  const bigarray *ba = ba_get(vba);
+  ba_store(ba, ba_offset(ba, index, 1), v);
+  return kUnit;
+}
+
+extern "C" value caml_ba_set_2(
+    Context &,
+    value vba,
+    value i,
+    value j,
+    value v)
+{
+  const int64_t index[] = { val_to_int64(i), val_to_int64(j) };
+  const bigarray *ba = ba_get(vba);
+  ba_store(ba, ba_offset(ba, index, 2), v);
+  return kUnit;
+}
+
+extern "C" value caml_ba_set_3(
+    Context &,
+    value vba,
+    value i,
+    value j,
+    value k,
+    value v)
+{
+  const int64_t index[] = {
+    val_to_int64(i), val_to_int64(j), val_to_int64(k)
+  };
+  const bigarray *ba = ba_get(vba);
+  ba_store(ba, ba_offset(ba, index, 3), v);
+  return kUnit;
+}
+
+extern "C" value caml_ba_set_generic(
+    Context &,
+    value vba,
+    value vind,
+    value v)
+{
+  int64_t index[kBaMaxDims];
+  ba_read_dims(vind, index, "Bigarray.Genarray.set");
+  const bigarray *ba = ba_get(vba);
+  ba_store(ba, ba_offset(ba, index, val_size(vind)), v);
+  return kUnit;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Properties
+// -----------------------------------------------------------------------------
+extern "C" value caml_ba_num_dims(
+    Context &,
+    value vba)
+{
+  return val_int64(ba_get(vba)->num_dims);
+}
+
+extern "C" value caml_ba_dim(
+    Context &,
+    value vba,
+    value vn)
+{
+  const bigarray *ba = ba_get(vba);
+  const int64_t n = val_to_int64(vn);
+  if (n < 0 || n >= ba->num_dims) {
+    throw std::runtime_error("Bigarray.dim");
+  }
+  return val_int64(ba->dim[n]);
+}
+
+extern "C" value caml_ba_dim_1(
+    Context &ctx,
+    value vba)
+{
+  return caml_ba_dim(ctx, vba, val_int64(0));
+}
+
+extern "C" value caml_ba_dim_2(
+    Context &ctx,
+    value vba)
+{
+  return caml_ba_dim(ctx, vba, val_int64(1));
+}
+
+extern "C" value caml_ba_dim_3(
+    Context &ctx,
+    value vba)
+{
+  return caml_ba_dim(ctx, vba, val_int64(2));
+}
+
+extern "C" value caml_ba_kind(
+    Context &,
+    value vba)
+{
+  return val_int64(ba_get(vba)->kind);
+}
+
+extern "C" value caml_ba_layout(
+    Context &,
+    value vba)
+{
+  return val_int64(ba_get(vba)->layout);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Views
+// -----------------------------------------------------------------------------
+extern "C" value caml_ba_change_layout(
+    Context &ctx,
+    value vba,
+    value vlayout)
+{
+  const bigarray *ba = ba_get(vba);
+  const int64_t layout = val_to_int64(vlayout);
+  if (layout == ba->layout) {
+    return vba;
+  }
+  // Switching between row and column-major order reverses dimensions.
+  const int64_t num_dims = ba->num_dims;
+  int64_t dims[kBaMaxDims];
+  for (int64_t i = 0; i < num_dims; ++i) {
+    dims[i] = ba->dim[num_dims - 1 - i];
+  }
+  Value vres = ba_share(ctx, vba, num_dims, dims, ba->data);
+  ba_get(vres)->layout = layout;
+  return vres;
+}
+
+extern "C" value caml_ba_sub(
+    Context &ctx,
+    value vba,
+    value vofs,
+    value vlen)
+{
+  const bigarray *ba = ba_get(vba);
+  const int64_t len = val_to_int64(vlen);
+  int64_t ofs = val_to_int64(vofs);
+
+  // Sub-arrays are taken along the outermost dimension.
+  int64_t major;
+  size_t chunk = kBaElementSize[ba->kind];
+  if (ba->layout == BA_C_LAYOUT) {
+    major = 0;
+    for (int64_t i = 1; i < ba->num_dims; ++i) {
+      chunk *= ba->dim[i];
+    }
+  } else {
+    major = ba->num_dims - 1;
+    ofs -= 1;
+    for (int64_t i = 0; i < ba->num_dims - 1; ++i) {
+      chunk *= ba->dim[i];
+    }
+  }
+  if (ba->num_dims == 0 || ofs < 0 || len < 0 || ofs + len > ba->dim[major]) {
+    throw std::runtime_error("Bigarray.sub: bad sub-array");
+  }
+
+  int64_t dims[kBaMaxDims];
+  memcpy(dims, ba->dim, sizeof(dims));
+  dims[major] = len;
+  return ba_share(ctx, vba, ba->num_dims, dims, ba->data + ofs * chunk);
+}
+
+extern "C" value caml_ba_slice(
+    Context &ctx,
+    value vba,
+    value vind)
+{
+  const bigarray *ba = ba_get(vba);
+  const int64_t n = val_size(vind);
+  if (n > ba->num_dims) {
+    throw std::runtime_error("Bigarray.slice: too many arguments");
+  }
+  int64_t index[kBaMaxDims];
+  ba_read_dims(vind, index, "Bigarray.slice");
+
+  // C slices fix the leading dimensions, Fortran ones the trailing ones.
+  const int64_t rest = ba->num_dims - n;
+  int64_t dims[kBaMaxDims];
+  size_t ofs = 0;
+  if (ba->layout == BA_C_LAYOUT) {
+    for (int64_t i = 0; i < ba->num_dims; ++i) {
+      const int64_t idx = i < n ? index[i] : 0;
+      if (idx < 0 || (i < n && idx >= ba->dim[i])) {
+        throw std::runtime_error("Bigarray.slice: index out of bounds");
+      }
+      ofs = ofs * ba->dim[i] + idx;
+    }
+    memcpy(dims, ba->dim + n, rest * sizeof(int64_t));
+  } else {
+    for (int64_t i = ba->num_dims - 1; i >= 0; --i) {
+      const int64_t idx = i >= rest ? index[i - rest] : 1;
+      if (idx < 1 || (i >= rest && idx > ba->dim[i])) {
+        throw std::runtime_error("Bigarray.slice: index out of bounds");
+      }
+      ofs = ofs * ba->dim[i] + idx - 1;
+    }
+    memcpy(dims, ba->dim, rest * sizeof(int64_t));
+  }
+  char *data = ba->data + ofs * kBaElementSize[ba->kind];
+  return ba_share(ctx, vba, rest, dims, data);
+}
+
+extern "C" value caml_ba_reshape(
+    Context &ctx,
+    value vba,
+    value vdims)
+{
+  const bigarray *ba = ba_get(vba);
+  int64_t dims[kBaMaxDims];
+  ba_read_dims(vdims, dims, "Bigarray.reshape");
+  const int64_t num_dims = val_size(vdims);
+
+  size_t n = 1;
+  for (int64_t i = 0; i < num_dims; ++i) {
+    if (dims[i] < 0) {
+      throw std::runtime_error("Bigarray.reshape: negative dimension");
+    }
+    n *= dims[i];
+  }
+  if (n != ba_num_elems(ba)) {
+    throw std::runtime_error("Bigarray.reshape: size mismatch");
+  }
+  return ba_share(ctx, vba, num_dims, dims, ba->data);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Bulk operations
+// -----------------------------------------------------------------------------
+extern "C" value caml_ba_blit(
+    Context &,
+    value vsrc,
+    value vdst)
+{
+  const bigarray *src = ba_get(vsrc);
+  const bigarray *dst = ba_get(vdst);
+  if (src->num_dims != dst->num_dims) {
+    throw std::runtime_error("Bigarray.blit: dimension mismatch");
+  }
+  for (int64_t i = 0; i < src->num_dims; ++i) {
+    if (src->dim[i] != dst->dim[i]) {
+      throw std::runtime_error("Bigarray.blit: dimension mismatch");
+    }
+  }
+  // Sub-arrays of the same storage might overlap.
+  memmove(dst->data, src->data, ba_byte_size(src));
+  return kUnit;
+}
+
+extern "C" value caml_ba_fill(
+    Context &,
+    value vba,
+    value v)
+{
+  const bigarray *ba = ba_get(vba);
+  const size_t n = ba_num_elems(ba);
+  if (n == 0) {
+    return kUnit;
+  }
+  // Store the first element, then double the filled prefix.
+  ba_store(ba, 0, v);
+  const size_t size = n * kBaElementSize[ba->kind];
+  for (size_t done = kBaElementSize[ba->kind]; done < size; ) {
+    const size_t chunk = std::min(done, size - done);
+    memcpy(ba->data + done, ba->data, chunk);
+    done += chunk;
+  }
+  return kUnit;
+}
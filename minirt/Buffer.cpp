@@ -0,0 +1,324 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "miniml/Context.h"
+#include "minirt/Runtime.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// buffer
+// -----------------------------------------------------------------------------
+
+/// Size of the first chunk of a buffer, unless a larger one is requested.
+static const size_t kMinChunkSize = 256;
+/// Size beyond which chunks stop growing.
+static const size_t kMaxChunkSize = 1 << 20;
+
+/// Contiguous piece of a buffer.
+struct buffer_chunk {
+  char *data;
+  size_t size;
+  size_t capacity;
+};
+
+/// Buffer kept outside the heap as a rope of chunks.
+///
+/// Appending never moves the bytes already in the buffer: once a chunk is
+/// full, a new one twice as large is started. The chunks are written to
+/// channels with a single writev, without building the full string. The
+/// bytes are copied in, since the heap cannot be referenced from outside.
+struct ml_buffer {
+  /// Chunks of the buffer, the last one being appended to.
+  std::vector<buffer_chunk> *chunks;
+  /// Total number of bytes.
+  size_t length;
+};
+
+static void buffer_free_chunks(ml_buffer *buf) {
+  for (const buffer_chunk &chunk : *buf->chunks) {
+    free(chunk.data);
+  }
+  buf->chunks->clear();
+  buf->length = 0;
+}
+
+void buffer_finalize(Context &, value vbuffer) {
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  if (buf->chunks) {
+    buffer_free_chunks(buf);
+    delete buf->chunks;
+    buf->chunks = nullptr;
+  }
+}
+
+CustomOperations buffer_ops {
+  "_buffer",
+  buffer_finalize,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+};
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static void buffer_new_chunk(ml_buffer *buf, size_t size) {
+  size_t capacity = kMinChunkSize;
+  if (!buf->chunks->empty()) {
+    capacity = std::min(buf->chunks->back().capacity * 2, kMaxChunkSize);
+  }
+  capacity = std::max(capacity, size);
+
+  char *data = static_cast<char *>(malloc(capacity));
+  if (!data) {
+    throw std::runtime_error("Buffer: out of memory");
+  }
+  buf->chunks->push_back({ data, 0, capacity });
+}
+
+static void buffer_append(ml_buffer *buf, const char *data, size_t length) {
+  if (length == 0) {
+    return;
+  }
+
+  // Fill up the last chunk, placing the rest in a new one.
+  if (!buf->chunks->empty()) {
+    buffer_chunk &last = buf->chunks->back();
+    const size_t n = std::min(last.capacity - last.size, length);
+    memcpy(last.data + last.size, data, n);
+    last.size += n;
+    buf->length += n;
+    data += n;
+    length -= n;
+  }
+  if (length != 0) {
+    buffer_new_chunk(buf, length);
+    buffer_chunk &last = buf->chunks->back();
+    memcpy(last.data, data, length);
+    last.size = length;
+    buf->length += length;
+  }
+}
+
+/// Copies a range of bytes out of the buffer.
+static void buffer_copy(const ml_buffer *buf, char *dst, size_t ofs, size_t n)
+{
+  for (const buffer_chunk &chunk : *buf->chunks) {
+    if (n == 0) {
+      break;
+    }
+    if (ofs >= chunk.size) {
+      ofs -= chunk.size;
+      continue;
+    }
+    const size_t count = std::min(chunk.size - ofs, n);
+    memcpy(dst, chunk.data + ofs, count);
+    dst += count;
+    n -= count;
+    ofs = 0;
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Buffer
+// -----------------------------------------------------------------------------
+extern "C" value caml_buffer_create(
+    Context &ctx,
+    value vsize)
+{
+  value vbuffer = ctx.allocCustom(&buffer_ops, sizeof(ml_buffer));
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  buf->chunks = new std::vector<buffer_chunk>();
+  buf->length = 0;
+  const int64_t size = val_to_int64(vsize);
+  if (size > 0) {
+    buffer_new_chunk(buf, size);
+  }
+  return vbuffer;
+}
+
+extern "C" value caml_buffer_length(
+    Context &,
+    value vbuffer)
+{
+  return val_int64(val_to_custom<ml_buffer>(vbuffer)->length);
+}
+
+extern "C" value caml_buffer_add_char(
+    Context &,
+    value vbuffer,
+    value vchar)
+{
+  const char c = val_to_int64(vchar);
+  buffer_append(val_to_custom<ml_buffer>(vbuffer), &c, 1);
+  return kUnit;
+}
+
+extern "C" value caml_buffer_add_string(
+    Context &,
+    value vbuffer,
+    value str)
+{
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  buffer_append(buf, val_to_string(str), val_strlen(str));
+  return kUnit;
+}
+
+extern "C" value caml_buffer_add_substring(
+    Context &,
+    value vbuffer,
+    value str,
+    value vofs,
+    value vlen)
+{
+  const int64_t ofs = val_to_int64(vofs), len = val_to_int64(vlen);
+  const int64_t length = val_strlen(str);
+  if (ofs < 0 || len < 0 || ofs + len > length) {
+    throw std::runtime_error("Buffer.add_substring");
+  }
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  buffer_append(buf, val_to_string(str) + ofs, len);
+  return kUnit;
+}
+
+extern "C" value caml_buffer_add_int(
+    Context &,
+    value vbuffer,
+    value vint)
+{
+  // Digits are formatted right to left into a scratch buffer.
+  const int64_t i = val_to_int64(vint);
+  uint64_t u = i < 0 ? -static_cast<uint64_t>(i) : i;
+  char digits[24];
+  char *p = digits + sizeof(digits);
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (i < 0) {
+    *--p = '-';
+  }
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  buffer_append(buf, p, digits + sizeof(digits) - p);
+  return kUnit;
+}
+
+extern "C" value caml_buffer_add_buffer(
+    Context &,
+    value vdst,
+    value vsrc)
+{
+  auto dst = val_to_custom<ml_buffer>(vdst);
+  auto src = val_to_custom<ml_buffer>(vsrc);
+  if (dst == src) {
+    // Appending chunks to the vector being iterated would invalidate it.
+    const std::vector<buffer_chunk> chunks = *src->chunks;
+    for (const buffer_chunk &chunk : chunks) {
+      buffer_append(dst, chunk.data, chunk.size);
+    }
+  } else {
+    for (const buffer_chunk &chunk : *src->chunks) {
+      buffer_append(dst, chunk.data, chunk.size);
+    }
+  }
+  return kUnit;
+}
+
+extern "C" value caml_buffer_contents(
+    Context &ctx,
+    value vbuffer)
+{
+  Value b(vbuffer);
+  const size_t length = val_to_custom<ml_buffer>(b)->length;
+  value str = ctx.allocBytes(length);
+  buffer_copy(val_to_custom<ml_buffer>(b), val_to_string(str), 0, length);
+  return str;
+}
+
+extern "C" value caml_buffer_sub(
+    Context &ctx,
+    value vbuffer,
+    value vofs,
+    value vlen)
+{
+  Value b(vbuffer);
+  const int64_t ofs = val_to_int64(vofs), len = val_to_int64(vlen);
+  const int64_t length = val_to_custom<ml_buffer>(b)->length;
+  if (ofs < 0 || len < 0 || ofs + len > length) {
+    throw std::runtime_error("Buffer.sub");
+  }
+  value str = ctx.allocBytes(len);
+  buffer_copy(val_to_custom<ml_buffer>(b), val_to_string(str), ofs, len);
+  return str;
+}
+
+extern "C" value caml_buffer_nth(
+    Context &,
+    value vbuffer,
+    value vofs)
+{
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  const int64_t ofs = val_to_int64(vofs);
+  if (ofs < 0 || ofs >= static_cast<int64_t>(buf->length)) {
+    throw std::runtime_error("Buffer.nth");
+  }
+  char c;
+  buffer_copy(buf, &c, ofs, 1);
+  return val_int64(static_cast<uint8_t>(c));
+}
+
+extern "C" value caml_buffer_reset(
+    Context &,
+    value vbuffer)
+{
+  buffer_free_chunks(val_to_custom<ml_buffer>(vbuffer));
+  return kUnit;
+}
+
+extern "C" value caml_buffer_clear(
+    Context &,
+    value vbuffer)
+{
+  // Chunks are kept around to be filled again.
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  if (!buf->chunks->empty()) {
+    const buffer_chunk largest = buf->chunks->back();
+    buf->chunks->pop_back();
+    buffer_free_chunks(buf);
+    buf->chunks->push_back({ largest.data, 0, largest.capacity });
+  }
+  return kUnit;
+}
+
+extern "C" value caml_buffer_output(
+    Context &,
+    value vchannel,
+    value vbuffer)
+{
+  auto chan = val_to_custom<channel>(vchannel);
+  auto buf = val_to_custom<ml_buffer>(vbuffer);
+  std::vector<struct iovec> iov;
+  iov.reserve(buf->chunks->size());
+  for (const buffer_chunk &chunk : *buf->chunks) {
+    if (chunk.size != 0) {
+      iov.push_back({ chunk.data, chunk.size });
+    }
+  }
+  channel_writev(chan->fd, iov.data(), iov.size());
+  return kUnit;
+}
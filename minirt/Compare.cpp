@@ -2,73 +2,297 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
 #include "miniml/Context.h"
 using namespace miniml;
 
 
 
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+/// Result of comparisons involving NaN if the order is not total.
+static const int64_t kUnordered = INT64_MIN;
+
+/// Number of pairs of blocks compared before cycles are looked for.
+static const uint64_t kCycleCheckSteps = 1 << 16;
+
+/// Pair of fields remaining to be compared.
+struct compare_item {
+  const value *v1;
+  const value *v2;
+  size_t count;
+};
+
+/// Hash of a pair of blocks being compared.
+struct compare_pair_hash {
+  size_t operator()(const std::pair<value, value> &p) const {
+    return std::hash<value>()(p.first) ^ (std::hash<value>()(p.second) * 31);
+  }
+};
+
+static int64_t compare_doubles(double d1, double d2, bool total) {
+  if (d1 < d2) {
+    return -1;
+  }
+  if (d1 > d2) {
+    return +1;
+  }
+  if (d1 != d2) {
+    // NaN is equal to itself and smaller than any other float.
+    if (!total) {
+      return kUnordered;
+    }
+    if (d1 == d1) {
+      return +1;
+    }
+    if (d2 == d2) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int64_t compare_strings(value v1, value v2) {
+  const size_t l1 = val_strlen(v1);
+  const size_t l2 = val_strlen(v2);
+  const char *s1 = val_to_string(v1), *s2 = val_to_string(v2);
+  const int res = memcmp(s1, s2, std::min(l1, l2));
+  if (res != 0) {
+    return res;
+  }
+  return l1 == l2 ? 0 : (l1 < l2 ? -1 : +1);
+}
+
+static int64_t compare_custom(Context &ctx, value v1, value v2) {
+  const CustomOperations *ops1 = val_ops(v1);
+  const CustomOperations *ops2 = val_ops(v2);
+  if (ops1 != ops2) {
+    return strcmp(ops1->identifier, ops2->identifier);
+  }
+  if (!ops1->compare) {
+    throw std::runtime_error("compare: abstract value");
+  }
+  return ops1->compare(ctx, v1, v2);
+}
+
+/// Compares two values, returning a negative number, zero or a positive one.
+///
+/// Blocks are traversed with an explicit stack of fields remaining to be
+/// compared, so deep structures cannot overflow the native stack. Cyclic
+/// structures are handled by treating a pair of blocks reached again as
+/// equal, pairs only being tracked once a large number of blocks was seen.
+/// If the order is not total, comparisons involving NaN are unordered.
+static int64_t compare_val(Context &ctx, value v1, value v2, bool total) {
+  std::vector<compare_item> stack;
+  std::unordered_set<std::pair<value, value>, compare_pair_hash> seen;
+  uint64_t steps = 0;
+
+  for (;;) {
+    if (v1 != v2 || !total) {
+      if (val_is_int64(v1) || val_is_int64(v2)) {
+        if (val_is_int64(v1) && val_is_int64(v2)) {
+          const int64_t i1 = val_to_int64(v1), i2 = val_to_int64(v2);
+          if (i1 != i2) {
+            return i1 < i2 ? -1 : +1;
+          }
+        } else if (val_is_int64(v1)) {
+          if (val_tag(v2) == kCustomTag && val_ops(v2)->compare_ext) {
+            if (int res = -val_ops(v2)->compare_ext(ctx, v2, v1)) {
+              return res;
+            }
+          } else {
+            return -1;
+          }
+        } else {
+          if (val_tag(v1) == kCustomTag && val_ops(v1)->compare_ext) {
+            if (int res = val_ops(v1)->compare_ext(ctx, v1, v2)) {
+              return res;
+            }
+          } else {
+            return +1;
+          }
+        }
+      } else {
+        const uint8_t t1 = val_tag(v1), t2 = val_tag(v2);
+        if (t1 != t2) {
+          return t1 < t2 ? -1 : +1;
+        }
+
+        switch (t1) {
+          case kStringTag: {
+            if (int64_t res = compare_strings(v1, v2)) {
+              return res;
+            }
+            break;
+          }
+          case kDoubleTag: {
+            const double d1 = val_to_double(v1), d2 = val_to_double(v2);
+            if (int64_t res = compare_doubles(d1, d2, total)) {
+              return res;
+            }
+            break;
+          }
+          case kDoubleArrayTag: {
+            const size_t sz1 = val_size(v1), sz2 = val_size(v2);
+            if (sz1 != sz2) {
+              return sz1 < sz2 ? -1 : +1;
+            }
+            const value *f1 = val_ptr(v1), *f2 = val_ptr(v2);
+            for (size_t i = 0; i < sz1; ++i) {
+              if (f1[i] == f2[i] && total) {
+                continue;
+              }
+              const double d1 = val_to_dbl(f1[i]), d2 = val_to_dbl(f2[i]);
+              if (int64_t res = compare_doubles(d1, d2, total)) {
+                return res;
+              }
+            }
+            break;
+          }
+          case kCustomTag: {
+            if (int64_t res = compare_custom(ctx, v1, v2)) {
+              return res;
+            }
+            break;
+          }
+          case kObjectTag: {
+            // Objects are ordered by their unique identifiers.
+            const int64_t o1 = val_to_int64(val_field(v1, 1));
+            const int64_t o2 = val_to_int64(val_field(v2, 1));
+            if (o1 != o2) {
+              return o1 < o2 ? -1 : +1;
+            }
+            break;
+          }
+          case kClosureTag: case kInfixTag: {
+            throw std::runtime_error("compare: functional value");
+          }
+          case kNoScanTag: {
+            throw std::runtime_error("compare: abstract value");
+          }
+          default: {
+            const size_t sz1 = val_size(v1), sz2 = val_size(v2);
+            if (sz1 != sz2) {
+              return sz1 < sz2 ? -1 : +1;
+            }
+            if (sz1 == 0) {
+              break;
+            }
+            if (++steps > kCycleCheckSteps) {
+              if (!seen.emplace(v1, v2).second) {
+                break;
+              }
+            }
+            stack.push_back({ val_ptr(v1), val_ptr(v2), sz1 });
+            break;
+          }
+        }
+      }
+    }
+
+    // Move on to the next pair of fields.
+    while (!stack.empty() && stack.back().count == 0) {
+      stack.pop_back();
+    }
+    if (stack.empty()) {
+      return 0;
+    }
+    compare_item &item = stack.back();
+    v1 = *item.v1++;
+    v2 = *item.v2++;
+    item.count--;
+  }
+}
+
+
+
 // -----------------------------------------------------------------------------
 // Compare
 // -----------------------------------------------------------------------------
-extern "C" value caml_greaterequal(
-    Context &,
+extern "C" value caml_compare(
+    Context &ctx,
     value v1,
     value v2)
 {
   if (val_is_int64(v1) && val_is_int64(v2)) {
-    return val_int64(val_to_int64(v1) >= val_to_int64(v2));
+    const int64_t i1 = val_to_int64(v1), i2 = val_to_int64(v2);
+    return val_int64((i1 > i2) - (i1 < i2));
   }
-  assert(!"not implemented");
+  const int64_t res = compare_val(ctx, v1, v2, true);
+  return val_int64(res < 0 ? -1 : (res > 0 ? +1 : 0));
 }
 
-value compare(value v1, value v2) {
-  // TODO: handle cycles.
+extern "C" value caml_equal(
+    Context &ctx,
+    value v1,
+    value v2)
+{
   if (val_is_int64(v1) && val_is_int64(v2)) {
-    return val_to_int64(v1) - val_to_int64(v2);
+    return val_int64(v1 == v2);
   }
+  return val_int64(compare_val(ctx, v1, v2, false) == 0);
+}
 
-  auto tag1 = val_tag(v1), tag2 = val_tag(v2);
-  if (tag1 != tag2) {
-    return tag1 - tag2;
+extern "C" value caml_notequal(
+    Context &ctx,
+    value v1,
+    value v2)
+{
+  if (val_is_int64(v1) && val_is_int64(v2)) {
+    return val_int64(v1 != v2);
   }
+  return val_int64(compare_val(ctx, v1, v2, false) != 0);
+}
 
-  switch (tag1) {
-  case kStringTag:
-    assert(!"kStringTag");
-  case kDoubleTag: {
-    double d1 = val_to_double(v1), d2 = val_to_double(v2);
-    if (d1 < d2) {
-      return -1;
-    } else if (d1 > d2) {
-      return + 1;
-    } else {
-      return 0;
-    }
+extern "C" value caml_lessthan(
+    Context &ctx,
+    value v1,
+    value v2)
+{
+  if (val_is_int64(v1) && val_is_int64(v2)) {
+    return val_int64(val_to_int64(v1) < val_to_int64(v2));
   }
-  case kDoubleArrayTag:
-    assert(!"kDoubleArrayTag");
-  default: {
-    int64_t sz1 = val_size(v1), sz2 = val_size(v2);
-    if (sz1 != sz2) {
-      return sz1 - sz2;
-    }
-
-    for (int64_t i = 0; i < sz1; ++i) {
-      if (int r = compare(val_field(v1, i), val_field(v2, i))) {
-        return r;
-      }
-    }
+  const int64_t res = compare_val(ctx, v1, v2, false);
+  return val_int64(res < 0 && res != kUnordered);
+}
 
-    return 0;
+extern "C" value caml_lessequal(
+    Context &ctx,
+    value v1,
+    value v2)
+{
+  if (val_is_int64(v1) && val_is_int64(v2)) {
+    return val_int64(val_to_int64(v1) <= val_to_int64(v2));
   }
+  const int64_t res = compare_val(ctx, v1, v2, false);
+  return val_int64(res <= 0 && res != kUnordered);
+}
+
+extern "C" value caml_greaterthan(
+    Context &ctx,
+    value v1,
+    value v2)
+{
+  if (val_is_int64(v1) && val_is_int64(v2)) {
+    return val_int64(val_to_int64(v1) > val_to_int64(v2));
   }
+  return val_int64(compare_val(ctx, v1, v2, false) > 0);
 }
 
-extern "C" value caml_compare(
-    Context &,
+extern "C" value caml_greaterequal(
+    Context &ctx,
     value v1,
-    value v2,
-    value)
+    value v2)
 {
-  return val_int64(compare(v1, v2));
+  if (val_is_int64(v1) && val_is_int64(v2)) {
+    return val_int64(val_to_int64(v1) >= val_to_int64(v2));
+  }
+  return val_int64(compare_val(ctx, v1, v2, false) >= 0);
 }
@@ -2,6 +2,8 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <cmath>
+
 #include "miniml/Context.h"
 using namespace miniml;
 
@@ -17,3 +19,242 @@ extern "C" value caml_eq_float(
 {
   return val_int64(val_to_double(lhs) == val_to_double(rhs));
 }
+
+extern "C" value caml_neq_float(
+    Context &,
+    value lhs,
+    value rhs)
+{
+  return val_int64(val_to_double(lhs) != val_to_double(rhs));
+}
+
+extern "C" value caml_lt_float(
+    Context &,
+    value lhs,
+    value rhs)
+{
+  return val_int64(val_to_double(lhs) < val_to_double(rhs));
+}
+
+extern "C" value caml_le_float(
+    Context &,
+    value lhs,
+    value rhs)
+{
+  return val_int64(val_to_double(lhs) <= val_to_double(rhs));
+}
+
+extern "C" value caml_gt_float(
+    Context &,
+    value lhs,
+    value rhs)
+{
+  return val_int64(val_to_double(lhs) > val_to_double(rhs));
+}
+
+extern "C" value caml_ge_float(
+    Context &,
+    value lhs,
+    value rhs)
+{
+  return val_int64(val_to_double(lhs) >= val_to_double(rhs));
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Float arithmetic
+// -----------------------------------------------------------------------------
+extern "C" value caml_neg_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(-x);
+}
+
+extern "C" value caml_abs_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::fabs(x));
+}
+
+extern "C" value caml_sqrt_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::sqrt(x));
+}
+
+extern "C" value caml_exp_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::exp(x));
+}
+
+extern "C" value caml_log_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::log(x));
+}
+
+extern "C" value caml_log10_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::log10(x));
+}
+
+extern "C" value caml_sin_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::sin(x));
+}
+
+extern "C" value caml_cos_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::cos(x));
+}
+
+extern "C" value caml_tan_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::tan(x));
+}
+
+extern "C" value caml_asin_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::asin(x));
+}
+
+extern "C" value caml_acos_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::acos(x));
+}
+
+extern "C" value caml_atan_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::atan(x));
+}
+
+extern "C" value caml_floor_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::floor(x));
+}
+
+extern "C" value caml_ceil_float(
+    Context &ctx,
+    value val)
+{
+  const double x = val_to_double(val);
+  return ctx.allocDouble(std::ceil(x));
+}
+
+extern "C" value caml_add_float(
+    Context &ctx,
+    value lhs,
+    value rhs)
+{
+  const double x = val_to_double(lhs), y = val_to_double(rhs);
+  return ctx.allocDouble(x + y);
+}
+
+extern "C" value caml_sub_float(
+    Context &ctx,
+    value lhs,
+    value rhs)
+{
+  const double x = val_to_double(lhs), y = val_to_double(rhs);
+  return ctx.allocDouble(x - y);
+}
+
+extern "C" value caml_mul_float(
+    Context &ctx,
+    value lhs,
+    value rhs)
+{
+  const double x = val_to_double(lhs), y = val_to_double(rhs);
+  return ctx.allocDouble(x * y);
+}
+
+extern "C" value caml_div_float(
+    Context &ctx,
+    value lhs,
+    value rhs)
+{
+  const double x = val_to_double(lhs), y = val_to_double(rhs);
+  return ctx.allocDouble(x / y);
+}
+
+extern "C" value caml_power_float(
+    Context &ctx,
+    value lhs,
+    value rhs)
+{
+  const double x = val_to_double(lhs), y = val_to_double(rhs);
+  return ctx.allocDouble(std::pow(x, y));
+}
+
+extern "C" value caml_fmod_float(
+    Context &ctx,
+    value lhs,
+    value rhs)
+{
+  const double x = val_to_double(lhs), y = val_to_double(rhs);
+  return ctx.allocDouble(std::fmod(x, y));
+}
+
+extern "C" value caml_atan2_float(
+    Context &ctx,
+    value lhs,
+    value rhs)
+{
+  const double x = val_to_double(lhs), y = val_to_double(rhs);
+  return ctx.allocDouble(std::atan2(x, y));
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Conversions
+// -----------------------------------------------------------------------------
+extern "C" value caml_float_of_int(
+    Context &ctx,
+    value val)
+{
+  return ctx.allocDouble(static_cast<double>(val_to_int64(val)));
+}
+
+extern "C" value caml_int_of_float(
+    Context &,
+    value val)
+{
+  return val_int64(static_cast<int64_t>(val_to_double(val)));
+}
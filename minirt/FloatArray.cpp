@@ -0,0 +1,382 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "miniml/Context.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Scalar kernels
+// -----------------------------------------------------------------------------
+namespace {
+
+void fill_scalar(double *dst, size_t n, double v) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = v;
+  }
+}
+
+void add_scalar(double *dst, const double *a, const double *b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = a[i] + b[i];
+  }
+}
+
+void mul_scalar(double *dst, const double *a, const double *b, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = a[i] * b[i];
+  }
+}
+
+void axpy_scalar(double *y, double alpha, const double *x, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    y[i] = alpha * x[i] + y[i];
+  }
+}
+
+double dot_scalar(const double *a, const double *b, size_t n) {
+  double sum = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+double sum_scalar(const double *a, size_t n) {
+  double sum = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    sum += a[i];
+  }
+  return sum;
+}
+
+double min_scalar(const double *a, size_t n) {
+  double m = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < n; ++i) {
+    m = a[i] < m ? a[i] : m;
+  }
+  return m;
+}
+
+double max_scalar(const double *a, size_t n) {
+  double m = -std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < n; ++i) {
+    m = a[i] > m ? a[i] : m;
+  }
+  return m;
+}
+
+} // namespace
+
+
+
+// -----------------------------------------------------------------------------
+// AVX2 kernels
+// -----------------------------------------------------------------------------
+#if defined(__x86_64__)
+namespace {
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 void fill_avx2(double *dst, size_t n, double v) {
+  const __m256d vv = _mm256_set1_pd(v);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(dst + i, vv);
+  }
+  fill_scalar(dst + i, n - i, v);
+}
+
+AVX2 void add_avx2(double *dst, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d va = _mm256_loadu_pd(a + i);
+    const __m256d vb = _mm256_loadu_pd(b + i);
+    _mm256_storeu_pd(dst + i, _mm256_add_pd(va, vb));
+  }
+  add_scalar(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 void mul_avx2(double *dst, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d va = _mm256_loadu_pd(a + i);
+    const __m256d vb = _mm256_loadu_pd(b + i);
+    _mm256_storeu_pd(dst + i, _mm256_mul_pd(va, vb));
+  }
+  mul_scalar(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 void axpy_avx2(double *y, double alpha, const double *x, size_t n) {
+  // A separate multiply and add round like the scalar loop.
+  const __m256d va = _mm256_set1_pd(alpha);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256d vx = _mm256_mul_pd(va, _mm256_loadu_pd(x + i));
+    _mm256_storeu_pd(y + i, _mm256_add_pd(vx, _mm256_loadu_pd(y + i)));
+  }
+  axpy_scalar(y + i, alpha, x + i, n - i);
+}
+
+AVX2 double reduce_avx2(__m256d v) {
+  const __m128d lo = _mm256_castpd256_pd128(v);
+  const __m128d hi = _mm256_extractf128_pd(v, 1);
+  const __m128d s = _mm_add_pd(lo, hi);
+  return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+AVX2 double dot_avx2(const double *a, const double *b, size_t n) {
+  // Products are rounded before they are added, like in the scalar loop.
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256d p0 = _mm256_mul_pd(
+        _mm256_loadu_pd(a + i),
+        _mm256_loadu_pd(b + i)
+    );
+    const __m256d p1 = _mm256_mul_pd(
+        _mm256_loadu_pd(a + i + 4),
+        _mm256_loadu_pd(b + i + 4)
+    );
+    s0 = _mm256_add_pd(s0, p0);
+    s1 = _mm256_add_pd(s1, p1);
+  }
+  return reduce_avx2(_mm256_add_pd(s0, s1)) + dot_scalar(a + i, b + i, n - i);
+}
+
+AVX2 double sum_avx2(const double *a, size_t n) {
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    s0 = _mm256_add_pd(s0, _mm256_loadu_pd(a + i));
+    s1 = _mm256_add_pd(s1, _mm256_loadu_pd(a + i + 4));
+  }
+  return reduce_avx2(_mm256_add_pd(s0, s1)) + sum_scalar(a + i, n - i);
+}
+
+AVX2 double min_avx2(const double *a, size_t n) {
+  // minpd returns the second operand if either is NaN: NaNs are skipped
+  // like in the scalar loop, since the accumulator is never NaN.
+  __m256d m = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    m = _mm256_min_pd(_mm256_loadu_pd(a + i), m);
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, m);
+  const double r = std::min(std::min(lanes[0], lanes[1]),
+                            std::min(lanes[2], lanes[3]));
+  return std::min(r, min_scalar(a + i, n - i));
+}
+
+AVX2 double max_avx2(const double *a, size_t n) {
+  __m256d m = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    m = _mm256_max_pd(_mm256_loadu_pd(a + i), m);
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, m);
+  const double r = std::max(std::max(lanes[0], lanes[1]),
+                            std::max(lanes[2], lanes[3]));
+  return std::max(r, max_scalar(a + i, n - i));
+}
+
+#undef AVX2
+
+} // namespace
+#endif
+
+
+
+// -----------------------------------------------------------------------------
+// Dispatch
+// -----------------------------------------------------------------------------
+namespace {
+
+/// Kernels for the instruction set of the host.
+struct Kernels {
+  void (*fill)(double *, size_t, double);
+  void (*add)(double *, const double *, const double *, size_t);
+  void (*mul)(double *, const double *, const double *, size_t);
+  void (*axpy)(double *, double, const double *, size_t);
+  double (*dot)(const double *, const double *, size_t);
+  double (*sum)(const double *, size_t);
+  double (*min)(const double *, size_t);
+  double (*max)(const double *, size_t);
+};
+
+Kernels select_kernels() {
+#if defined(__x86_64__)
+  // MLNOSIMD forces the scalar kernels, to test them on any host.
+  if (__builtin_cpu_supports("avx2") && !getenv("MLNOSIMD")) {
+    return Kernels{
+        fill_avx2, add_avx2, mul_avx2, axpy_avx2,
+        dot_avx2, sum_avx2, min_avx2, max_avx2
+    };
+  }
+#endif
+  return Kernels{
+      fill_scalar, add_scalar, mul_scalar, axpy_scalar,
+      dot_scalar, sum_scalar, min_scalar, max_scalar
+  };
+}
+
+const Kernels &kernels() {
+  static const Kernels k = select_kernels();
+  return k;
+}
+
+} // namespace
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static double *farray_data(value ar) {
+  return reinterpret_cast<double *>(val_ptr(ar));
+}
+
+/// Returns the length of a float array. Empty float arrays are atoms.
+static size_t farray_length(value ar, const char *fn) {
+  if (val_size(ar) != 0 && val_tag(ar) != kDoubleArrayTag) {
+    throw std::runtime_error(std::string(fn) + ": not a float array");
+  }
+  return val_size(ar);
+}
+
+static void farray_check(value ar, int64_t ofs, int64_t len, const char *fn) {
+  const int64_t size = farray_length(ar, fn);
+  if (ofs < 0 || len < 0 || ofs > size || len > size - ofs) {
+    throw std::runtime_error(std::string(fn) + ": index out of bounds");
+  }
+}
+
+static size_t farray_size(value a, value b, const char *fn) {
+  const size_t n = farray_length(a, fn);
+  if (farray_length(b, fn) != n) {
+    throw std::runtime_error(std::string(fn) + ": length mismatch");
+  }
+  return n;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Float arrays
+// -----------------------------------------------------------------------------
+extern "C" value caml_floatarray_fill(
+    Context &,
+    value array,
+    value ofs,
+    value len,
+    value v)
+{
+  const int64_t o = val_to_int64(ofs);
+  const int64_t n = val_to_int64(len);
+  farray_check(array, o, n, "Float.Array.fill");
+  kernels().fill(farray_data(array) + o, n, val_to_double(v));
+  return kUnit;
+}
+
+extern "C" value caml_floatarray_blit(
+    Context &,
+    value a1,
+    value ofs1,
+    value a2,
+    value ofs2,
+    value len)
+{
+  const int64_t o1 = val_to_int64(ofs1);
+  const int64_t o2 = val_to_int64(ofs2);
+  const int64_t n = val_to_int64(len);
+  farray_check(a1, o1, n, "Float.Array.blit");
+  farray_check(a2, o2, n, "Float.Array.blit");
+  memmove(farray_data(a2) + o2, farray_data(a1) + o1, n * sizeof(double));
+  return kUnit;
+}
+
+extern "C" value caml_floatarray_add(
+    Context &,
+    value dst,
+    value a,
+    value b)
+{
+  const size_t n = farray_size(a, b, "Float.Array.add");
+  farray_size(dst, a, "Float.Array.add");
+  kernels().add(farray_data(dst), farray_data(a), farray_data(b), n);
+  return kUnit;
+}
+
+extern "C" value caml_floatarray_mul(
+    Context &,
+    value dst,
+    value a,
+    value b)
+{
+  const size_t n = farray_size(a, b, "Float.Array.mul");
+  farray_size(dst, a, "Float.Array.mul");
+  kernels().mul(farray_data(dst), farray_data(a), farray_data(b), n);
+  return kUnit;
+}
+
+extern "C" value caml_floatarray_axpy(
+    Context &,
+    value alpha,
+    value x,
+    value y)
+{
+  const size_t n = farray_size(x, y, "Float.Array.axpy");
+  kernels().axpy(farray_data(y), val_to_double(alpha), farray_data(x), n);
+  return kUnit;
+}
+
+// The order in which the products and elements are added depends on the
+// kernels used by the host, so the rounding of dot and sum does too.
+extern "C" value caml_floatarray_dot(
+    Context &ctx,
+    value a,
+    value b)
+{
+  const size_t n = farray_size(a, b, "Float.Array.dot");
+  return ctx.allocDouble(kernels().dot(farray_data(a), farray_data(b), n));
+}
+
+extern "C" value caml_floatarray_sum(
+    Context &ctx,
+    value a)
+{
+  const size_t n = farray_length(a, "Float.Array.sum");
+  return ctx.allocDouble(kernels().sum(farray_data(a), n));
+}
+
+// The minimum of an empty array is infinity, the maximum -infinity.
+extern "C" value caml_floatarray_min(
+    Context &ctx,
+    value a)
+{
+  const size_t n = farray_length(a, "Float.Array.min");
+  return ctx.allocDouble(kernels().min(farray_data(a), n));
+}
+
+extern "C" value caml_floatarray_max(
+    Context &ctx,
+    value a)
+{
+  const size_t n = farray_length(a, "Float.Array.max");
+  return ctx.allocDouble(kernels().max(farray_data(a), n));
+}
@@ -2,24 +2,166 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <algorithm>
+
 #include "miniml/Context.h"
 using namespace miniml;
 
 
 
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+/// Smallest stack limit accepted by Gc.set (words).
+static const int64_t kMinStackLimit = 1 << 12;
+
+/// Reads a field of a control record, clamping it to a minimum.
+static size_t gc_param(value control, size_t field, int64_t min) {
+  return std::max(val_to_int64(val_field(control, field)), min);
+}
+
+static value gc_stat(Context &ctx, const HeapStats &s) {
+  Value minorWords = ctx.allocDouble(s.minorWords);
+  Value promotedWords = ctx.allocDouble(s.promotedWords);
+  Value majorWords = ctx.allocDouble(s.majorWords);
+
+  value stat = ctx.allocBlock(16, 0);
+  val_field(stat,  0) = minorWords;
+  val_field(stat,  1) = promotedWords;
+  val_field(stat,  2) = majorWords;
+  val_field(stat,  3) = val_int64(s.minorCollections);
+  val_field(stat,  4) = val_int64(s.majorCollections);
+  val_field(stat,  5) = val_int64(s.heapWords);
+  val_field(stat,  6) = val_int64(s.heapChunks);
+  val_field(stat,  7) = val_int64(s.liveWords);
+  val_field(stat,  8) = val_int64(s.liveBlocks);
+  val_field(stat,  9) = val_int64(s.freeWords);
+  val_field(stat, 10) = val_int64(s.freeBlocks);
+  val_field(stat, 11) = val_int64(s.largestFree);
+  val_field(stat, 12) = val_int64(s.fragments);
+  val_field(stat, 13) = val_int64(0);
+  val_field(stat, 14) = val_int64(s.topHeapWords);
+  val_field(stat, 15) = val_int64(0);
+  return stat;
+}
+
+
+
 // -----------------------------------------------------------------------------
 // Garbage Collector Interface
 // -----------------------------------------------------------------------------
 extern "C" value caml_get_minor_free(
-    Context &,
+    Context &ctx,
+    value)
+{
+  return val_int64(ctx.getMinorFree());
+}
+
+extern "C" value caml_gc_minor(
+    Context &ctx,
+    value)
+{
+  ctx.minorCollection();
+  return kUnit;
+}
+
+extern "C" value caml_gc_major(
+    Context &ctx,
     value)
 {
-  return val_int64(0x100000);
+  ctx.majorCollection();
+  return kUnit;
 }
 
 extern "C" value caml_gc_full_major(
-    Context &,
+    Context &ctx,
+    value)
+{
+  ctx.majorCollection();
+  return kUnit;
+}
+
+extern "C" value caml_gc_compaction(
+    Context &ctx,
+    value)
+{
+  ctx.majorCollection();
+  return kUnit;
+}
+
+extern "C" value caml_gc_stat(
+    Context &ctx,
+    value)
+{
+  return gc_stat(ctx, ctx.getStats(true));
+}
+
+extern "C" value caml_gc_quick_stat(
+    Context &ctx,
+    value)
+{
+  return gc_stat(ctx, ctx.getStats(false));
+}
+
+extern "C" value caml_gc_counters(
+    Context &ctx,
+    value)
+{
+  HeapStats s = ctx.getStats(false);
+  Value minorWords = ctx.allocDouble(s.minorWords);
+  Value promotedWords = ctx.allocDouble(s.promotedWords);
+  Value majorWords = ctx.allocDouble(s.majorWords);
+
+  value counters = ctx.allocBlock(3, 0);
+  val_field(counters, 0) = minorWords;
+  val_field(counters, 1) = promotedWords;
+  val_field(counters, 2) = majorWords;
+  return counters;
+}
+
+extern "C" value caml_gc_minor_words(
+    Context &ctx,
+    value)
+{
+  return ctx.allocDouble(ctx.getStats(false).minorWords);
+}
+
+extern "C" value caml_gc_get(
+    Context &ctx,
     value)
 {
+  const HeapParams &params = ctx.getHeapParams();
+  value control = ctx.allocBlock(8, 0);
+  val_field(control, 0) = val_int64(params.minorHeapSize);
+  val_field(control, 1) = val_int64(params.majorIncrement);
+  val_field(control, 2) = val_int64(params.spaceOverhead);
+  val_field(control, 3) = val_int64(0);
+  val_field(control, 4) = val_int64(1000000);
+  val_field(control, 5) = val_int64(params.stackLimit);
+  val_field(control, 6) = val_int64(0);
+  val_field(control, 7) = val_int64(1);
+  return control;
+}
+
+extern "C" value caml_gc_set(
+    Context &ctx,
+    value control)
+{
+  // Verbosity, compaction, allocation policy and window size are ignored.
+  HeapParams params = ctx.getHeapParams();
+  params.minorHeapSize = gc_param(control, 0, 1);
+  params.majorIncrement = gc_param(control, 1, 1);
+  params.spaceOverhead = gc_param(control, 2, 1);
+  params.stackLimit = gc_param(control, 5, kMinStackLimit);
+  ctx.setHeapParams(params);
+  return kUnit;
+}
+
+extern "C" value caml_memprof_dump(
+    Context &ctx,
+    value prefix)
+{
+  ctx.writeMemprof(val_to_string(prefix));
   return kUnit;
 }
@@ -0,0 +1,225 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstring>
+
+#include "miniml/Context.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// MurmurHash3 mixing
+// -----------------------------------------------------------------------------
+
+/// Maximal number of values queued for hashing.
+static const size_t kHashQueueSize = 256;
+/// Maximal length of a chain of forwarding blocks followed.
+static const size_t kMaxForward = 1000;
+
+static inline uint32_t hash_rotl(uint32_t x, unsigned n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t hash_mix_uint32(uint32_t h, uint32_t d) {
+  d *= 0xcc9e2d51;
+  d = hash_rotl(d, 15);
+  d *= 0x1b873593;
+  h ^= d;
+  h = hash_rotl(h, 13);
+  return h * 5 + 0xe6546b64;
+}
+
+static inline uint32_t hash_mix_intnat(uint32_t h, int64_t d) {
+  // Mix in both halves, such that small integers hash as in 32-bit mode.
+  const uint32_t n = (d >> 32) ^ (d >> 63) ^ d;
+  return hash_mix_uint32(h, n);
+}
+
+static inline uint32_t hash_mix_double(uint32_t hash, double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  uint32_t h = bits >> 32, l = bits;
+  if ((h & 0x7FF00000) == 0x7FF00000 && (l | (h & 0xFFFFF)) != 0) {
+    // All NaNs hash to the same value.
+    h = 0x7FF00001;
+    l = 0;
+  } else if (h == 0x80000000 && l == 0) {
+    // -0.0 hashes like +0.0.
+    h = 0;
+  }
+  hash = hash_mix_uint32(hash, l);
+  return hash_mix_uint32(hash, h);
+}
+
+static inline uint32_t hash_load32(const uint8_t *p) {
+  uint32_t w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+static uint32_t hash_mix_string(uint32_t h, value s) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(val_to_string(s));
+  const size_t len = val_strlen(s);
+
+  // Words are mixed in sequentially, 16 bytes being loaded per iteration.
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const uint32_t w0 = hash_load32(p + i + 0);
+    const uint32_t w1 = hash_load32(p + i + 4);
+    const uint32_t w2 = hash_load32(p + i + 8);
+    const uint32_t w3 = hash_load32(p + i + 12);
+    h = hash_mix_uint32(h, w0);
+    h = hash_mix_uint32(h, w1);
+    h = hash_mix_uint32(h, w2);
+    h = hash_mix_uint32(h, w3);
+  }
+  for (; i + 4 <= len; i += 4) {
+    h = hash_mix_uint32(h, hash_load32(p + i));
+  }
+
+  uint32_t w = 0;
+  switch (len & 3) {
+    case 3: w = p[i + 2] << 16;   // fallthrough
+    case 2: w |= p[i + 1] << 8;   // fallthrough
+    case 1: w |= p[i]; h = hash_mix_uint32(h, w); break;
+    default: break;
+  }
+  return h ^ static_cast<uint32_t>(len);
+}
+
+static uint32_t hash_final_mix(uint32_t h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Hash
+// -----------------------------------------------------------------------------
+extern "C" value caml_hash(
+    Context &ctx,
+    value count,
+    value limit,
+    value seed,
+    value obj)
+{
+  // Values are visited breadth-first, stopping after num meaningful ones
+  // were hashed or sz ones were queued.
+  int64_t sz = val_to_int64(limit);
+  if (sz < 0 || sz > static_cast<int64_t>(kHashQueueSize)) {
+    sz = kHashQueueSize;
+  }
+  int64_t num = val_to_int64(count);
+  uint32_t h = val_to_int64(seed);
+
+  value queue[kHashQueueSize];
+  size_t rd = 0, wr = 1;
+  queue[0] = obj;
+  while (rd < wr && num > 0) {
+    value v = queue[rd++];
+
+    // Forwarding blocks hash like their target. Chains might be cyclic, so
+    // values are given up on beyond a certain length.
+    for (size_t i = 0; i < kMaxForward; ++i) {
+      if (val_is_int64(v) || val_tag(v) != kForwardTag) {
+        break;
+      }
+      v = val_field(v, 0);
+    }
+
+    if (val_is_int64(v)) {
+      h = hash_mix_intnat(h, v);
+      num--;
+      continue;
+    }
+
+    if (val_tag(v) == kForwardTag) {
+      continue;
+    }
+
+    if (val_tag(v) == kInfixTag) {
+      // The offset tells apart the functions of a recursive definition,
+      // which otherwise hash like the enclosing closure.
+      const uint32_t offset = val_size(v) * sizeof(value);
+      h = hash_mix_uint32(h, offset);
+      v -= offset;
+    }
+
+    switch (val_tag(v)) {
+      case kStringTag: {
+        h = hash_mix_string(h, v);
+        num--;
+        break;
+      }
+      case kDoubleTag: {
+        h = hash_mix_double(h, val_to_double(v));
+        num--;
+        break;
+      }
+      case kDoubleArrayTag: {
+        for (size_t i = 0, n = val_size(v); i < n && num > 0; ++i) {
+          h = hash_mix_double(h, val_to_dbl(val_field(v, i)));
+          num--;
+        }
+        break;
+      }
+      case kNoScanTag: {
+        break;
+      }
+      case kObjectTag: {
+        h = hash_mix_intnat(h, val_to_int64(val_field(v, 1)));
+        num--;
+        break;
+      }
+      case kClosureTag: {
+        // Code pointers are PCs, not values: they are mixed in as integers
+        // and only the environment is queued. Recursive closures interleave
+        // infix headers and code pointers before the environment.
+        h = hash_mix_uint32(h, val_header(v) & ~0x300ull);
+        const size_t n = val_size(v);
+        h = hash_mix_intnat(h, val_field(v, 0));
+        num--;
+        size_t i = 1;
+        for (; i + 1 < n && (val_field(v, i) & 0xFF) == kInfixTag; i += 2) {
+          h = hash_mix_intnat(h, val_field(v, i));
+          h = hash_mix_intnat(h, val_field(v, i + 1));
+          num--;
+        }
+        for (; i < n; ++i) {
+          if (wr >= static_cast<size_t>(sz)) {
+            break;
+          }
+          queue[wr++] = val_field(v, i);
+        }
+        break;
+      }
+      case kCustomTag: {
+        if (auto hash = val_ops(v)->hash) {
+          h = hash_mix_uint32(h, hash(ctx, v, val_int64(0)));
+          num--;
+        }
+        break;
+      }
+      default: {
+        // The tag and size are mixed in without counting towards num.
+        h = hash_mix_uint32(h, val_header(v) & ~0x300ull);
+        for (size_t i = 0, n = val_size(v); i < n; ++i) {
+          if (wr >= static_cast<size_t>(sz)) {
+            break;
+          }
+          queue[wr++] = val_field(v, i);
+        }
+        break;
+      }
+    }
+  }
+
+  return val_int64(hash_final_mix(h) & 0x3FFFFFFFu);
+}
@@ -0,0 +1,391 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "miniml/Context.h"
+using namespace miniml;
+
+extern "C" value caml_compare(Context &, value, value);
+extern "C" value caml_hash(Context &, value, value, value, value);
+
+
+
+// -----------------------------------------------------------------------------
+// nhashtbl
+// -----------------------------------------------------------------------------
+
+/// Number of control bytes probed at once.
+static const size_t kGroupSize = 16;
+/// Control byte of an empty slot.
+static const uint8_t kCtrlEmpty = 0x80;
+/// Control byte of a removed entry.
+static const uint8_t kCtrlDeleted = 0xFE;
+/// Largest number of entries a table can be created for.
+static const int64_t kMaxCreateSize = 1 << 22;
+
+/// Fields of the block representing a table.
+enum {
+  NHT_INDEX,
+  NHT_KEYS,
+  NHT_VALUES,
+  NHT_SIZE,
+};
+
+/// Index of an open-addressing table, kept outside the heap.
+///
+/// Each slot has a control byte which is either empty, deleted or holds
+/// the low 7 bits of the hash of the key, allowing a group of slots to be
+/// matched with a single vector comparison. The first group of control
+/// bytes is mirrored after the last one, so groups can wrap around. Keys
+/// and values are stored in arrays on the heap, which the GC scans.
+struct nhashtbl {
+  /// Control bytes.
+  uint8_t *ctrl;
+  /// Full hashes of keys.
+  uint32_t *hashes;
+  /// Number of slots, a power of two.
+  size_t capacity;
+  /// Number of entries.
+  size_t size;
+  /// Number of entries and deleted slots.
+  size_t used;
+};
+
+void nhashtbl_finalize(Context &, value vindex) {
+  auto index = val_to_custom<nhashtbl>(vindex);
+  free(index->ctrl);
+  free(index->hashes);
+  index->ctrl = nullptr;
+  index->hashes = nullptr;
+}
+
+CustomOperations nhashtbl_ops = {
+  "_nhashtbl",
+  nhashtbl_finalize,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+  nullptr,
+};
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static nhashtbl *nht_index(value t) {
+  return val_to_custom<nhashtbl>(val_field(t, NHT_INDEX));
+}
+
+static uint32_t nht_hash(Context &ctx, value key) {
+  // Same parameters as Hashtbl.hash.
+  const value h = caml_hash(
+      ctx, val_int64(10), val_int64(100), val_int64(0), key
+  );
+  return val_to_int64(h);
+}
+
+/// Spreads the 30 bits of a hash over 64 bits, such that both the position
+/// of a slot and its control byte depend on all of them.
+static uint64_t nht_mix(uint32_t hash) {
+  return hash * 0x9E3779B97F4A7C15ull;
+}
+
+/// Returns the slot where probing for a hash starts.
+static size_t nht_pos(uint32_t hash, size_t mask) {
+  return (nht_mix(hash) >> 32) & mask;
+}
+
+/// Returns the control byte of a hash.
+static uint8_t nht_ctrl(uint32_t hash) {
+  return nht_mix(hash) >> 57;
+}
+
+static bool nht_equal(Context &ctx, value k1, value k2) {
+  if (k1 == k2) {
+    return true;
+  }
+  if (val_is_int64(k1) || val_is_int64(k2)) {
+    return false;
+  }
+  if (val_tag(k1) == kStringTag && val_tag(k2) == kStringTag) {
+    const size_t l1 = val_strlen(k1);
+    return l1 == val_strlen(k2) &&
+           memcmp(val_to_string(k1), val_to_string(k2), l1) == 0;
+  }
+  // NaN keys must find themselves, so the total order is used.
+  return val_to_int64(caml_compare(ctx, k1, k2)) == 0;
+}
+
+/// Returns a mask of the slots in a group with a given control byte.
+static uint32_t nht_match(const uint8_t *group, uint8_t ctrl) {
+#if defined(__SSE2__)
+  const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(ctrl)));
+#else
+  uint32_t mask = 0;
+  for (size_t i = 0; i < kGroupSize; ++i) {
+    mask |= (group[i] == ctrl ? 1u : 0u) << i;
+  }
+  return mask;
+#endif
+}
+
+/// Returns a mask of the empty or deleted slots in a group.
+static uint32_t nht_match_free(const uint8_t *group) {
+#if defined(__SSE2__)
+  // Only the control bytes of free slots have their top bit set.
+  const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+  return _mm_movemask_epi8(g);
+#else
+  uint32_t mask = 0;
+  for (size_t i = 0; i < kGroupSize; ++i) {
+    mask |= (group[i] >> 7) << i;
+  }
+  return mask;
+#endif
+}
+
+static void nht_set_ctrl(nhashtbl *index, size_t i, uint8_t ctrl) {
+  index->ctrl[i] = ctrl;
+  if (i < kGroupSize) {
+    index->ctrl[index->capacity + i] = ctrl;
+  }
+}
+
+static void nht_init(nhashtbl *index, size_t capacity) {
+  index->capacity = capacity;
+  index->size = 0;
+  index->used = 0;
+  index->ctrl = static_cast<uint8_t *>(malloc(capacity + kGroupSize));
+  index->hashes = static_cast<uint32_t *>(
+      malloc(capacity * sizeof(uint32_t))
+  );
+  if (!index->ctrl || !index->hashes) {
+    throw std::runtime_error("Hashtbl: out of memory");
+  }
+  memset(index->ctrl, kCtrlEmpty, capacity + kGroupSize);
+}
+
+/// Finds the slot holding a key, returning -1 if there is none.
+static int64_t nht_find(Context &ctx, value t, value key, uint32_t hash) {
+  const nhashtbl *index = nht_index(t);
+  const value keys = val_field(t, NHT_KEYS);
+  const size_t mask = index->capacity - 1;
+  const uint8_t h2 = nht_ctrl(hash);
+
+  // Groups are probed quadratically, until one with an empty slot.
+  size_t pos = nht_pos(hash, mask);
+  for (size_t stride = kGroupSize; ; stride += kGroupSize) {
+    const uint8_t *group = index->ctrl + pos;
+    for (uint32_t m = nht_match(group, h2); m; m &= m - 1) {
+      const size_t i = (pos + __builtin_ctz(m)) & mask;
+      if (index->hashes[i] != hash) {
+        continue;
+      }
+      if (nht_equal(ctx, val_field(keys, i), key)) {
+        return i;
+      }
+    }
+    if (nht_match(group, kCtrlEmpty)) {
+      return -1;
+    }
+    pos = (pos + stride) & mask;
+  }
+}
+
+/// Finds a free slot for a key absent from the table.
+static size_t nht_find_free(const nhashtbl *index, uint32_t hash) {
+  const size_t mask = index->capacity - 1;
+  size_t pos = nht_pos(hash, mask);
+  for (size_t stride = kGroupSize; ; stride += kGroupSize) {
+    if (uint32_t m = nht_match_free(index->ctrl + pos)) {
+      return (pos + __builtin_ctz(m)) & mask;
+    }
+    pos = (pos + stride) & mask;
+  }
+}
+
+static value nht_alloc_array(Context &ctx, size_t n) {
+  value array = ctx.allocBlock(n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    val_field(array, i) = val_int64(0);
+  }
+  return array;
+}
+
+/// Moves all entries into arrays of a new capacity, dropping deleted slots.
+static void nht_resize(Context &ctx, Value &t, size_t capacity) {
+  Value keys = nht_alloc_array(ctx, capacity);
+  Value vals = nht_alloc_array(ctx, capacity);
+
+  nhashtbl *index = nht_index(t);
+  nhashtbl old = *index;
+  nht_init(index, capacity);
+
+  const value oldKeys = val_field(t, NHT_KEYS);
+  const value oldVals = val_field(t, NHT_VALUES);
+  for (size_t i = 0; i < old.capacity; ++i) {
+    if (old.ctrl[i] & 0x80) {
+      continue;
+    }
+    const uint32_t hash = old.hashes[i];
+    const size_t j = nht_find_free(index, hash);
+    nht_set_ctrl(index, j, nht_ctrl(hash));
+    index->hashes[j] = hash;
+    ctx.setField(keys, j, val_field(oldKeys, i));
+    ctx.setField(vals, j, val_field(oldVals, i));
+  }
+  index->size = old.size;
+  index->used = old.size;
+  free(old.ctrl);
+  free(old.hashes);
+
+  ctx.setField(t, NHT_KEYS, keys);
+  ctx.setField(t, NHT_VALUES, vals);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Hashtbl
+// -----------------------------------------------------------------------------
+extern "C" value caml_nhashtbl_create(
+    Context &ctx,
+    value vsize)
+{
+  const int64_t size = std::min(
+      std::max<int64_t>(val_to_int64(vsize), 1),
+      kMaxCreateSize
+  );
+  size_t capacity = kGroupSize;
+  while (capacity * 7 / 8 < static_cast<size_t>(size)) {
+    capacity *= 2;
+  }
+
+  Value vindex = ctx.allocCustom(&nhashtbl_ops, sizeof(nhashtbl));
+  auto index = val_to_custom<nhashtbl>(vindex);
+  index->ctrl = nullptr;
+  index->hashes = nullptr;
+  nht_init(index, capacity);
+
+  Value keys = nht_alloc_array(ctx, capacity);
+  Value vals = nht_alloc_array(ctx, capacity);
+  value t = ctx.allocBlock(NHT_SIZE, 0);
+  val_field(t, NHT_INDEX) = vindex;
+  val_field(t, NHT_KEYS) = keys;
+  val_field(t, NHT_VALUES) = vals;
+  return t;
+}
+
+extern "C" value caml_nhashtbl_replace(
+    Context &ctx,
+    value vt,
+    value vkey,
+    value vval)
+{
+  Value t(vt), key(vkey), val(vval);
+  const uint32_t hash = nht_hash(ctx, key);
+  const int64_t i = nht_find(ctx, t, key, hash);
+  if (i >= 0) {
+    ctx.setField(val_field(t, NHT_VALUES), i, val);
+    return kUnit;
+  }
+
+  // Grow the table if it is 7/8 full, or only purge deleted slots if
+  // most of them are deleted.
+  nhashtbl *index = nht_index(t);
+  if ((index->used + 1) * 8 > index->capacity * 7) {
+    const size_t capacity = index->size * 2 >= index->capacity
+        ? index->capacity * 2
+        : index->capacity;
+    nht_resize(ctx, t, capacity);
+    index = nht_index(t);
+  }
+
+  const size_t j = nht_find_free(index, hash);
+  if (index->ctrl[j] == kCtrlEmpty) {
+    index->used++;
+  }
+  index->size++;
+  nht_set_ctrl(index, j, nht_ctrl(hash));
+  index->hashes[j] = hash;
+  ctx.setField(val_field(t, NHT_KEYS), j, key);
+  ctx.setField(val_field(t, NHT_VALUES), j, val);
+  return kUnit;
+}
+
+extern "C" value caml_nhashtbl_find_opt(
+    Context &ctx,
+    value vt,
+    value key)
+{
+  Value t(vt);
+  const int64_t i = nht_find(ctx, t, key, nht_hash(ctx, key));
+  if (i < 0) {
+    return val_int64(0);
+  }
+  value some = ctx.allocBlock(1, 0);
+  val_field(some, 0) = val_field(val_field(t, NHT_VALUES), i);
+  return some;
+}
+
+extern "C" value caml_nhashtbl_mem(
+    Context &ctx,
+    value t,
+    value key)
+{
+  return val_int64(nht_find(ctx, t, key, nht_hash(ctx, key)) >= 0);
+}
+
+extern "C" value caml_nhashtbl_remove(
+    Context &ctx,
+    value t,
+    value key)
+{
+  const int64_t i = nht_find(ctx, t, key, nht_hash(ctx, key));
+  if (i >= 0) {
+    // The slot stays used, so probes do not stop at it, until the table
+    // is rebuilt.
+    nhashtbl *index = nht_index(t);
+    nht_set_ctrl(index, i, kCtrlDeleted);
+    index->size--;
+    ctx.setField(val_field(t, NHT_KEYS), i, val_int64(0));
+    ctx.setField(val_field(t, NHT_VALUES), i, val_int64(0));
+  }
+  return kUnit;
+}
+
+extern "C" value caml_nhashtbl_length(
+    Context &,
+    value t)
+{
+  return val_int64(nht_index(t)->size);
+}
+
+extern "C" value caml_nhashtbl_clear(
+    Context &ctx,
+    value t)
+{
+  nhashtbl *index = nht_index(t);
+  memset(index->ctrl, kCtrlEmpty, index->capacity + kGroupSize);
+  index->size = 0;
+  index->used = 0;
+  const value keys = val_field(t, NHT_KEYS);
+  const value vals = val_field(t, NHT_VALUES);
+  for (size_t i = 0; i < index->capacity; ++i) {
+    ctx.setField(keys, i, val_int64(0));
+    ctx.setField(vals, i, val_int64(0));
+  }
+  return kUnit;
+}
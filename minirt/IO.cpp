@@ -2,9 +2,15 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <vector>
+
 #include <unistd.h>
 
 #include "miniml/Context.h"
+#include "minirt/Runtime.h"
 using namespace miniml;
 
 
@@ -12,10 +18,6 @@ using namespace miniml;
 // -----------------------------------------------------------------------------
 // channel
 // -----------------------------------------------------------------------------
-struct channel {
-  int fd;
-};
-
 void channel_finalize(Context &, value) {
 }
 
@@ -31,6 +33,29 @@ CustomOperations channel_ops {
   nullptr,
 };
 
+void channel_writev(int fd, struct iovec *iov, size_t count) {
+  while (count > 0) {
+    const int n = count < IOV_MAX ? count : IOV_MAX;
+    ssize_t written = writev(fd, iov, n);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("output: ") + strerror(errno));
+    }
+    // Skip the buffers written, adjusting the one written partially.
+    while (count > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
 
 
 // -----------------------------------------------------------------------------
@@ -58,6 +83,20 @@ extern "C" value caml_ml_open_descriptor_out(
 
 
 
+extern "C" value caml_ml_close_channel(
+    Context &,
+    value vchannel)
+{
+  auto chan = val_to_custom<channel>(vchannel);
+  if (chan->fd >= 0) {
+    close(chan->fd);
+    chan->fd = -1;
+  }
+  return kUnit;
+}
+
+
+
 extern "C" value caml_register_named_value(
     Context &,
     value vname,
@@ -76,15 +115,30 @@ extern "C" value caml_ml_output(
     value start,
     value length)
 {
-  (void) start;
-
   auto chan = val_to_custom<channel>(vchannel);
-  auto len = val_to_int64(length);
-  auto *buf = val_to_string(buff);
+  struct iovec iov;
+  iov.iov_base = val_to_string(buff) + val_to_int64(start);
+  iov.iov_len = val_to_int64(length);
+  channel_writev(chan->fd, &iov, 1);
+  return kUnit;
+}
 
-  for (int64_t i = 0; i < len; ++i) {
-    write(chan->fd, &buf[i], 1);
+extern "C" value caml_ml_output_strings(
+    Context &,
+    value vchannel,
+    value strings)
+{
+  // An array of strings is written with a single system call instead of
+  // being concatenated first.
+  auto chan = val_to_custom<channel>(vchannel);
+  std::vector<struct iovec> iov;
+  for (size_t i = 0, n = val_size(strings); i < n; ++i) {
+    const value s = val_field(strings, i);
+    if (const size_t len = val_strlen(s)) {
+      iov.push_back({ val_to_string(s), len });
+    }
   }
+  channel_writev(chan->fd, iov.data(), iov.size());
   return kUnit;
 }
 
@@ -111,8 +165,9 @@ extern "C" value caml_ml_out_channels_list(
     Context &ctx,
     value)
 {
+  Value chan = caml_ml_open_descriptor_in(ctx, val_int64(0));
   value result = ctx.allocBlock(2, 0);
-  val_field(result, 0) = caml_ml_open_descriptor_in(ctx, val_int64(0));
+  val_field(result, 0) = chan;
   val_field(result, 1) = kUnit;
   return result;
 }
@@ -2,6 +2,11 @@
 // Licensing information can be found in the LICENSE file.
 // (C) Nandor Licker. All rights reserved.
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 #include "miniml/Context.h"
 using namespace miniml;
 
@@ -10,12 +15,14 @@ using namespace miniml;
 // -----------------------------------------------------------------------------
 // int32
 // -----------------------------------------------------------------------------
-value int32_deserialize(Context &, StreamReader &);
+int      int32_compare(Context &, value, value);
+value    int32_deserialize(Context &, StreamReader &);
+uint64_t int32_hash(Context &, value, value);
 CustomOperations int32_ops = {
   "_i",
   nullptr,
-  nullptr,
-  nullptr,
+  int32_compare,
+  int32_hash,
   nullptr,
   int32_deserialize,
   nullptr,
@@ -28,18 +35,30 @@ value int32_deserialize(Context &ctx, StreamReader &stream) {
   return c;
 }
 
+int int32_compare(Context &, value v1, value v2) {
+  const int32_t i1 = *val_to_custom<int32_t>(v1);
+  const int32_t i2 = *val_to_custom<int32_t>(v2);
+  return (i1 > i2) - (i1 < i2);
+}
+
+uint64_t int32_hash(Context &, value val, value) {
+  return static_cast<uint32_t>(*val_to_custom<int32_t>(val));
+}
+
 
 
 // -----------------------------------------------------------------------------
 // int64
 // -----------------------------------------------------------------------------
-value int64_deserialize(Context &, StreamReader &);
-void  int64_print(Context &, value, std::ostream &);
+int      int64_compare(Context &, value, value);
+value    int64_deserialize(Context &, StreamReader &);
+void     int64_print(Context &, value, std::ostream &);
+uint64_t int64_hash(Context &, value, value);
 CustomOperations int64_ops = {
   "_j",
   nullptr,
-  nullptr,
-  nullptr,
+  int64_compare,
+  int64_hash,
   nullptr,
   int64_deserialize,
   int64_print,
@@ -52,10 +71,22 @@ value int64_deserialize(Context &ctx, StreamReader &stream) {
   return c;
 }
 
+int int64_compare(Context &, value v1, value v2) {
+  const int64_t i1 = *val_to_custom<int64_t>(v1);
+  const int64_t i2 = *val_to_custom<int64_t>(v2);
+  return (i1 > i2) - (i1 < i2);
+}
+
 void int64_print(Context &, value val, std::ostream &os) {
   os << *val_to_custom<int64_t>(val);
 }
 
+uint64_t int64_hash(Context &, value val, value) {
+  // Both halves are folded into 32 bits.
+  const uint64_t x = *val_to_custom<int64_t>(val);
+  return static_cast<uint32_t>(x ^ (x >> 32));
+}
+
 extern "C" value caml_int64_float_of_bits(
     Context &ctx,
     value vi)
@@ -69,12 +100,13 @@ extern "C" value caml_int64_float_of_bits(
 // -----------------------------------------------------------------------------
 // nativeint
 // -----------------------------------------------------------------------------
-value nativeint_deserialize(Context &, StreamReader &);
+value    nativeint_deserialize(Context &, StreamReader &);
+uint64_t nativeint_hash(Context &, value, value);
 CustomOperations nativeint_ops = {
   "_n",
   nullptr,
-  nullptr,
-  nullptr,
+  int64_compare,
+  nativeint_hash,
   nullptr,
   nativeint_deserialize,
   nullptr,
@@ -84,8 +116,9 @@ CustomOperations nativeint_ops = {
 value nativeint_deserialize(Context &ctx, StreamReader &stream) {
   switch (stream.getUInt8()) {
   case 1: {
-    auto c = ctx.allocCustom(&nativeint_ops, sizeof(int32_t));
-    *val_to_custom<int32_t>(c) = stream.getInt32be();
+    // Values from 32-bit hosts are widened to the native size.
+    auto c = ctx.allocCustom(&nativeint_ops, sizeof(int64_t));
+    *val_to_custom<int64_t>(c) = stream.getInt32be();
     return c;
   }
   case 2: {
@@ -99,6 +132,12 @@ value nativeint_deserialize(Context &ctx, StreamReader &stream) {
   }
 }
 
+uint64_t nativeint_hash(Context &, value val, value) {
+  // Small values hash as they would on a 32-bit host.
+  const int64_t n = *val_to_custom<int64_t>(val);
+  return static_cast<uint32_t>((n >> 32) ^ (n >> 63) ^ n);
+}
+
 extern "C" value caml_nativeint_shift_left(
     Context &,
     value v1,
@@ -118,17 +157,57 @@ extern "C" value caml_nativeint_sub(
 // -----------------------------------------------------------------------------
 // Numeric stuff
 // -----------------------------------------------------------------------------
+static value format_unsigned(
+    Context &ctx,
+    uint64_t n,
+    unsigned base,
+    const char *digits)
+{
+  // Digits are written right to left into a buffer large enough for the
+  // octal representation of 64-bit numbers.
+  char buf[24];
+  char *end = buf + sizeof(buf), *p = end;
+  do {
+    *--p = digits[n % base];
+    n /= base;
+  } while (n);
+  return ctx.allocString(p, end - p);
+}
+
+static value format_decimal(Context &ctx, int64_t i) {
+  char buf[24];
+  char *end = buf + sizeof(buf), *p = end;
+  uint64_t n = i < 0 ? -static_cast<uint64_t>(i) : i;
+  do {
+    *--p = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  if (i < 0) {
+    *--p = '-';
+  }
+  return ctx.allocString(p, end - p);
+}
+
 extern "C" value caml_format_float(
     Context &ctx,
     value fmt,
     value arg)
 {
-  // TODO: improve this.
-  char *str = nullptr;
-  asprintf(&str, val_to_string(fmt), val_to_double(arg));
-  value v = ctx.allocString(str, strlen(str));
-  free(str);
-  return v;
+  // The output of most formats fits into the buffer. Fixed-point formats
+  // of large numbers are formatted again into a buffer of the right size.
+  const char *f = val_to_string(fmt);
+  const double d = val_to_double(arg);
+  char buf[64];
+  const int n = snprintf(buf, sizeof(buf), f, d);
+  if (n < 0) {
+    throw std::runtime_error("format_float: invalid format");
+  }
+  if (static_cast<size_t>(n) < sizeof(buf)) {
+    return ctx.allocString(buf, n);
+  }
+  std::vector<char> big(n + 1);
+  snprintf(big.data(), big.size(), f, d);
+  return ctx.allocString(big.data(), n);
 }
 
 extern "C" value caml_format_int(
@@ -136,12 +215,181 @@ extern "C" value caml_format_int(
     value fmt,
     value arg)
 {
-  // TODO: improve this.
-  char *str = nullptr;
-  asprintf(&str, val_to_string(fmt), val_to_int64(arg));
-  value v = ctx.allocString(str, strlen(str));
-  free(str);
-  return v;
+  // Plain conversions are formatted directly. Unsigned conversions print
+  // the 63-bit representation of integers, as OCaml does.
+  const char *f = val_to_string(fmt);
+  if (f[0] == '%' && f[1] && !f[2]) {
+    const uint64_t u = static_cast<uint64_t>(arg) >> 1;
+    switch (f[1]) {
+      case 'd': case 'i': {
+        return format_decimal(ctx, val_to_int64(arg));
+      }
+      case 'u': return format_unsigned(ctx, u, 10, "0123456789");
+      case 'x': return format_unsigned(ctx, u, 16, "0123456789abcdef");
+      case 'X': return format_unsigned(ctx, u, 16, "0123456789ABCDEF");
+      case 'o': return format_unsigned(ctx, u, 8, "01234567");
+      default: break;
+    }
+  }
+
+  // Formats with flags or widths go through snprintf, after adding the
+  // length modifier for 64-bit arguments before the conversion.
+  const size_t len = val_strlen(fmt);
+  if (len == 0 || len > 32) {
+    throw std::runtime_error("format_int: invalid format");
+  }
+  char spec[36];
+  memcpy(spec, f, len - 1);
+  spec[len - 1] = 'l';
+  spec[len] = f[len - 1];
+  spec[len + 1] = '\0';
+
+  long n;
+  switch (f[len - 1]) {
+    case 'u': case 'x': case 'X': case 'o': {
+      n = static_cast<long>(static_cast<uint64_t>(arg) >> 1);
+      break;
+    }
+    default: {
+      n = val_to_int64(arg);
+      break;
+    }
+  }
+  char buf[128];
+  const int r = snprintf(buf, sizeof(buf), spec, n);
+  if (r < 0 || static_cast<size_t>(r) >= sizeof(buf)) {
+    throw std::runtime_error("format_int: invalid format");
+  }
+  return ctx.allocString(buf, r);
+}
+
+extern "C" value caml_int_of_string(
+    Context &,
+    value str)
+{
+  // Accepts an optional sign, a 0x, 0o, 0b or 0u prefix and underscores
+  // between digits. Decimal numbers must fit into 63 bits, others wrap
+  // around if they fit into 63 bits as unsigned numbers.
+  const char *p = val_to_string(str);
+  const char *end = p + val_strlen(str);
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    neg = *p++ == '-';
+  }
+  unsigned base = 10;
+  bool isSigned = true;
+  if (end - p >= 2 && p[0] == '0') {
+    switch (p[1]) {
+      case 'x': case 'X': base = 16; isSigned = false; p += 2; break;
+      case 'o': case 'O': base = 8;  isSigned = false; p += 2; break;
+      case 'b': case 'B': base = 2;  isSigned = false; p += 2; break;
+      case 'u': case 'U': base = 10; isSigned = false; p += 2; break;
+      default: break;
+    }
+  }
+  if (p == end || *p == '_') {
+    throw std::runtime_error("int_of_string");
+  }
+
+  const uint64_t limit = isSigned ? (1ull << 62) : (1ull << 63) - 1;
+  uint64_t n = 0;
+  for (; p < end; ++p) {
+    const char c = *p;
+    unsigned d;
+    if (c >= '0' && c <= '9') {
+      d = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      d = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      d = c - 'A' + 10;
+    } else if (c == '_') {
+      continue;
+    } else {
+      throw std::runtime_error("int_of_string");
+    }
+    if (d >= base || n > (limit - d) / base) {
+      throw std::runtime_error("int_of_string");
+    }
+    n = n * base + d;
+  }
+  if (isSigned && !neg && n == limit) {
+    throw std::runtime_error("int_of_string");
+  }
+  const int64_t i = static_cast<int64_t>(n << 1) >> 1;
+  return val_int64(neg ? -i : i);
+}
+
+extern "C" value caml_float_of_string(
+    Context &ctx,
+    value str)
+{
+  const char *s = val_to_string(str);
+  const size_t len = val_strlen(str);
+
+  // Short decimal numbers whose digits fit into 53 bits, scaled by an
+  // exactly representable power of ten, are converted with a single
+  // rounding: the result is correctly rounded without strtod.
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  {
+    const char *p = s, *end = s + len;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      neg = *p++ == '-';
+    }
+    uint64_t mant = 0;
+    int digits = 0, scale = 0;
+    bool dot = false, valid = p < end;
+    for (; p < end && valid; ++p) {
+      if (*p >= '0' && *p <= '9') {
+        mant = mant * 10 + (*p - '0');
+        scale -= dot;
+        valid = ++digits <= 15;
+      } else if (*p == '.' && !dot) {
+        dot = true;
+      } else if (*p != '_') {
+        break;
+      }
+    }
+    if (valid && p < end && (*p == 'e' || *p == 'E')) {
+      ++p;
+      bool eneg = false;
+      if (p < end && (*p == '-' || *p == '+')) {
+        eneg = *p++ == '-';
+      }
+      int exp = 0;
+      valid = p < end;
+      for (; p < end && valid; ++p) {
+        valid = *p >= '0' && *p <= '9' && exp < 1000;
+        exp = exp * 10 + (*p - '0');
+      }
+      scale += eneg ? -exp : exp;
+    }
+    if (valid && p == end && digits > 0 && scale >= -22 && scale <= 22) {
+      double d = static_cast<double>(mant);
+      d = scale < 0 ? d / kPow10[-scale] : d * kPow10[scale];
+      return ctx.allocDouble(neg ? -d : d);
+    }
+  }
+
+  // Everything else, including hexadecimal floats, infinities and NaN,
+  // goes through strtod once underscores are removed.
+  std::vector<char> buf;
+  buf.reserve(len + 1);
+  for (size_t i = 0; i < len; ++i) {
+    if (s[i] != '_') {
+      buf.push_back(s[i]);
+    }
+  }
+  buf.push_back('\0');
+  char *end;
+  const double d = strtod(buf.data(), &end);
+  if (buf.size() == 1 || end != buf.data() + buf.size() - 1) {
+    throw std::runtime_error("float_of_string");
+  }
+  return ctx.allocDouble(d);
 }
 
 
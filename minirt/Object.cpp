@@ -41,12 +41,13 @@ extern "C" value caml_obj_dup(
   }
 
   uint8_t tag = val_tag(arg);
+  Value varg(arg);
   value ret = ctx.allocBlock(size, tag);
   if (tag >= kNoScanTag) {
-    memcpy(val_ptr(ret), val_ptr(arg), size * sizeof(value));
+    memcpy(val_ptr(ret), varg.ptr(), size * sizeof(value));
   } else {
     for (uint32_t i = 0; i < size; ++i) {
-      val_field(ret, i) = val_field(arg, i);
+      val_field(ret, i) = val_field(varg, i);
     }
   }
   return ret;
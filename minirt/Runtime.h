@@ -4,9 +4,22 @@
 
 #pragma once
 
+#include <sys/uio.h>
+
 #include "miniml/Value.h"
 
 
 extern miniml::CustomOperations int32_ops;
 extern miniml::CustomOperations int64_ops;
 extern miniml::CustomOperations nativeint_ops;
+
+
+/// Channel writing to a file descriptor.
+struct channel {
+  int fd;
+};
+
+extern miniml::CustomOperations channel_ops;
+
+/// Writes a sequence of buffers to a descriptor, retrying partial writes.
+void channel_writev(int fd, struct iovec *iov, size_t count);
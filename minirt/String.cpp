@@ -5,6 +5,7 @@
 #include <cstring>
 
 #include "miniml/Context.h"
+#include "minirt/Runtime.h"
 using namespace miniml;
 
 
@@ -72,3 +73,219 @@ extern "C" value caml_string_compare(
   }
   return val_int64(0);
 }
+
+static size_t string_check(value s, int64_t index, size_t n, const char *fn) {
+  if (index < 0 || static_cast<size_t>(index) + n > val_strlen(s)) {
+    throw std::runtime_error(std::string(fn) + ": index out of bounds");
+  }
+  return index;
+}
+
+/// Finds the last occurrence of a byte among the first n ones.
+static const char *string_rfind(const char *data, char c, size_t n) {
+#if defined(__GLIBC__)
+  return static_cast<const char *>(memrchr(data, c, n));
+#else
+  for (const char *p = data + n; p != data; ) {
+    if (*--p == c) {
+      return p;
+    }
+  }
+  return nullptr;
+#endif
+}
+
+static bool string_equal(value s1, value s2) {
+  if (s1 == s2) {
+    return true;
+  }
+  // Strings of equal length have equal block sizes and zeroed padding,
+  // so the blocks are compared word by word, the last byte holding the
+  // amount of padding.
+  const size_t size = val_size(s1);
+  if (size != val_size(s2)) {
+    return false;
+  }
+  const value *w1 = val_ptr(s1), *w2 = val_ptr(s2);
+  for (size_t i = 0; i < size; ++i) {
+    if (w1[i] != w2[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+extern "C" value caml_string_equal(
+    Context &,
+    value s1,
+    value s2)
+{
+  return val_int64(string_equal(s1, s2));
+}
+
+extern "C" value caml_string_notequal(
+    Context &,
+    value s1,
+    value s2)
+{
+  return val_int64(!string_equal(s1, s2));
+}
+
+extern "C" value caml_bytes_equal(
+    Context &,
+    value s1,
+    value s2)
+{
+  return val_int64(string_equal(s1, s2));
+}
+
+extern "C" value caml_bytes_notequal(
+    Context &,
+    value s1,
+    value s2)
+{
+  return val_int64(!string_equal(s1, s2));
+}
+
+extern "C" value caml_fill_bytes(
+    Context &,
+    value s,
+    value ofs,
+    value len,
+    value c)
+{
+  memset(
+      val_to_string(s) + val_to_int64(ofs),
+      val_to_int64(c),
+      val_to_int64(len)
+  );
+  return kUnit;
+}
+
+extern "C" value caml_bytes_index(
+    Context &,
+    value s,
+    value from,
+    value c)
+{
+  // Returns the index of the first occurrence at or after from, -1 if
+  // there is none. memchr scans a vector of bytes at a time.
+  const char *data = val_to_string(s);
+  const size_t i = string_check(s, val_to_int64(from), 0, "String.index");
+  const void *p = memchr(data + i, val_to_int64(c), val_strlen(s) - i);
+  return val_int64(p ? static_cast<const char *>(p) - data : -1);
+}
+
+extern "C" value caml_bytes_rindex(
+    Context &,
+    value s,
+    value from,
+    value c)
+{
+  // Returns the index of the last occurrence at or before from, -1 if
+  // there is none.
+  const char *data = val_to_string(s);
+  const int64_t i = val_to_int64(from);
+  if (i < -1 || i >= static_cast<int64_t>(val_strlen(s))) {
+    throw std::runtime_error("String.rindex: index out of bounds");
+  }
+  const char *p = string_rfind(data, val_to_int64(c), i + 1);
+  return val_int64(p ? p - data : -1);
+}
+
+extern "C" value caml_string_get16(
+    Context &,
+    value s,
+    value index)
+{
+  const size_t i = string_check(s, val_to_int64(index), 2, "String.get16");
+  uint16_t v;
+  memcpy(&v, val_to_string(s) + i, sizeof(v));
+  return val_int64(v);
+}
+
+extern "C" value caml_string_get32(
+    Context &ctx,
+    value s,
+    value index)
+{
+  const size_t i = string_check(s, val_to_int64(index), 4, "String.get32");
+  int32_t v;
+  memcpy(&v, val_to_string(s) + i, sizeof(v));
+  auto c = ctx.allocCustom(&int32_ops, sizeof(int32_t));
+  *val_to_custom<int32_t>(c) = v;
+  return c;
+}
+
+extern "C" value caml_string_get64(
+    Context &ctx,
+    value s,
+    value index)
+{
+  const size_t i = string_check(s, val_to_int64(index), 8, "String.get64");
+  int64_t v;
+  memcpy(&v, val_to_string(s) + i, sizeof(v));
+  auto c = ctx.allocCustom(&int64_ops, sizeof(int64_t));
+  *val_to_custom<int64_t>(c) = v;
+  return c;
+}
+
+extern "C" value caml_bytes_get16(
+    Context &ctx,
+    value s,
+    value index)
+{
+  return caml_string_get16(ctx, s, index);
+}
+
+extern "C" value caml_bytes_get32(
+    Context &ctx,
+    value s,
+    value index)
+{
+  return caml_string_get32(ctx, s, index);
+}
+
+extern "C" value caml_bytes_get64(
+    Context &ctx,
+    value s,
+    value index)
+{
+  return caml_string_get64(ctx, s, index);
+}
+
+extern "C" value caml_bytes_set16(
+    Context &,
+    value s,
+    value index,
+    value v)
+{
+  const size_t i = string_check(s, val_to_int64(index), 2, "Bytes.set16");
+  const uint16_t x = val_to_int64(v);
+  memcpy(val_to_string(s) + i, &x, sizeof(x));
+  return kUnit;
+}
+
+extern "C" value caml_bytes_set32(
+    Context &,
+    value s,
+    value index,
+    value v)
+{
+  const size_t i = string_check(s, val_to_int64(index), 4, "Bytes.set32");
+  const int32_t x = *val_to_custom<int32_t>(v);
+  memcpy(val_to_string(s) + i, &x, sizeof(x));
+  return kUnit;
+}
+
+extern "C" value caml_bytes_set64(
+    Context &,
+    value s,
+    value index,
+    value v)
+{
+  const size_t i = string_check(s, val_to_int64(index), 8, "Bytes.set64");
+  const int64_t x = *val_to_custom<int64_t>(v);
+  memcpy(val_to_string(s) + i, &x, sizeof(x));
+  return kUnit;
+}
@@ -14,9 +14,11 @@ extern "C" value caml_sys_get_argv(
     Context &ctx,
     value)
 {
+  Value name = ctx.allocString("miniml", 6);
+  Value args = ctx.allocBlock(0, 0);
   Value ret = ctx.allocBlock(2, 0);
-  ret.setField(0, ctx.allocString("miniml", 6));
-  ret.setField(1, ctx.allocBlock(0, 0));
+  ret.setField(0, name);
+  ret.setField(1, args);
   return ret;
 }
 
@@ -24,8 +26,9 @@ extern "C" value caml_sys_get_config(
     Context &ctx,
     value)
 {
+  Value os = ctx.allocString("OSX", 3);
   Value ret = ctx.allocBlock(3, 0);
-  ret.setField(0, ctx.allocString("OSX", 3));
+  ret.setField(0, os);
   ret.setField(1, ctx.allocInt64(8 * sizeof(value)));
   ret.setField(2, kFalse);
   return ret;
@@ -0,0 +1,267 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include "miniml/Context.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static size_t ephe_index(value ar, int64_t index, const char *fn) {
+  if (index < 0 || kEpheFirstKey + index >= val_size(ar)) {
+    throw std::runtime_error(std::string(fn) + ": index out of bounds");
+  }
+  return kEpheFirstKey + index;
+}
+
+static size_t ephe_key(value ar, value n, const char *fn) {
+  return ephe_index(ar, val_to_int64(n), fn);
+}
+
+static value ephe_get(Context &ctx, value ar, size_t field) {
+  Value elem = val_field(ar, field);
+  if (elem == kEpheNone) {
+    return val_int64(0);
+  }
+  value some = ctx.allocBlock(1, 0);
+  val_field(some, 0) = elem;
+  return some;
+}
+
+static value ephe_get_copy(Context &ctx, value ar, size_t field) {
+  Value elem = val_field(ar, field);
+  if (elem == kEpheNone) {
+    return val_int64(0);
+  }
+  if (elem.isBlock() && elem.size() > 0 &&
+      elem.tag() != kInfixTag && elem.tag() != kCustomTag) {
+    // Shallow copy, so the original does not escape the ephemeron. Custom
+    // blocks own their finalized resources and are returned shared.
+    Value copy = ctx.allocBlock(elem.size(), elem.tag());
+    memcpy(copy.ptr(), elem.ptr(), elem.size() * sizeof(value));
+    elem = copy;
+  }
+  value some = ctx.allocBlock(1, 0);
+  val_field(some, 0) = elem;
+  return some;
+}
+
+static void ephe_blit(
+    Context &ctx,
+    value ar1,
+    size_t of1,
+    value ar2,
+    size_t of2,
+    size_t len)
+{
+  if (of1 < of2) {
+    for (size_t i = len; i > 0; --i) {
+      ctx.setEphemeronField(ar2, of2 + i - 1, val_field(ar1, of1 + i - 1));
+    }
+  } else {
+    for (size_t i = 0; i < len; ++i) {
+      ctx.setEphemeronField(ar2, of2 + i, val_field(ar1, of1 + i));
+    }
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Ephemeron keys
+// -----------------------------------------------------------------------------
+extern "C" value caml_ephe_create(
+    Context &ctx,
+    value len)
+{
+  if (val_to_int64(len) < 0) {
+    throw std::runtime_error("Ephemeron.create: negative length");
+  }
+  return ctx.allocEphemeron(val_to_int64(len));
+}
+
+extern "C" value caml_ephe_set_key(
+    Context &ctx,
+    value ar,
+    value n,
+    value el)
+{
+  ctx.setEphemeronField(ar, ephe_key(ar, n, "Ephemeron.set_key"), el);
+  return kUnit;
+}
+
+extern "C" value caml_ephe_unset_key(
+    Context &,
+    value ar,
+    value n)
+{
+  val_field(ar, ephe_key(ar, n, "Ephemeron.unset_key")) = kEpheNone;
+  return kUnit;
+}
+
+extern "C" value caml_ephe_get_key(
+    Context &ctx,
+    value ar,
+    value n)
+{
+  return ephe_get(ctx, ar, ephe_key(ar, n, "Ephemeron.get_key"));
+}
+
+extern "C" value caml_ephe_get_key_copy(
+    Context &ctx,
+    value ar,
+    value n)
+{
+  return ephe_get_copy(ctx, ar, ephe_key(ar, n, "Ephemeron.get_key_copy"));
+}
+
+extern "C" value caml_ephe_check_key(
+    Context &,
+    value ar,
+    value n)
+{
+  const size_t key = ephe_key(ar, n, "Ephemeron.check_key");
+  return val_int64(val_field(ar, key) != kEpheNone);
+}
+
+extern "C" value caml_ephe_blit_key(
+    Context &ctx,
+    value ar1,
+    value of1,
+    value ar2,
+    value of2,
+    value len)
+{
+  const int64_t n = val_to_int64(len);
+  if (n < 0) {
+    throw std::runtime_error("Ephemeron.blit_key: negative length");
+  }
+  if (n > 0) {
+    const int64_t i1 = val_to_int64(of1), i2 = val_to_int64(of2);
+    ephe_index(ar1, i1 + n - 1, "Ephemeron.blit_key");
+    ephe_index(ar2, i2 + n - 1, "Ephemeron.blit_key");
+    ephe_blit(
+        ctx,
+        ar1, ephe_index(ar1, i1, "Ephemeron.blit_key"),
+        ar2, ephe_index(ar2, i2, "Ephemeron.blit_key"),
+        n);
+  }
+  return kUnit;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Ephemeron data
+// -----------------------------------------------------------------------------
+extern "C" value caml_ephe_set_data(
+    Context &ctx,
+    value ar,
+    value el)
+{
+  ctx.setEphemeronField(ar, kEpheData, el);
+  return kUnit;
+}
+
+extern "C" value caml_ephe_unset_data(
+    Context &,
+    value ar)
+{
+  val_field(ar, kEpheData) = kEpheNone;
+  return kUnit;
+}
+
+extern "C" value caml_ephe_get_data(
+    Context &ctx,
+    value ar)
+{
+  return ephe_get(ctx, ar, kEpheData);
+}
+
+extern "C" value caml_ephe_get_data_copy(
+    Context &ctx,
+    value ar)
+{
+  return ephe_get_copy(ctx, ar, kEpheData);
+}
+
+extern "C" value caml_ephe_check_data(
+    Context &,
+    value ar)
+{
+  return val_int64(val_field(ar, kEpheData) != kEpheNone);
+}
+
+extern "C" value caml_ephe_blit_data(
+    Context &ctx,
+    value ar1,
+    value ar2)
+{
+  ctx.setEphemeronField(ar2, kEpheData, val_field(ar1, kEpheData));
+  return kUnit;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Weak arrays
+// -----------------------------------------------------------------------------
+extern "C" value caml_weak_create(
+    Context &ctx,
+    value len)
+{
+  return caml_ephe_create(ctx, len);
+}
+
+extern "C" value caml_weak_set(
+    Context &ctx,
+    value ar,
+    value n,
+    value el)
+{
+  const size_t key = ephe_key(ar, n, "Weak.set");
+  if (val_is_block(el)) {
+    ctx.setEphemeronField(ar, key, val_field(el, 0));
+  } else {
+    val_field(ar, key) = kEpheNone;
+  }
+  return kUnit;
+}
+
+extern "C" value caml_weak_get(
+    Context &ctx,
+    value ar,
+    value n)
+{
+  return ephe_get(ctx, ar, ephe_key(ar, n, "Weak.get"));
+}
+
+extern "C" value caml_weak_get_copy(
+    Context &ctx,
+    value ar,
+    value n)
+{
+  return ephe_get_copy(ctx, ar, ephe_key(ar, n, "Weak.get_copy"));
+}
+
+extern "C" value caml_weak_check(
+    Context &ctx,
+    value ar,
+    value n)
+{
+  return caml_ephe_check_key(ctx, ar, n);
+}
+
+extern "C" value caml_weak_blit(
+    Context &ctx,
+    value ar1,
+    value of1,
+    value ar2,
+    value of2,
+    value len)
+{
+  return caml_ephe_blit_key(ctx, ar1, of1, ar2, of2, len);
+}
@@ -0,0 +1,88 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+
+
+/// Bytecode file with a program built by a test, removed when destroyed.
+class TestBytecode {
+ public:
+  /// Writes the code and primitive names, with unit as the global data.
+  TestBytecode(
+      const std::vector<int32_t> &code,
+      const std::vector<std::string> &prims)
+  {
+    char path[] = "/tmp/miniml_testXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot create test bytecode.");
+    }
+    close(fd);
+    path_ = path;
+
+    std::vector<uint8_t> codeData;
+    for (int32_t word : code) {
+      for (unsigned shift = 0; shift < 32; shift += 8) {
+        codeData.push_back(static_cast<uint32_t>(word) >> shift);
+      }
+    }
+    std::vector<uint8_t> data;
+    for (uint32_t word : { 0x8495A6BEu, 1u, 0u, 0u, 0u }) {
+      putUInt32be(data, word);
+    }
+    data.push_back(0x40);
+    std::vector<uint8_t> primData;
+    for (const auto &prim : prims) {
+      primData.insert(primData.end(), prim.begin(), prim.end());
+      primData.push_back(0);
+    }
+
+    std::vector<uint8_t> file;
+    std::vector<uint8_t> headers;
+    auto addSection = [&](const char *name, const std::vector<uint8_t> &s) {
+      file.insert(file.end(), s.begin(), s.end());
+      headers.insert(headers.end(), name, name + 4);
+      putUInt32be(headers, s.size());
+    };
+    addSection("CODE", codeData);
+    addSection("DATA", data);
+    addSection("PRIM", primData);
+    file.insert(file.end(), headers.begin(), headers.end());
+    putUInt32be(file, 3);
+    const std::string magic = "Caml1999X011";
+    file.insert(file.end(), magic.begin(), magic.end());
+
+    std::ofstream os(path_, std::ios::binary);
+    os.write(reinterpret_cast<const char *>(file.data()), file.size());
+    if (!os) {
+      throw std::runtime_error("Cannot write test bytecode.");
+    }
+  }
+
+  ~TestBytecode() { unlink(path_.c_str()); }
+
+  /// Returns the path to the file.
+  const std::string &getPath() const { return path_; }
+
+ private:
+  static void putUInt32be(std::vector<uint8_t> &buffer, uint32_t n) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      buffer.push_back(n >> shift);
+    }
+  }
+
+ private:
+  /// Path to the file.
+  std::string path_;
+};
@@ -0,0 +1,107 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+
+/// Builds a value in the format read by getValue.
+class Marshaller {
+ public:
+  Marshaller &block(uint8_t tag, uint32_t size) {
+    putUInt8(0x08);
+    putUInt32be((size << 10) | tag);
+    ++objects_;
+    return *this;
+  }
+
+  Marshaller &string(const std::string &str) {
+    putUInt8(0x09);
+    putUInt8(str.size());
+    data_.insert(data_.end(), str.begin(), str.end());
+    ++objects_;
+    return *this;
+  }
+
+  Marshaller &integer(int32_t n) {
+    putUInt8(0x02);
+    putUInt32be(n);
+    return *this;
+  }
+
+  /// Appends the value, with its header, to a buffer.
+  void write(std::vector<uint8_t> &buffer) const {
+    putUInt32be(buffer, 0x8495A6BE);
+    putUInt32be(buffer, data_.size());
+    putUInt32be(buffer, objects_);
+    putUInt32be(buffer, 0);
+    putUInt32be(buffer, 0);
+    buffer.insert(buffer.end(), data_.begin(), data_.end());
+  }
+
+  /// Appends a big-endian integer to a buffer.
+  static void putUInt32be(std::vector<uint8_t> &buffer, uint32_t n) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      buffer.push_back(n >> shift);
+    }
+  }
+
+ private:
+  void putUInt8(uint8_t n) { data_.push_back(n); }
+  void putUInt32be(uint32_t n) { putUInt32be(data_, n); }
+
+ private:
+  /// Marshalled data.
+  std::vector<uint8_t> data_;
+  /// Number of blocks and strings.
+  uint32_t objects_ = 0;
+};
+
+/// Description of a debug event.
+struct TestEvent {
+  /// Byte offset of the event in the unit.
+  int32_t pos;
+  /// Name of the definition, null to omit the field.
+  const char *def;
+  /// Line of the event.
+  int32_t line;
+};
+
+/// Builds a DBUG section with a single unit of module Foo, starting at PC 0.
+inline std::vector<uint8_t> makeDebugSection(
+    const std::vector<TestEvent> &events)
+{
+  Marshaller list;
+  for (const auto &event : events) {
+    list.block(0, 2);
+    list.block(0, event.def ? 5 : 4);
+    list.integer(event.pos);
+    list.string("Foo");
+    list.block(0, 3);
+    for (unsigned i = 0; i < 2; ++i) {
+      list.block(0, 4).string("foo.ml").integer(event.line);
+      list.integer(100).integer(104 + i);
+    }
+    list.integer(0);
+    list.integer(0);
+    if (event.def) {
+      list.string(event.def);
+    }
+  }
+  list.integer(0);
+
+  Marshaller dirs;
+  dirs.integer(0);
+
+  std::vector<uint8_t> data;
+  Marshaller::putUInt32be(data, 1);
+  Marshaller::putUInt32be(data, 0);
+  list.write(data);
+  dirs.write(data);
+  return data;
+}
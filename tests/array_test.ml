@@ -178,4 +178,74 @@ let () =
   assert (not (Array.memq 1.0 f));
 ;;
 
+external append_prim : 'a array -> 'a array -> 'a array = "caml_array_append"
+
+(* Float arrays stay unboxed through sub, append, concat and blit. *)
+let () =
+  let f = [| 1.5; 2.5; 3.5; 4.5 |] in
+  let e : float array = [||] in
+  assert (Array.sub f 1 2 = [| 2.5; 3.5 |]);
+  assert (Array.sub f 4 0 = [||]);
+  assert (append_prim f e = f);
+  assert (append_prim e f = f);
+  assert (append_prim e e = [||]);
+  assert ((append_prim e f).(3) = 4.5);
+  assert (Array.append f f = [| 1.5; 2.5; 3.5; 4.5; 1.5; 2.5; 3.5; 4.5 |]);
+  assert (Array.concat [e; f; e; [| 5.5 |]; e] = [| 1.5; 2.5; 3.5; 4.5; 5.5 |]);
+  assert ((Array.concat [e; [| 0.25 |]]).(0) = 0.25);
+  assert (Array.concat [e; e] = [||]);
+  assert (Array.concat [] = [||]);
+  let g = Array.copy f in
+  Array.blit g 0 g 1 3;
+  assert (g = [| 1.5; 1.5; 2.5; 3.5 |]);
+  let g = Array.copy f in
+  Array.blit g 1 g 0 3;
+  assert (g = [| 2.5; 3.5; 4.5; 4.5 |]);
+  Array.fill g 1 2 0.0;
+  assert (g = [| 2.5; 0.0; 0.0; 4.5 |]);
+;;
+
+(* Boxed arrays, including overlapping blits in both directions. *)
+let () =
+  let a = Array.init 10 (fun i -> string_of_int i) in
+  let e : string array = [||] in
+  assert (append_prim a e = a && append_prim e a = a);
+  assert (Array.concat [e; [| "x" |]; e; [| "y"; "z" |]] = [| "x"; "y"; "z" |]);
+  assert (Array.sub a 8 2 = [| "8"; "9" |]);
+  let b = Array.copy a in
+  Array.blit b 0 b 3 7;
+  assert (b = [| "0"; "1"; "2"; "0"; "1"; "2"; "3"; "4"; "5"; "6" |]);
+  let b = Array.copy a in
+  Array.blit b 3 b 0 7;
+  assert (b = [| "3"; "4"; "5"; "6"; "7"; "8"; "9"; "7"; "8"; "9" |]);
+;;
+
+(* Young values written in bulk into major arrays survive minor GCs. *)
+let () =
+  let big = Array.make 1000 [] in
+  let check n =
+    Array.iteri (fun i l -> assert (l = [i + n])) big
+  in
+  for round = 0 to 9 do
+    let src = Array.init 1000 (fun i -> [i + round]) in
+    Array.blit src 0 big 0 1000;
+    Gc.minor ();
+    check round
+  done;
+  for round = 0 to 99 do
+    Array.fill big 0 1000 [round];
+    Array.blit (Array.init 600 (fun i -> [i + round])) 0 big 0 600
+  done;
+  Gc.minor ();
+  Array.iteri (fun i l -> assert (l = [if i < 600 then i + 99 else 99])) big;
+  let young = Array.init 300 (fun i -> ref i) in
+  let joined = Array.append young young in
+  let sub = Array.sub joined 100 400 in
+  let cat = Array.concat [young; sub; young] in
+  Gc.minor ();
+  Gc.full_major ();
+  assert (!(joined.(599)) = 299 && !(sub.(0)) = 100 && !(sub.(399)) = 199);
+  assert (Array.length cat = 1000 && !(cat.(300)) = 100 && !(cat.(999)) = 299);
+;;
+
 let () = print_endline "OK"
@@ -0,0 +1,22 @@
+exception Error of int
+
+let rec fail n =
+  if n = 0 then raise (Error 0) else 1 + fail (n - 1)
+
+let _ =
+  Printexc.record_backtrace true;
+  try
+    ignore (fail 3)
+  with Error _ ->
+    assert (Printexc.backtrace_status ());
+    let bt = Printexc.get_raw_backtrace () in
+    assert (Printexc.raw_backtrace_length bt >= 4);
+    Printexc.print_raw_backtrace stdout bt;
+    (match Printexc.backtrace_slots bt with
+     | Some slots ->
+       Array.iter (fun slot ->
+           assert (not (Printexc.Slot.is_inline slot));
+           ignore (Printexc.Slot.name slot);
+           ignore (Printexc.Slot.location slot)) slots
+     | None -> ());
+    print_endline "Caught"
@@ -0,0 +1,85 @@
+open Bigarray
+
+let of_list kind l =
+  let a = Array1.create kind c_layout (List.length l) in
+  List.iteri (fun i x -> a.{i} <- x) l;
+  a
+;;
+
+(* Elements of each kind are stored and read back at their width. *)
+let () =
+  let a = of_list int8_signed [-128; -1; 0; 127] in
+  assert (a.{0} = -128 && a.{1} = -1 && a.{3} = 127);
+  let a = of_list int8_unsigned [0; 255] in
+  assert (a.{1} = 255);
+  let a = of_list int16_signed [-32768; 32767] in
+  assert (a.{0} = -32768 && a.{1} = 32767);
+  let a = of_list int16_unsigned [65535] in
+  assert (a.{0} = 65535);
+  let a = of_list int32 [Int32.min_int; Int32.max_int] in
+  assert (a.{0} = Int32.min_int && a.{1} = Int32.max_int);
+  let a = of_list int64 [Int64.min_int; Int64.max_int] in
+  assert (a.{0} = Int64.min_int && a.{1} = Int64.max_int);
+  let a = of_list nativeint [-3n; 7n] in
+  assert (a.{0} = -3n && a.{1} = 7n);
+  let a = of_list int [min_int; max_int] in
+  assert (a.{0} = min_int && a.{1} = max_int);
+  let a = of_list float32 [1.5; -0.25] in
+  assert (a.{0} = 1.5 && a.{1} = -0.25);
+  let a = of_list float64 [0.1; infinity] in
+  assert (a.{0} = 0.1 && a.{1} = infinity);
+  let a = of_list char ['a'; 'z'] in
+  assert (a.{0} = 'a' && a.{1} = 'z');
+  let a = of_list complex64 [{ Complex.re = 1.0; im = -2.0 }] in
+  assert (a.{0} = { Complex.re = 1.0; im = -2.0 });
+  assert (Array1.dim a = 1);
+;;
+
+(* Views share the storage of the array they were taken from. *)
+let () =
+  let m = Array2.create float64 c_layout 3 4 in
+  Array2.fill m 1.5;
+  m.{2, 3} <- 7.0;
+  let row = Array2.slice_left m 2 in
+  assert (Array1.dim row = 4);
+  assert (row.{3} = 7.0 && row.{0} = 1.5);
+  row.{0} <- 2.0;
+  assert (m.{2, 0} = 2.0);
+  let s = Array2.sub_left m 1 2 in
+  assert (Array2.dim1 s = 2 && s.{1, 3} = 7.0);
+  let f = Array2.create int fortran_layout 2 3 in
+  Array2.fill f 0;
+  f.{2, 3} <- 5;
+  let col = Array2.slice_right f 3 in
+  assert (col.{2} = 5 && col.{1} = 0);
+  let v = Array1.create int c_layout 8 in
+  for i = 0 to 7 do v.{i} <- i done;
+  Array1.blit (Array1.sub v 0 4) (Array1.sub v 4 4);
+  assert (v.{4} = 0 && v.{7} = 3);
+  let g = genarray_of_array1 v in
+  assert (Genarray.num_dims g = 1 && Genarray.nth_dim g 0 = 8);
+  let r = reshape_2 g 2 4 in
+  assert (r.{1, 3} = 3);
+;;
+
+(* Arrays are compared by value, element by element. *)
+let () =
+  let ints kind l = of_list kind l in
+  assert (compare (ints int8_signed [-1]) (ints int8_signed [1]) < 0);
+  assert (compare (ints int16_signed [-300]) (ints int16_signed [2]) < 0);
+  assert (compare (ints int [256]) (ints int [1]) > 0);
+  assert (compare (ints int32 [-1l]) (ints int32 [0l]) < 0);
+  assert (compare (ints int64 [-1L; 5L]) (ints int64 [-1L; 4L]) > 0);
+  assert (compare (ints int8_unsigned [255]) (ints int8_unsigned [1]) > 0);
+  assert (ints int [1; 2; 3] = ints int [1; 2; 3]);
+  let floats l = of_list float64 l in
+  assert (compare (floats [-0.0]) (floats [0.0]) = 0);
+  assert (compare (floats [nan]) (floats [nan]) = 0);
+  assert (compare (floats [nan]) (floats [neg_infinity]) < 0);
+  assert (compare (floats [1.0]) (floats [nan]) > 0);
+  assert (compare (floats [-2.0]) (floats [-1.0]) < 0);
+  assert (compare (of_list float32 [nan]) (of_list float32 [0.0]) < 0);
+  assert (compare (floats [1.0; 2.0]) (floats [1.0]) > 0);
+;;
+
+let () = print_endline "OK";;
@@ -0,0 +1,105 @@
+type buffer
+
+external create : int -> buffer = "caml_buffer_create"
+external length : buffer -> int = "caml_buffer_length"
+external add_char : buffer -> char -> unit = "caml_buffer_add_char"
+external add_string : buffer -> string -> unit = "caml_buffer_add_string"
+external add_substring : buffer -> string -> int -> int -> unit
+  = "caml_buffer_add_substring"
+external add_int : buffer -> int -> unit = "caml_buffer_add_int"
+external add_buffer : buffer -> buffer -> unit = "caml_buffer_add_buffer"
+external contents : buffer -> string = "caml_buffer_contents"
+external sub : buffer -> int -> int -> string = "caml_buffer_sub"
+external nth : buffer -> int -> char = "caml_buffer_nth"
+external clear : buffer -> unit = "caml_buffer_clear"
+external reset : buffer -> unit = "caml_buffer_reset"
+external output_buffer : out_channel -> buffer -> unit = "caml_buffer_output"
+external output : out_channel -> bytes -> int -> int -> unit = "caml_ml_output"
+external output_strings : out_channel -> string array -> unit
+  = "caml_ml_output_strings"
+
+let digits n = String.init n (fun i -> Char.chr (Char.code '0' + i mod 10))
+
+(* Appends spanning chunks are split between them. *)
+let () =
+  let b = create 0 in
+  let s = digits 1000 in
+  let expected = ref "" in
+  for i = 0 to 99 do
+    add_substring b s i (i * 7 mod 300);
+    expected := !expected ^ String.sub s i (i * 7 mod 300)
+  done;
+  assert (length b = String.length !expected);
+  assert (contents b = !expected);
+  assert (sub b 250 600 = String.sub !expected 250 600);
+  assert (nth b 257 = !expected.[257]);
+  add_substring b s 1000 0;
+  add_substring b "" 0 0;
+  assert (length b = String.length !expected);
+  let c = create 4 in
+  add_string c (digits 3);
+  add_char c '!';
+  add_int c min_int;
+  add_int c 0;
+  add_string c (digits 700);
+  assert (contents c = digits 3 ^ "!" ^ "-4611686018427387904" ^ "0" ^ digits 700);
+;;
+
+(* A buffer appended to itself doubles its contents. *)
+let () =
+  let b = create 16 in
+  add_string b "abc";
+  add_buffer b b;
+  assert (contents b = "abcabc");
+  for _ = 1 to 8 do add_buffer b b done;
+  assert (length b = 6 * 256);
+  assert (sub b 1530 6 = "abcabc");
+  let e = create 0 in
+  add_buffer b e;
+  add_buffer e e;
+  assert (length b = 6 * 256 && length e = 0);
+;;
+
+(* Cleared buffers keep a chunk to fill again, reset ones drop all. *)
+let () =
+  let b = create 0 in
+  add_string b (digits 5000);
+  clear b;
+  assert (length b = 0 && contents b = "");
+  add_string b "after clear";
+  add_string b (digits 3000);
+  assert (contents b = "after clear" ^ digits 3000);
+  reset b;
+  assert (length b = 0 && contents b = "");
+  add_string b "after reset";
+  assert (contents b = "after reset");
+  clear b;
+  clear b;
+  reset b;
+  add_char b 'x';
+  assert (contents b = "x");
+;;
+
+(* Writes the ranges and chunks in order, printing the lines below.
+   01234567890123456789
+   hello
+   line 0 ... line 199
+   one two three *)
+let () =
+  let b = create 0 in
+  add_string b (digits 20);
+  add_char b '\n';
+  output_buffer stdout b;
+  output stdout (Bytes.of_string "xxhello\nyy") 2 6;
+  let b = create 0 in
+  for i = 0 to 199 do
+    add_string b "line ";
+    add_int b i;
+    add_char b '\n'
+  done;
+  assert (length b > 1024);
+  output_buffer stdout b;
+  output_strings stdout [| "one"; " "; ""; "two three"; "\n" |];
+;;
+
+let () = print_endline "OK";;
@@ -0,0 +1,118 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "miniml/Context.h"
+#include "miniml/Value.h"
+#include "minirt/Runtime.h"
+using namespace miniml;
+
+extern "C" value caml_ml_open_descriptor_out(Context &, value);
+extern "C" value caml_ml_close_channel(Context &, value);
+extern "C" value caml_ml_output(Context &, value, value, value, value);
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static void expect(bool cond, const std::string &msg) {
+  if (!cond) {
+    throw std::runtime_error(msg);
+  }
+}
+
+static bool isOpen(int fd) {
+  return fcntl(fd, F_GETFD) != -1;
+}
+
+/// Opens a pipe, returning the write end and storing the read end.
+static int openPipe(int *readEnd) {
+  int fds[2];
+  expect(pipe(fds) == 0, "cannot open a pipe");
+  *readEnd = fds[0];
+  return fds[1];
+}
+
+/// Writes a string to a channel.
+static void output(Context &ctx, value chan, const std::string &str) {
+  Value buff = ctx.allocString(str.data(), str.size());
+  caml_ml_output(ctx, chan, buff, val_int64(0), val_int64(str.size()));
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Tests
+// -----------------------------------------------------------------------------
+/// close_out closes the descriptor once, further closes do nothing.
+static void testClose(Context &ctx) {
+  int in;
+  int out = openPipe(&in);
+  Value chan = caml_ml_open_descriptor_out(ctx, val_int64(out));
+  output(ctx, chan, "abc");
+  caml_ml_close_channel(ctx, chan);
+  expect(!isOpen(out), "descriptor is closed");
+  expect(val_to_custom<channel>(chan)->fd == -1, "channel is marked closed");
+
+  // The data written before the close is in the pipe, followed by EOF.
+  char buf[4];
+  expect(read(in, buf, sizeof(buf)) == 3, "data written before the close");
+  expect(std::string(buf, 3) == "abc", "data written before the close");
+  expect(read(in, buf, sizeof(buf)) == 0, "pipe is closed");
+
+  // A descriptor reusing the number is left alone by a second close.
+  int reused = dup(in);
+  expect(reused == out, "descriptor is reused");
+  caml_ml_close_channel(ctx, chan);
+  expect(isOpen(reused), "second close is a no-op");
+  close(reused);
+  close(in);
+}
+
+/// Channels which are not closed explicitly keep their descriptors open
+/// after they are collected, as they may share them with other channels.
+static void testFinalize(Context &ctx) {
+  int in;
+  int out = openPipe(&in);
+  caml_ml_open_descriptor_out(ctx, val_int64(out));
+  caml_ml_open_descriptor_out(ctx, val_int64(out));
+  ctx.minorCollection();
+  ctx.majorCollection();
+  expect(isOpen(out), "descriptor is open after collection");
+
+  {
+    Value chan = caml_ml_open_descriptor_out(ctx, val_int64(out));
+    ctx.minorCollection();
+    ctx.majorCollection();
+  }
+  ctx.majorCollection();
+  expect(isOpen(out), "descriptor is open after a major collection");
+  close(out);
+  close(in);
+}
+
+
+
+// -----------------------------------------------------------------------------
+int main() {
+  try {
+    Context ctx;
+    testClose(ctx);
+    testFinalize(ctx);
+
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+  } catch (std::exception &e) {
+    std::cerr << "[Exception]: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
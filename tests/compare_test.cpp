@@ -0,0 +1,265 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "miniml/Context.h"
+#include "miniml/Value.h"
+#include "minirt/Runtime.h"
+using namespace miniml;
+
+extern "C" value caml_compare(Context &, value, value);
+extern "C" value caml_equal(Context &, value, value);
+extern "C" value caml_notequal(Context &, value, value);
+extern "C" value caml_lessthan(Context &, value, value);
+extern "C" value caml_lessequal(Context &, value, value);
+extern "C" value caml_greaterthan(Context &, value, value);
+extern "C" value caml_greaterequal(Context &, value, value);
+
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/// Number of blocks past which compare_val starts looking for cycles.
+static const size_t kCycleCheckSteps = 1 << 16;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static void expect(bool cond, const std::string &msg) {
+  if (!cond) {
+    throw std::runtime_error(msg);
+  }
+}
+
+static int64_t compare(Context &ctx, value a, value b) {
+  return val_to_int64(caml_compare(ctx, a, b));
+}
+
+static bool equal(Context &ctx, value a, value b) {
+  return val_to_int64(caml_equal(ctx, a, b));
+}
+
+static bool lessThan(Context &ctx, value a, value b) {
+  return val_to_int64(caml_lessthan(ctx, a, b));
+}
+
+/// Builds a list of integers, whose last cell points back to the first if
+/// the list is cyclic.
+static Value makeList(
+    Context &ctx,
+    const std::vector<int64_t> &elems,
+    bool cyclic)
+{
+  Value list = val_int64(0);
+  Value last;
+  for (auto it = elems.rbegin(); it != elems.rend(); ++it) {
+    Value cell = ctx.allocBlock(2, 0);
+    ctx.setField(cell, 0, val_int64(*it));
+    ctx.setField(cell, 1, list);
+    if (it == elems.rbegin()) {
+      last = cell;
+    }
+    list = cell;
+  }
+  if (cyclic) {
+    ctx.setField(last, 1, list);
+  }
+  return list;
+}
+
+static Value makeString(Context &ctx, const std::string &str) {
+  return ctx.allocString(str.data(), str.size());
+}
+
+static Value makeFloatArray(Context &ctx, const std::vector<double> &elems) {
+  Value array = ctx.allocBlock(elems.size(), kDoubleArrayTag);
+  for (size_t i = 0; i < elems.size(); ++i) {
+    val_field(array, i) = dbl_to_val(elems[i]);
+  }
+  return array;
+}
+
+/// Builds a pair of a boxed float and an integer.
+static Value makePair(Context &ctx, double d, int64_t n) {
+  Value pair = ctx.allocBlock(2, 0);
+  Value boxed = ctx.allocDouble(d);
+  ctx.setField(pair, 0, boxed);
+  ctx.setField(pair, 1, val_int64(n));
+  return pair;
+}
+
+template <typename T>
+static Value makeCustom(Context &ctx, CustomOperations *ops, T v) {
+  Value custom = ctx.allocCustom(ops, sizeof(T));
+  *val_to_custom<T>(custom) = v;
+  return custom;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Tests
+// -----------------------------------------------------------------------------
+static void testCycles(Context &ctx) {
+  // Short cycles are unrolled until the step limit, long ones go past it.
+  for (size_t n : { size_t(1), size_t(3), kCycleCheckSteps + 7 }) {
+    const std::string at = " for a cycle of " + std::to_string(n);
+    std::vector<int64_t> ones(n, 1);
+    Value a = makeList(ctx, ones, true);
+    Value b = makeList(ctx, ones, true);
+    expect(compare(ctx, a, b) == 0, "compare of equal cycles" + at);
+    expect(equal(ctx, a, b), "equality of equal cycles" + at);
+    expect(equal(ctx, a, a), "equality of a cycle with itself" + at);
+
+    ones.back() = 2;
+    Value c = makeList(ctx, ones, true);
+    expect(compare(ctx, a, c) < 0, "compare of different cycles" + at);
+    expect(compare(ctx, c, a) > 0, "compare of different cycles" + at);
+    expect(!equal(ctx, a, c), "equality of different cycles" + at);
+  }
+
+  // Cycles of different periods unroll to the same infinite list.
+  Value a = makeList(ctx, { 1 }, true);
+  Value b = makeList(ctx, { 1, 1 }, true);
+  expect(compare(ctx, a, b) == 0, "compare of cycles of different periods");
+
+  // Long lists without cycles are compared up to their last element.
+  for (size_t n : { size_t(100), kCycleCheckSteps * 2 }) {
+    const std::string at = " for a list of " + std::to_string(n);
+    std::vector<int64_t> elems(n, 5);
+    Value a = makeList(ctx, elems, false);
+    Value b = makeList(ctx, elems, false);
+    expect(compare(ctx, a, b) == 0, "compare of equal lists" + at);
+    elems.back() = 4;
+    Value c = makeList(ctx, elems, false);
+    expect(compare(ctx, a, c) > 0, "compare of different lists" + at);
+    elems.push_back(4);
+    Value d = makeList(ctx, elems, false);
+    expect(compare(ctx, c, d) < 0, "compare of a shorter list" + at);
+  }
+}
+
+static void testNaN(Context &ctx) {
+  // compare orders NaN below all other floats, = and < are false.
+  Value nan = ctx.allocDouble(kNaN);
+  Value one = ctx.allocDouble(1.0);
+  expect(compare(ctx, nan, nan) == 0, "compare nan nan");
+  expect(compare(ctx, nan, one) < 0, "compare nan 1.0");
+  expect(compare(ctx, one, nan) > 0, "compare 1.0 nan");
+  expect(!equal(ctx, nan, nan), "nan = nan");
+  expect(val_to_int64(caml_notequal(ctx, nan, nan)), "nan <> nan");
+  expect(!lessThan(ctx, nan, one), "nan < 1.0");
+  expect(!lessThan(ctx, one, nan), "1.0 < nan");
+  expect(!val_to_int64(caml_lessequal(ctx, nan, nan)), "nan <= nan");
+  expect(!val_to_int64(caml_greaterthan(ctx, nan, one)), "nan > 1.0");
+  expect(!val_to_int64(caml_greaterequal(ctx, one, nan)), "1.0 >= nan");
+
+  // The unordered result is propagated out of blocks.
+  Value p = makePair(ctx, kNaN, 1);
+  Value q = makePair(ctx, kNaN, 1);
+  Value r = makePair(ctx, 1.0, 1);
+  expect(compare(ctx, p, q) == 0, "compare (nan, 1) (nan, 1)");
+  expect(!equal(ctx, p, q), "(nan, 1) = (nan, 1)");
+  expect(!equal(ctx, p, p), "p = p with a nan in p");
+  expect(!lessThan(ctx, p, r), "(nan, 1) < (1.0, 1)");
+  expect(compare(ctx, p, r) < 0, "compare (nan, 1) (1.0, 1)");
+}
+
+static void testStrings(Context &ctx) {
+  Value ab = makeString(ctx, "ab");
+  Value abc = makeString(ctx, "abc");
+  Value abd = makeString(ctx, "abd");
+  Value b = makeString(ctx, "b");
+  Value empty = makeString(ctx, "");
+  Value nul = makeString(ctx, std::string("ab\0", 3));
+  expect(compare(ctx, ab, abc) < 0, "compare \"ab\" \"abc\"");
+  expect(compare(ctx, abc, ab) > 0, "compare \"abc\" \"ab\"");
+  expect(compare(ctx, abd, abc) > 0, "compare \"abd\" \"abc\"");
+  expect(compare(ctx, b, abc) > 0, "compare \"b\" \"abc\"");
+  expect(compare(ctx, empty, ab) < 0, "compare \"\" \"ab\"");
+  expect(compare(ctx, nul, ab) > 0, "compare \"ab\\000\" \"ab\"");
+  expect(lessThan(ctx, ab, abc), "\"ab\" < \"abc\"");
+  expect(!equal(ctx, ab, abc), "\"ab\" = \"abc\"");
+  expect(equal(ctx, abc, makeString(ctx, "abc")), "\"abc\" = \"abc\"");
+}
+
+static void testFloatArrays(Context &ctx) {
+  Value a = makeFloatArray(ctx, { 1.0, 2.0 });
+  Value b = makeFloatArray(ctx, { 1.0, 3.0 });
+  Value c = makeFloatArray(ctx, { 5.0 });
+  Value n = makeFloatArray(ctx, { kNaN });
+  Value one = makeFloatArray(ctx, { 1.0 });
+  expect(compare(ctx, a, b) < 0, "compare [|1.; 2.|] [|1.; 3.|]");
+  expect(compare(ctx, c, a) < 0, "shorter float arrays are smaller");
+  expect(equal(ctx, a, makeFloatArray(ctx, { 1.0, 2.0 })), "equal arrays");
+  expect(
+      compare(ctx, makeFloatArray(ctx, { -0.0 }), makeFloatArray(ctx, { 0.0 }))
+          == 0,
+      "compare [|-0.|] [|0.|]"
+  );
+  expect(compare(ctx, n, one) < 0, "compare [|nan|] [|1.|]");
+  expect(compare(ctx, n, n) == 0, "compare [|nan|] [|nan|]");
+  expect(!equal(ctx, n, n), "[|nan|] = [|nan|]");
+  expect(!lessThan(ctx, n, one), "[|nan|] < [|1.|]");
+}
+
+static void testCustom(Context &ctx) {
+  // Boxed integers are compared as signed numbers of their width.
+  Value i32a = makeCustom<int32_t>(ctx, &int32_ops, -1);
+  Value i32b = makeCustom<int32_t>(ctx, &int32_ops, 1);
+  expect(compare(ctx, i32a, i32b) < 0, "compare (-1l) 1l");
+  expect(lessThan(ctx, i32a, i32b), "-1l < 1l");
+  expect(equal(ctx, i32a, makeCustom<int32_t>(ctx, &int32_ops, -1)), "-1l");
+
+  Value i64a = makeCustom<int64_t>(ctx, &int64_ops, INT64_MIN);
+  Value i64b = makeCustom<int64_t>(ctx, &int64_ops, INT64_MAX);
+  expect(compare(ctx, i64a, i64b) < 0, "compare Int64.min_int max_int");
+  expect(compare(ctx, i64b, i64a) > 0, "compare Int64.max_int min_int");
+  Value nia = makeCustom<int64_t>(ctx, &nativeint_ops, -3);
+  Value nib = makeCustom<int64_t>(ctx, &nativeint_ops, 7);
+  expect(compare(ctx, nia, nib) < 0, "compare (-3n) 7n");
+
+  // Values of different types are ordered by their identifiers.
+  expect(compare(ctx, i32b, i64a) < 0, "compare 1l Int64.min_int");
+
+  // Custom blocks without a comparison cannot be compared.
+  static CustomOperations opaque_ops = {
+    "opaque", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr
+  };
+  Value x = makeCustom<int64_t>(ctx, &opaque_ops, 0);
+  Value y = makeCustom<int64_t>(ctx, &opaque_ops, 0);
+  try {
+    compare(ctx, x, y);
+  } catch (std::runtime_error &e) {
+    expect(std::string(e.what()) == "compare: abstract value", e.what());
+    return;
+  }
+  throw std::runtime_error("compare of abstract values did not fail");
+}
+
+
+
+// -----------------------------------------------------------------------------
+int main() {
+  try {
+    Context ctx;
+    testCycles(ctx);
+    testNaN(ctx);
+    testStrings(ctx);
+    testFloatArrays(ctx);
+    testCustom(ctx);
+
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+  } catch (std::exception &e) {
+    std::cerr << "[Exception]: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
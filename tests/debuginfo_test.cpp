@@ -0,0 +1,83 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "miniml/BytecodeFile.h"
+#include "miniml/Context.h"
+#include "miniml/DebugInfo.h"
+#include "miniml/Memprof.h"
+#include "miniml/Profiler.h"
+#include "tests/TestDebugInfo.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+static void expect(const std::string &actual, const std::string &expected) {
+  if (actual != expected) {
+    throw std::runtime_error(
+        "expected \"" + expected + "\", got \"" + actual + "\""
+    );
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+int main() {
+  try {
+    Context ctx;
+    std::vector<uint8_t> data = makeDebugSection({
+      { 0, "Foo.bar", 1 },
+      { 8, "baz", 3 },
+      { 16, nullptr, 5 },
+    });
+    Section section(nullptr, data.data(), data.size(), DBUG);
+    DebugInfo info(ctx, &section);
+    auto sym = [&info](uint64_t pc) { return info.symbolize(pc); };
+
+    // Qualified names are kept, others are prefixed with the module.
+    expect(sym(0), "Foo.bar (foo.ml:1)");
+    expect(sym(1), "Foo.bar (foo.ml:1)");
+    expect(sym(2), "Foo.baz (foo.ml:3)");
+    expect(sym(4), "Foo (foo.ml:5)");
+
+    // Reports list frames from the outermost to the innermost.
+    const uint64_t stack[] = { 2, 0, 4 };
+    {
+      Profiler profiler(8);
+      profiler.record(stack, 3);
+      profiler.record(stack, 3);
+      std::ostringstream os;
+      profiler.write(os, sym);
+      expect(
+          os.str(),
+          "Foo (foo.ml:5);Foo.bar (foo.ml:1);Foo.baz (foo.ml:3) 2\n"
+      );
+    }
+    {
+      Memprof memprof(1.0, 8);
+      memprof.track(kUnit, false, 3, stack, 2);
+      std::ostringstream os;
+      memprof.write(os, Memprof::kAllocated, sym);
+      expect(os.str(), "Foo.bar (foo.ml:1);Foo.baz (foo.ml:3) 3\n");
+    }
+
+    // Without debug information, PCs are printed in hexadecimal.
+    DebugInfo empty(ctx, nullptr);
+    expect(empty.symbolize(26), "0x1a");
+
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+  } catch (std::exception &e) {
+    std::cerr << "[Exception]: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
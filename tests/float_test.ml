@@ -45,3 +45,44 @@ let print_array a =
 let () =
   print_array (fst b);
   print_array (fst c);
+
+let get (a : 'a array) i = a.(i)
+
+(* Chains of float primitives, ending in a box, a comparison or a store. *)
+let () =
+  let x = 3.0 and y = 4.0 in
+  assert (sqrt (x *. x +. y *. y) = 5.0);
+  assert (abs_float (-. x) -. floor 2.5 = 1.0);
+  assert (float_of_int 7 *. 0.5 = 3.5);
+  assert (x *. 2.0 < y +. 3.0);
+  assert (not (x /. 2.0 >= y));
+  assert (ceil (x /. 2.0) <= 2.0);
+  let n = nan in
+  assert (not (n +. 1.0 = n));
+  assert (n *. 2.0 <> n);
+  assert (not (n < 0.0) && not (n > 0.0));
+  let a = Array.make 16 1.0 in
+  for i = 0 to Array.length a - 1 do
+    a.(i) <- a.(i) *. float_of_int i +. 0.5
+  done;
+  for i = 0 to Array.length a - 1 do
+    assert (a.(i) = float_of_int i +. 0.5);
+    assert (get a i -. 0.5 = float_of_int i)
+  done;
+  let s = ref 0.0 in
+  for i = 0 to Array.length a - 1 do
+    if a.(i) *. 2.0 > 10.0 then s := !s +. Array.unsafe_get a i
+  done;
+  assert (!s = 5.5 +. 6.5 +. 7.5 +. 8.5 +. 9.5 +. 10.5 +. 11.5 +. 12.5 +.
+               13.5 +. 14.5 +. 15.5);
+;;
+
+(* Reads through polymorphic accessors must not unbox other arrays. *)
+let () =
+  let strs = [| "a"; "bc"; "def" |] in
+  assert (get strs 2 = "def");
+  let ints = [| 1; 2; 3 |] in
+  assert (get ints 1 + 1 = 3);
+  let floats = [| 1.5; 2.5 |] in
+  assert (get floats 1 +. get floats 0 = 4.0);
+;;
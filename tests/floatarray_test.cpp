@@ -0,0 +1,211 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "miniml/Context.h"
+#include "miniml/Value.h"
+using namespace miniml;
+
+extern "C" value caml_floatarray_fill(Context &, value, value, value, value);
+extern "C" value caml_floatarray_blit(
+    Context &, value, value, value, value, value);
+extern "C" value caml_floatarray_add(Context &, value, value, value);
+extern "C" value caml_floatarray_mul(Context &, value, value, value);
+extern "C" value caml_floatarray_axpy(Context &, value, value, value);
+extern "C" value caml_floatarray_dot(Context &, value, value);
+extern "C" value caml_floatarray_sum(Context &, value);
+extern "C" value caml_floatarray_min(Context &, value);
+extern "C" value caml_floatarray_max(Context &, value);
+
+static const double kInf = std::numeric_limits<double>::infinity();
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/// Lengths covering the vector loops and all tails modulo 4 and 8.
+static const size_t kMaxLength = 19;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static void expect(bool cond, const std::string &msg) {
+  if (!cond) {
+    throw std::runtime_error(msg);
+  }
+}
+
+/// Builds a float array. Empty arrays are atoms, as in OCaml.
+static Value makeArray(Context &ctx, const std::vector<double> &elems) {
+  if (elems.empty()) {
+    return ctx.allocBlock(0, 0);
+  }
+  Value array = ctx.allocBlock(elems.size(), kDoubleArrayTag);
+  for (size_t i = 0; i < elems.size(); ++i) {
+    val_field(array, i) = dbl_to_val(elems[i]);
+  }
+  return array;
+}
+
+static double get(value array, size_t i) {
+  return val_to_dbl(val_field(array, i));
+}
+
+/// Integer-valued elements, so sums are exact in any order.
+static std::vector<double> iota(size_t n, double start) {
+  std::vector<double> elems;
+  for (size_t i = 0; i < n; ++i) {
+    elems.push_back(start + i);
+  }
+  return elems;
+}
+
+/// Checks that a primitive throws.
+template <typename F>
+static void expectThrow(F f, const std::string &msg) {
+  try {
+    f();
+  } catch (std::runtime_error &) {
+    return;
+  }
+  throw std::runtime_error(msg);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Tests
+// -----------------------------------------------------------------------------
+static void testArithmetic(Context &ctx) {
+  for (size_t n = 0; n <= kMaxLength; ++n) {
+    const std::string at = " at length " + std::to_string(n);
+    Value a = makeArray(ctx, iota(n, 1.0));
+    Value b = makeArray(ctx, iota(n, -3.0));
+    Value dst = makeArray(ctx, std::vector<double>(n, 0.0));
+
+    caml_floatarray_add(ctx, dst, a, b);
+    for (size_t i = 0; i < n; ++i) {
+      expect(get(dst, i) == 2.0 * i - 2.0, "wrong add" + at);
+    }
+    caml_floatarray_mul(ctx, dst, a, b);
+    for (size_t i = 0; i < n; ++i) {
+      expect(get(dst, i) == (1.0 + i) * (i - 3.0), "wrong mul" + at);
+    }
+    caml_floatarray_axpy(ctx, ctx.allocDouble(2.0), a, b);
+    for (size_t i = 0; i < n; ++i) {
+      expect(get(b, i) == 3.0 * i - 1.0, "wrong axpy" + at);
+    }
+
+    double dot = 0.0, sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+      dot += (1.0 + i) * (3.0 * i - 1.0);
+      sum += 1.0 + i;
+    }
+    expect(val_to_double(caml_floatarray_dot(ctx, a, b)) == dot, "dot" + at);
+    expect(val_to_double(caml_floatarray_sum(ctx, a)) == sum, "sum" + at);
+
+    Value half = ctx.allocDouble(0.5);
+    caml_floatarray_fill(ctx, dst, val_int64(0), val_int64(n), half);
+    for (size_t i = 0; i < n; ++i) {
+      expect(get(dst, i) == 0.5, "wrong fill" + at);
+    }
+  }
+}
+
+static void testMinMax(Context &ctx) {
+  // The minimum of an empty array is infinity, the maximum -infinity.
+  Value empty = makeArray(ctx, {});
+  expect(val_to_double(caml_floatarray_min(ctx, empty)) == kInf, "empty min");
+  expect(val_to_double(caml_floatarray_max(ctx, empty)) == -kInf, "empty max");
+  expect(val_to_double(caml_floatarray_sum(ctx, empty)) == 0.0, "empty sum");
+
+  // NaNs are skipped, in the vector loop and in the tail.
+  for (size_t n = 1; n <= kMaxLength; ++n) {
+    for (size_t nan = 0; nan < n; ++nan) {
+      const std::string at =
+          " at length " + std::to_string(n) + ", NaN " + std::to_string(nan);
+      std::vector<double> elems = iota(n, -5.0);
+      const double lo = nan == 0 ? -4.0 : -5.0;
+      const double hi = nan == n - 1 ? n - 7.0 : n - 6.0;
+      elems[nan] = kNaN;
+      Value a = makeArray(ctx, elems);
+      const double min = val_to_double(caml_floatarray_min(ctx, a));
+      const double max = val_to_double(caml_floatarray_max(ctx, a));
+      if (n == 1) {
+        expect(min == kInf && max == -kInf, "only NaN" + at);
+      } else {
+        expect(min == lo, "wrong min" + at);
+        expect(max == hi, "wrong max" + at);
+      }
+    }
+  }
+}
+
+static void testBounds(Context &ctx) {
+  Value a = makeArray(ctx, iota(10, 0.0));
+  Value b = makeArray(ctx, iota(10, 0.0));
+  Value v = ctx.allocDouble(1.0);
+  auto fill = [&](int64_t ofs, int64_t len) {
+    caml_floatarray_fill(ctx, a, val_int64(ofs), val_int64(len), v);
+  };
+  auto blit = [&](int64_t ofs1, int64_t ofs2, int64_t len) {
+    caml_floatarray_blit(
+        ctx, a, val_int64(ofs1), b, val_int64(ofs2), val_int64(len));
+  };
+
+  fill(10, 0);
+  fill(0, 10);
+  blit(0, 0, 10);
+  blit(10, 10, 0);
+  expectThrow([&] { fill(-1, 1); }, "fill with a negative offset");
+  expectThrow([&] { fill(0, -1); }, "fill with a negative length");
+  expectThrow([&] { fill(5, 6); }, "fill past the end");
+  expectThrow([&] { fill(11, 0); }, "fill at an offset past the end");
+  expectThrow([&] { blit(0, 1, 10); }, "blit past the end of the target");
+  expectThrow([&] { blit(1, 0, 10); }, "blit past the end of the source");
+
+  // Ranges are checked without adding the offset to the length.
+  const int64_t maxInt = (INT64_C(1) << 62) - 1;
+  expectThrow([&] { fill(2, maxInt); }, "fill with the largest length");
+  expectThrow([&] { blit(2, 0, maxInt); }, "blit with the largest length");
+}
+
+static void testTags(Context &ctx) {
+  Value block = ctx.allocBlock(2, 0);
+  val_field(block, 0) = val_int64(1);
+  val_field(block, 1) = val_int64(2);
+  Value a = makeArray(ctx, { 1.0, 2.0 });
+  expectThrow([&] { caml_floatarray_sum(ctx, block); }, "sum of a block");
+  expectThrow([&] { caml_floatarray_min(ctx, block); }, "min of a block");
+  expectThrow([&] { caml_floatarray_dot(ctx, a, block); }, "dot of a block");
+  expectThrow([&] { caml_floatarray_add(ctx, block, a, a); }, "add to a block");
+  expectThrow([&] {
+    caml_floatarray_fill(
+        ctx, block, val_int64(0), val_int64(1), ctx.allocDouble(0.0));
+  }, "fill of a block");
+}
+
+
+
+// -----------------------------------------------------------------------------
+int main() {
+  try {
+    Context ctx;
+    testArithmetic(ctx);
+    testMinMax(ctx);
+    testBounds(ctx);
+    testTags(ctx);
+
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+  } catch (std::exception &e) {
+    std::cerr << "[Exception]: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,100 @@
+external fill : floatarray -> int -> int -> float -> unit
+  = "caml_floatarray_fill"
+external blit : floatarray -> int -> floatarray -> int -> int -> unit
+  = "caml_floatarray_blit"
+external add : floatarray -> floatarray -> floatarray -> unit
+  = "caml_floatarray_add"
+external mul : floatarray -> floatarray -> floatarray -> unit
+  = "caml_floatarray_mul"
+external axpy : float -> floatarray -> floatarray -> unit
+  = "caml_floatarray_axpy"
+external dot : floatarray -> floatarray -> float = "caml_floatarray_dot"
+external sum : floatarray -> float = "caml_floatarray_sum"
+external min : floatarray -> float = "caml_floatarray_min"
+external max : floatarray -> float = "caml_floatarray_max"
+
+(* Elements are integers, so sums are exact in any order. *)
+let iota n start = Float.Array.init n (fun i -> start +. float_of_int i)
+
+(* Lengths cover the vector loops and all tails modulo 4 and 8. *)
+let () =
+  for n = 0 to 19 do
+    let a = iota n 1.0 and b = iota n (-3.0) in
+    let dst = Float.Array.make n 0.0 in
+    add dst a b;
+    Float.Array.iteri
+      (fun i x -> assert (x = 2.0 *. float_of_int i -. 2.0)) dst;
+    mul dst a b;
+    Float.Array.iteri (fun i x ->
+        let i = float_of_int i in
+        assert (x = (1.0 +. i) *. (i -. 3.0))) dst;
+    axpy 2.0 a b;
+    Float.Array.iteri
+      (fun i x -> assert (x = 3.0 *. float_of_int i -. 1.0)) b;
+    let d = ref 0.0 and s = ref 0.0 in
+    for i = 0 to n - 1 do
+      d := !d +. Float.Array.get a i *. Float.Array.get b i;
+      s := !s +. Float.Array.get a i
+    done;
+    assert (dot a b = !d);
+    assert (sum a = !s);
+  done;
+;;
+
+(* Fill and blit write the given range only. *)
+let () =
+  for n = 0 to 19 do
+    let a = Float.Array.make n 0.0 in
+    if n > 2 then begin
+      fill a 1 (n - 2) 1.5;
+      assert (Float.Array.get a 0 = 0.0);
+      assert (Float.Array.get a (n - 1) = 0.0);
+      for i = 1 to n - 2 do assert (Float.Array.get a i = 1.5) done;
+      let b = iota n 0.0 in
+      blit b 0 a 1 (n - 1);
+      for i = 1 to n - 1 do
+        assert (Float.Array.get a i = float_of_int (i - 1))
+      done;
+      blit a 1 a 0 (n - 1);
+      assert (Float.Array.get a 0 = 0.0);
+      assert (Float.Array.get a (n - 2) = float_of_int (n - 2));
+    end;
+    fill a 0 n 2.0;
+    Float.Array.iter (fun x -> assert (x = 2.0)) a;
+  done;
+;;
+
+(* NaNs are skipped by min and max; empty arrays give infinities. *)
+let () =
+  assert (min (Float.Array.create 0) = infinity);
+  assert (max (Float.Array.create 0) = neg_infinity);
+  assert (sum (Float.Array.create 0) = 0.0);
+  assert (dot (Float.Array.create 0) (Float.Array.create 0) = 0.0);
+  for n = 1 to 19 do
+    for k = 0 to n - 1 do
+      let a = iota n (-5.0) in
+      Float.Array.set a k nan;
+      let lo = if k = 0 then -4.0 else -5.0 in
+      let hi = float_of_int (if k = n - 1 then n - 7 else n - 6) in
+      if n = 1 then begin
+        assert (min a = infinity && max a = neg_infinity)
+      end else begin
+        assert (min a = lo);
+        assert (max a = hi)
+      end
+    done
+  done;
+;;
+
+(* Out of bounds ranges are rejected before the primitives are called. *)
+let () =
+  let a = Float.Array.make 10 0.0 in
+  let fails f = try f (); false with Invalid_argument _ -> true in
+  assert (fails (fun () -> Float.Array.fill a 5 6 1.0));
+  assert (fails (fun () -> Float.Array.fill a (-1) 1 1.0));
+  assert (fails (fun () -> Float.Array.fill a 2 max_int 1.0));
+  assert (fails (fun () -> Float.Array.blit a 1 a 0 10));
+  assert (fails (fun () -> Float.Array.blit a 0 a 2 max_int));
+;;
+
+let () = print_endline "OK";;
@@ -0,0 +1,132 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "miniml/BytecodeFile.h"
+#include "miniml/Context.h"
+#include "miniml/Opcode.h"
+#include "miniml/Value.h"
+#include "tests/TestBytecode.h"
+using namespace miniml;
+
+extern "C" value caml_hash(Context &, value, value, value, value);
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static void expect(bool cond, const std::string &msg) {
+  if (!cond) {
+    throw std::runtime_error(msg);
+  }
+}
+
+/// Hashes a value as Hashtbl.hash does.
+static int64_t hash(Context &ctx, value v) {
+  return val_to_int64(
+      caml_hash(ctx, val_int64(10), val_int64(100), val_int64(0), v)
+  );
+}
+
+/// Builds a closure with a code pointer and an environment of integers.
+static Value makeClosure(Context &ctx, uint64_t code, int64_t env) {
+  Value closure = ctx.allocBlock(2, kClosureTag);
+  closure.setCode(code);
+  val_field(closure, 1) = val_int64(env);
+  return closure;
+}
+
+static Value makeRecord(Context &ctx, value f, int64_t x) {
+  Value record = ctx.allocBlock(2, 0);
+  ctx.setField(record, 0, f);
+  ctx.setField(record, 1, val_int64(x));
+  return record;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Tests
+// -----------------------------------------------------------------------------
+/// Code pointers are hashed as integers, whether they look like pointers
+/// or not, and environments are hashed as values.
+static void testClosures(Context &ctx) {
+  for (uint64_t code : { 0x100, 0x101, 0x7FF0 }) {
+    Value f = makeClosure(ctx, code, 1);
+    Value g = makeClosure(ctx, code, 1);
+    Value h = makeClosure(ctx, code + 2, 1);
+    Value k = makeClosure(ctx, code, 2);
+    expect(hash(ctx, f) == hash(ctx, g), "closures hash by contents");
+    expect(hash(ctx, f) != hash(ctx, h), "code is hashed");
+    expect(hash(ctx, f) != hash(ctx, k), "environment is hashed");
+
+    Value r = makeRecord(ctx, f, 3);
+    Value s = makeRecord(ctx, g, 3);
+    Value t = makeRecord(ctx, f, 4);
+    expect(hash(ctx, r) == hash(ctx, s), "records hash by contents");
+    expect(hash(ctx, r) != hash(ctx, t), "record fields are hashed");
+  }
+}
+
+/// Mutually recursive functions built by CLOSUREREC share a block. The
+/// other functions are infix pointers into it, hashed with their offset.
+static void testRecursiveClosures(bool optimize) {
+  TestBytecode bc({
+    CONSTINT, 42,
+    CLOSUREREC, 2, 1, 13, 10,
+    CONST0,
+    PUSH,
+    ACC1,
+    APPLY1,
+    MAKEBLOCK, 3, 0,
+    STOP,
+    // g: returns the variable captured by the closures.
+    ENVACC1,
+    RETURN, 1,
+    // f: unused.
+    CONST1,
+    RETURN, 1,
+  }, {});
+  Context ctx;
+  ctx.setOptimize(optimize);
+  BytecodeFile file(bc.getPath());
+  Value result = ctx.run(file);
+
+  expect(val_to_int64(val_field(result, 0)) == 42, "g reads its environment");
+  value g = val_field(result, 1);
+  value f = val_field(result, 2);
+  expect(val_tag(f) == kClosureTag, "f is a closure");
+  expect(val_tag(g) == kInfixTag && val_size(g) == 2, "g is an infix block");
+  expect(g - f == 2 * sizeof(value), "g points into the block of f");
+
+  const int64_t hf = hash(ctx, f), hg = hash(ctx, g);
+  expect(hf != hg, "functions of a recursive definition hash differently");
+  expect(hash(ctx, g) == hg, "hashes of infix blocks are stable");
+  Value r = makeRecord(ctx, g, 0);
+  Value s = makeRecord(ctx, f, 0);
+  expect(hash(ctx, r) != hash(ctx, s), "records of infix blocks");
+}
+
+
+
+// -----------------------------------------------------------------------------
+int main() {
+  try {
+    Context ctx;
+    testClosures(ctx);
+    testRecursiveClosures(false);
+    testRecursiveClosures(true);
+
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+  } catch (std::exception &e) {
+    std::cerr << "[Exception]: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,35 @@
+let rec even n = if n = 0 then true else odd (n - 1)
+and odd n = if n = 0 then false else even (n - 1)
+
+type record = { name : string; f : int -> int }
+
+(* Closures are hashed by their code and environment. *)
+let () =
+  let id = fun x -> x in
+  assert (Hashtbl.hash id = Hashtbl.hash id);
+  let add n = fun x -> x + n in
+  assert (Hashtbl.hash (add 1) = Hashtbl.hash (add 1));
+  assert (Hashtbl.hash (add 1) <> Hashtbl.hash (add 2));
+;;
+
+(* Functions of a recursive definition are told apart by their offset. *)
+let () =
+  assert (even 10 && odd 7);
+  assert (Hashtbl.hash even = Hashtbl.hash even);
+  assert (Hashtbl.hash odd = Hashtbl.hash odd);
+  assert (Hashtbl.hash even <> Hashtbl.hash odd);
+;;
+
+(* Records holding functions can be used as keys. *)
+let () =
+  let a = { name = "a"; f = succ } and b = { name = "b"; f = pred } in
+  assert (Hashtbl.hash a = Hashtbl.hash { a with name = "a" });
+  assert (Hashtbl.hash a <> Hashtbl.hash b);
+  let t = Hashtbl.create 8 in
+  Hashtbl.replace t (Hashtbl.hash a) a;
+  Hashtbl.replace t (Hashtbl.hash b) b;
+  assert ((Hashtbl.find t (Hashtbl.hash a)).f 1 = 2);
+  assert ((Hashtbl.find t (Hashtbl.hash b)).f 1 = 0);
+;;
+
+let () = print_endline "OK";;
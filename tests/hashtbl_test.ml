@@ -0,0 +1,83 @@
+type ('a, 'b) t
+
+external create : int -> ('a, 'b) t = "caml_nhashtbl_create"
+external replace : ('a, 'b) t -> 'a -> 'b -> unit = "caml_nhashtbl_replace"
+external find_opt : ('a, 'b) t -> 'a -> 'b option = "caml_nhashtbl_find_opt"
+external mem : ('a, 'b) t -> 'a -> bool = "caml_nhashtbl_mem"
+external remove : ('a, 'b) t -> 'a -> unit = "caml_nhashtbl_remove"
+external length : ('a, 'b) t -> int = "caml_nhashtbl_length"
+external clear : ('a, 'b) t -> unit = "caml_nhashtbl_clear"
+
+(* Tables grow from any initial size, including nonsensical ones. *)
+let () =
+  List.iter
+    (fun size ->
+      let t = create size in
+      for i = 0 to 999 do
+        replace t i (i * i)
+      done;
+      assert (length t = 1000);
+      for i = 0 to 999 do
+        assert (find_opt t i = Some (i * i))
+      done;
+      assert (find_opt t 1000 = None))
+    [-1; 0; 1; 16; 100000; max_int];
+;;
+
+(* Removed slots are reused without losing entries probing past them. *)
+let () =
+  let t = create 16 in
+  for i = 0 to 9999 do
+    replace t (string_of_int i) i
+  done;
+  for i = 0 to 9999 do
+    if i mod 2 = 0 then remove t (string_of_int i)
+  done;
+  assert (length t = 5000);
+  for i = 0 to 9999 do
+    assert (mem t (string_of_int i) = (i mod 2 = 1))
+  done;
+  for round = 1 to 10 do
+    for i = 0 to 999 do
+      replace t ("new" ^ string_of_int i) round;
+      remove t ("new" ^ string_of_int i)
+    done
+  done;
+  assert (length t = 5000);
+  for i = 0 to 9999 do
+    if i mod 2 = 0 then replace t (string_of_int i) (-i)
+  done;
+  assert (length t = 10000);
+  assert (find_opt t "42" = Some (-42));
+  assert (find_opt t "43" = Some 43);
+  replace t "43" 0;
+  assert (length t = 10000 && find_opt t "43" = Some 0);
+  clear t;
+  assert (length t = 0 && not (mem t "43"));
+  replace t "43" 1;
+  assert (find_opt t "43" = Some 1);
+;;
+
+(* Structured keys are found by value, floats by total order. *)
+let () =
+  let t = create 0 in
+  replace t (1, "a") "tuple";
+  replace t (Some [1; 2; 3], "b") "list";
+  assert (find_opt t (1, "a") = Some "tuple");
+  assert (find_opt t (Some [1; 2; 3], "b") = Some "list");
+  assert (find_opt t (Some [1; 2], "b") = None);
+  let f = create 8 in
+  replace f nan "nan";
+  replace f 0.0 "zero";
+  replace f 1.5 "one and a half";
+  assert (find_opt f nan = Some "nan");
+  assert (find_opt f (-0.0) = Some "zero");
+  assert (find_opt f (3.0 /. 2.0) = Some "one and a half");
+  replace f (0.0 /. 0.0) "still nan";
+  assert (length f = 3);
+  assert (find_opt f nan = Some "still nan");
+  remove f nan;
+  assert (not (mem f nan) && length f = 2);
+;;
+
+let () = print_endline "OK";;
@@ -0,0 +1,89 @@
+external format_int : string -> int -> string = "caml_format_int"
+external format_float : string -> float -> string = "caml_format_float"
+external int_of_string : string -> int = "caml_int_of_string"
+external float_of_string : string -> float = "caml_float_of_string"
+
+(* Integers are formatted directly or with flags through the C library. *)
+let () =
+  assert (format_int "%d" 0 = "0");
+  assert (format_int "%d" min_int = "-4611686018427387904");
+  assert (format_int "%d" max_int = "4611686018427387903");
+  assert (format_int "%i" (-42) = "-42");
+  assert (format_int "%x" (-1) = "7fffffffffffffff");
+  assert (format_int "%x" min_int = "4000000000000000");
+  assert (format_int "%X" 255 = "FF");
+  assert (format_int "%o" 8 = "10");
+  assert (format_int "%u" (-1) = "9223372036854775807");
+  assert (format_int "%5d" 42 = "   42");
+  assert (format_int "%-5d" 42 = "42   ");
+  assert (format_int "%05x" 255 = "000ff");
+  assert (format_int "%+d" 7 = "+7");
+  assert (string_of_int min_int = "-4611686018427387904");
+;;
+
+(* Prefixes select the base, underscores are skipped, and non-decimal
+   numbers wrap around into the negative range. *)
+let () =
+  assert (int_of_string "-4611686018427387904" = min_int);
+  assert (int_of_string "4611686018427387903" = max_int);
+  assert (int_of_string "+5" = 5);
+  assert (int_of_string "-0" = 0);
+  assert (int_of_string "1_000_000" = 1000000);
+  assert (int_of_string "0x3fffffffffffffff" = max_int);
+  assert (int_of_string "0x7fffffffffffffff" = -1);
+  assert (int_of_string "0X1F" = 31);
+  assert (int_of_string "-0x1" = -1);
+  assert (int_of_string "0o17" = 15);
+  assert (int_of_string "0b1010" = 10);
+  assert (int_of_string "0b1_0" = 2);
+  assert (int_of_string "0u42" = 42);
+  assert (int_of_string "0u9223372036854775807" = -1);
+  for i = -1000 to 1000 do
+    let n = i * 4611686018427387 in
+    assert (int_of_string (format_int "%d" n) = n);
+    assert (int_of_string ("0x" ^ format_int "%x" n) = n)
+  done;
+;;
+
+(* Short decimals take the fast path, everything else goes to strtod. *)
+let () =
+  assert (float_of_string "3.25" = 3.25);
+  assert (float_of_string "-0.5e2" = -50.0);
+  assert (float_of_string "1_000.5" = 1000.5);
+  assert (float_of_string "123456789012345" = 123456789012345.0);
+  assert (float_of_string ".5" = 0.5);
+  assert (float_of_string "7." = 7.0);
+  assert (1.0 /. float_of_string "-0.0" = neg_infinity);
+  assert (float_of_string "1e22" = 1e22);
+  assert (float_of_string "1e23" = 1e23);
+  assert (float_of_string "0.1e-22" = 1e-23);
+  assert (float_of_string "9007199254740993" = 9007199254740992.0);
+  assert (float_of_string "1234567890.123456789" = 1234567890.123456789);
+  assert (float_of_string "2.2250738585072011e-308" = 2.2250738585072011e-308);
+  assert (float_of_string "4.9e-324" = 4.9e-324);
+  assert (float_of_string "0x1.8p1" = 3.0);
+  assert (float_of_string "1e400" = infinity);
+  assert (float_of_string "-inf" = neg_infinity);
+  let n = float_of_string "nan" in
+  assert (n <> n);
+;;
+
+(* Floats round-trip through their shortest exact representation. *)
+let () =
+  assert (format_float "%.12g" 0.1 = "0.1");
+  assert (format_float "%.17g" 0.1 = "0.10000000000000001");
+  assert (format_float "%.3e" 12345.678 = "1.235e+04");
+  assert (format_float "%g" 1e-5 = "1e-05");
+  assert (String.length (format_float "%f" 1e300) = 308);
+  assert (string_of_float 1.5 = "1.5");
+  let x = ref 1.0 in
+  for i = 1 to 2000 do
+    x := !x *. 1.0137 +. float_of_int i *. 1e-7;
+    let s = format_float "%.17g" !x in
+    assert (float_of_string s = !x);
+    let y = 1.0 /. !x in
+    assert (float_of_string (format_float "%.17g" y) = y)
+  done;
+;;
+
+let () = print_endline "OK";;
@@ -0,0 +1,184 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "miniml/BytecodeFile.h"
+#include "miniml/Context.h"
+#include "miniml/DebugInfo.h"
+#include "miniml/Opcode.h"
+#include "miniml/Optimizer.h"
+#include "tests/TestBytecode.h"
+#include "tests/TestDebugInfo.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static std::string toString(const std::vector<uint32_t> &code) {
+  std::ostringstream os;
+  for (size_t i = 0; i < code.size(); ++i) {
+    os << (i ? " " : "") << static_cast<int32_t>(code[i]);
+  }
+  return os.str();
+}
+
+static void expect(bool cond, const std::string &msg) {
+  if (!cond) {
+    throw std::runtime_error(msg);
+  }
+}
+
+/// Optimizes a program, checking the result.
+static std::vector<uint32_t> optimize(
+    const std::vector<uint32_t> &code,
+    const std::vector<uint32_t> &expected,
+    std::vector<uint32_t> &pcMap)
+{
+  std::vector<uint32_t> optimized;
+  optimizeCode(code.data(), code.size(), optimized, pcMap);
+  expect(
+      optimized == expected,
+      "expected " + toString(expected) + ", got " + toString(optimized)
+  );
+  expect(pcMap.size() == code.size() + 1, "invalid PC map");
+  return optimized;
+}
+
+/// Checks that a program returns the same integer with and without the
+/// optimizer, returning it.
+static int64_t run(const std::vector<uint32_t> &code) {
+  TestBytecode bc({ code.begin(), code.end() }, {});
+  int64_t result[2];
+  for (bool optimize : { false, true }) {
+    Context ctx;
+    ctx.setOptimize(optimize);
+    BytecodeFile file(bc.getPath());
+    Value value = ctx.run(file);
+    expect(value.isInt64(), "result is not an integer");
+    result[optimize] = value.getInt64();
+  }
+  expect(result[0] == result[1], "optimized program returned another value");
+  return result[0];
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Tests
+// -----------------------------------------------------------------------------
+/// Branches on constants are folded as the interpreter evaluates them: the
+/// 32-bit operand is not sign-extended, so -1 is not equal to 0xFFFFFFFF.
+static void testFoldBranch() {
+  std::vector<uint32_t> pcMap;
+  for (uint32_t op : { BEQ, BNEQ }) {
+    const std::vector<uint32_t> code = {
+      CONSTINT, static_cast<uint32_t>(-1),
+      op, 0xFFFFFFFF, 3,
+      CONST0,
+      STOP,
+      CONST1,
+      STOP,
+    };
+    const bool taken = op == BNEQ;
+    optimize(code, {
+      CONSTINT, static_cast<uint32_t>(-1),
+      taken ? CONST1 : CONST0,
+      STOP,
+    }, pcMap);
+    expect(run(code) == taken, "wrong branch taken");
+  }
+}
+
+/// Chains of jumps are threaded to their final target.
+static void testThreadBranches() {
+  const std::vector<uint32_t> code = {
+    BRANCH, 5,
+    CONST0,
+    STOP,
+    BRANCH, static_cast<uint32_t>(-3),
+    BRANCH, static_cast<uint32_t>(-3),
+  };
+  std::vector<uint32_t> pcMap;
+  optimize(code, { CONST0, STOP }, pcMap);
+  expect(pcMap[0] == 0 && pcMap[2] == 0 && pcMap[3] == 1, "wrong PC map");
+  expect(run(code) == 0, "wrong result");
+}
+
+/// The RESTART before a GRAB is unreachable in the code, but is kept since
+/// partial applications resume there.
+static void testKeepRestart() {
+  const std::vector<uint32_t> code = {
+    CLOSURE, 0, 13,
+    PUSHCONSTINT, 5,
+    PUSH,
+    ACC1,
+    APPLY1,
+    PUSHCONSTINT, 7,
+    PUSH,
+    ACC1,
+    APPLY1,
+    STOP,
+    RESTART,
+    GRAB, 1,
+    ACC0,
+    RETURN, 2,
+  };
+  std::vector<uint32_t> pcMap;
+  std::vector<uint32_t> optimized;
+  optimizeCode(code.data(), code.size(), optimized, pcMap);
+  expect(optimized[pcMap[14]] == RESTART, "RESTART was removed");
+  expect(optimized[pcMap[15]] == GRAB, "GRAB was removed");
+  expect(run(code) == 5, "wrong result of the partial application");
+}
+
+/// Debug events are moved to the new PCs of their instructions.
+static void testMoveEvents() {
+  const std::vector<uint32_t> code = {
+    BRANCH, 1,
+    CONST1,
+    BRANCH, 1,
+    CONST0,
+    STOP,
+  };
+  std::vector<uint32_t> pcMap;
+  optimize(code, { CONST1, CONST0, STOP }, pcMap);
+
+  Context ctx;
+  std::vector<uint8_t> data = makeDebugSection({
+    { 2 * 4, "Foo.f", 10 },
+    { 5 * 4, "Foo.g", 20 },
+  });
+  Section section(nullptr, data.data(), data.size(), DBUG);
+  DebugInfo info(ctx, &section);
+  info.setCodeMap(std::move(pcMap));
+  expect(info.symbolize(0) == "Foo.f (foo.ml:10)", "wrong event at PC 0");
+  expect(info.symbolize(1) == "Foo.g (foo.ml:20)", "wrong event at PC 1");
+  expect(info.symbolize(2) == "Foo.g (foo.ml:20)", "wrong event at PC 2");
+}
+
+
+
+// -----------------------------------------------------------------------------
+int main() {
+  try {
+    testFoldBranch();
+    testThreadBranches();
+    testKeepRestart();
+    testMoveEvents();
+
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+  } catch (std::exception &e) {
+    std::cerr << "[Exception]: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
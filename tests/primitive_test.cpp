@@ -0,0 +1,72 @@
+// This file is part of the miniml project.
+// Licensing information can be found in the LICENSE file.
+// (C) Nandor Licker. All rights reserved.
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "miniml/BytecodeFile.h"
+#include "miniml/Context.h"
+#include "miniml/Opcode.h"
+#include "tests/TestBytecode.h"
+using namespace miniml;
+
+
+
+// -----------------------------------------------------------------------------
+/// Runs a program, returning the message of the error it fails with.
+static std::string runFailing(const TestBytecode &bc, bool optimize) {
+  Context ctx;
+  ctx.setOptimize(optimize);
+  BytecodeFile file(bc.getPath());
+  try {
+    ctx.run(file);
+  } catch (std::runtime_error &e) {
+    return e.what();
+  }
+  throw std::runtime_error("program did not fail");
+}
+
+static void expect(const std::string &actual, const std::string &expected) {
+  if (actual != expected) {
+    throw std::runtime_error(
+        "expected \"" + expected + "\", got \"" + actual + "\""
+    );
+  }
+}
+
+
+
+// -----------------------------------------------------------------------------
+int main() {
+  try {
+    // Missing primitives are reported by name when called, both from the
+    // bytecode and from functions translated to register code.
+    TestBytecode call({ CONST0, C_CALL1, 1, STOP }, { "caml_foo", "caml_bar" });
+    TestBytecode apply({
+      CLOSURE, 0, 6,
+      PUSHCONST0,
+      PUSH,
+      ACC1,
+      APPLY1,
+      STOP,
+      ACC0,
+      C_CALL1, 0,
+      RETURN, 1,
+    }, { "caml_foo" });
+    expect(runFailing(call, false), "Undefined primitive caml_bar at 0x3");
+    expect(runFailing(apply, false), "Undefined primitive caml_foo at 0xb");
+
+    // The optimizer moves code, so only the names are checked.
+    const std::string msg = "Undefined primitive caml_foo at ";
+    expect(runFailing(apply, true).substr(0, msg.size()), msg);
+
+    std::cout << "OK" << std::endl;
+    return EXIT_SUCCESS;
+  } catch (std::exception &e) {
+    std::cerr << "[Exception]: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,140 @@
+(* Loops are translated to register code, polling at their heads. *)
+let () =
+  let sum = ref 0 in
+  for i = 1 to 100000 do
+    sum := !sum + i * i mod 7
+  done;
+  assert (!sum = 200003);
+  let i = ref 0 and acc = ref 1 in
+  while !i < 20 do
+    acc := !acc * 2 + !i;
+    incr i
+  done;
+  assert (!acc = 2097131);
+;;
+
+type t = A | B | C of int | D of string | E of int * int | F
+
+let classify = function
+  | A -> 1
+  | B -> 2
+  | C n -> n
+  | D s -> String.length s
+  | E (x, y) -> x - y
+  | F -> 6
+;;
+
+let digit n =
+  match n with
+  | 0 -> "zero"
+  | 1 -> "one"
+  | 2 -> "two"
+  | 3 -> "three"
+  | 4 -> "four"
+  | _ -> "many"
+;;
+
+(* SWITCH over constant and non-constant constructors. *)
+let () =
+  let total = ref 0 in
+  List.iter
+    (fun v -> total := !total + classify v)
+    [A; B; C 10; D "abcd"; E (9, 4); F; A];
+  assert (!total = 1 + 2 + 10 + 4 + 5 + 6 + 1);
+  assert (digit 0 = "zero");
+  assert (digit 3 = "three");
+  assert (digit 4 = "four");
+  assert (digit 7 = "many");
+  assert (digit (-1) = "many");
+;;
+
+(* Division and closures exit to the bytecode, which resumes the register
+   code after the next call with the values computed before the exit. *)
+let mixed x =
+  let a = x * 3 in
+  let b = a + 1 in
+  let q = a / (x - 1) in
+  let f y = y + a in
+  let s = string_of_int b in
+  let c = f q + String.length s in
+  a + b + c
+;;
+
+let () =
+  assert (mixed 5 = 15 + 16 + (3 + 15 + 2));
+  let r = ref 0 in
+  for i = 2 to 1000 do
+    r := !r + mixed i mod 10
+  done;
+  let expected = ref 0 in
+  for i = 2 to 1000 do
+    let a = i * 3 in
+    let b = a + 1 in
+    let c = a / (i - 1) + a + String.length (string_of_int b) in
+    expected := !expected + (a + b + c) mod 10
+  done;
+  assert (!r = !expected);
+;;
+
+(* Allocations trigger collections while values are held in registers. *)
+let () =
+  let keep = ref [] in
+  for i = 0 to 200000 do
+    let a = (i, i + 1) in
+    let b = Some a in
+    let c = [| i; i * 2 |] in
+    let d = Int64.of_int i in
+    if i mod 1000 = 0 then keep := (a, b, c, d) :: !keep
+  done;
+  assert (List.length !keep = 201);
+  List.iter
+    (fun ((x, y), b, c, d) ->
+      assert (y = x + 1);
+      assert (b = Some (x, y));
+      assert (c.(0) = x && c.(1) = 2 * x);
+      assert (Int64.to_int d = x))
+    !keep;
+;;
+
+let () =
+  let p = (1, "x") in
+  for i = 1 to 100 do
+    let q = (i, p) in
+    let r = [i; i + 1] in
+    Gc.minor ();
+    assert (fst q = i && snd q == p);
+    assert (r = [i; i + 1]);
+    if i mod 10 = 0 then Gc.full_major ();
+    assert (snd p = "x");
+  done;
+;;
+
+(* Exceptions raised from loops and by division reach the handlers. *)
+exception Found of int
+
+let find a x =
+  try
+    for i = 0 to Array.length a - 1 do
+      if a.(i) = x then raise (Found i)
+    done;
+    -1
+  with Found i -> i
+;;
+
+let () =
+  assert (find [| 3; 5; 7 |] 7 = 2);
+  assert (find [| 3; 5; 7 |] 3 = 0);
+  assert (find [| 3 |] 4 = -1);
+  let caught = ref 0 in
+  for i = 0 to 9 do
+    let v = i * 2 in
+    try
+      ignore (v / (i mod 3));
+    with Division_by_zero ->
+      assert (v = i * 2);
+      incr caught
+  done;
+  assert (!caught = 4);
+;;
+
+let () = print_endline "OK";;
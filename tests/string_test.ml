@@ -0,0 +1,81 @@
+external string_equal : string -> string -> bool = "caml_string_equal"
+external string_notequal : string -> string -> bool = "caml_string_notequal"
+external bytes_equal : bytes -> bytes -> bool = "caml_bytes_equal"
+external index : string -> int -> char -> int = "caml_bytes_index"
+external rindex : string -> int -> char -> int = "caml_bytes_rindex"
+external get16 : string -> int -> int = "caml_string_get16"
+external get32 : string -> int -> int32 = "caml_string_get32"
+external get64 : string -> int -> int64 = "caml_string_get64"
+external set16 : bytes -> int -> int -> unit = "caml_bytes_set16"
+external set32 : bytes -> int -> int32 -> unit = "caml_bytes_set32"
+external set64 : bytes -> int -> int64 -> unit = "caml_bytes_set64"
+
+(* Strings are compared a word at a time, including the padding. *)
+let () =
+  assert (string_equal "" "");
+  assert (string_equal "abc" ("ab" ^ "c"));
+  assert (not (string_equal "abc" "abd"));
+  assert (not (string_equal "abcdefg" "abcdefgh"));
+  assert (string_equal "abcdefgh" (String.make 1 'a' ^ "bcdefgh"));
+  assert (string_notequal "abcdefghi" "abcdefghj");
+  assert (not (string_notequal "x" "x"));
+  assert (bytes_equal (Bytes.make 9 'z') (Bytes.of_string "zzzzzzzzz"));
+  assert (not (bytes_equal (Bytes.make 9 'z') (Bytes.make 10 'z')));
+;;
+
+(* Searches return -1 if the byte is not found in the range. *)
+let () =
+  let s = "abcabc" in
+  assert (index s 0 'c' = 2);
+  assert (index s 3 'a' = 3);
+  assert (index s 4 'a' = -1);
+  assert (index s 6 'a' = -1);
+  assert (index "" 0 'a' = -1);
+  assert (rindex s 5 'a' = 3);
+  assert (rindex s 2 'a' = 0);
+  assert (rindex s 5 'z' = -1);
+  assert (rindex s (-1) 'a' = -1);
+  let long = String.make 1000 'x' ^ "y" ^ String.make 1000 'x' in
+  assert (index long 0 'y' = 1000);
+  assert (rindex long 2000 'y' = 1000);
+  assert (rindex long 999 'y' = -1);
+;;
+
+(* Fixed-width accesses are little-endian and need not be aligned. *)
+let () =
+  let s = "\001\002\003\004\005\006\007\008\009\255" in
+  assert (get16 s 0 = 0x0201);
+  assert (get16 s 8 = 0xff09);
+  assert (get32 s 1 = 0x05040302l);
+  assert (get32 s 6 = 0xff090807l);
+  assert (get64 s 0 = 0x0807060504030201L);
+  assert (get64 s 1 = 0x0908070605040302L);
+  assert (get64 s 2 = 0xff09080706050403L);
+  let b = Bytes.make 11 '\000' in
+  set16 b 1 0xbeef;
+  assert (get16 (Bytes.to_string b) 1 = 0xbeef);
+  assert (Bytes.get b 1 = '\xef' && Bytes.get b 2 = '\xbe');
+  set32 b 3 (-2l);
+  assert (get32 (Bytes.to_string b) 3 = -2l);
+  set64 b 3 0x0123456789abcdefL;
+  assert (get64 (Bytes.to_string b) 3 = 0x0123456789abcdefL);
+  assert (Bytes.get b 3 = '\xef' && Bytes.get b 10 = '\x01');
+  set64 b 2 Int64.min_int;
+  assert (get64 (Bytes.to_string b) 2 = Int64.min_int);
+  assert (Bytes.get b 1 = '\xef');
+;;
+
+(* Bounds are checked before the primitives are reached. *)
+let () =
+  let raises f =
+    try ignore (f ()); false with Invalid_argument _ -> true
+  in
+  assert (raises (fun () -> String.sub "abc" 2 5));
+  assert (raises (fun () -> String.sub "abc" (-1) 1));
+  assert (raises (fun () -> Bytes.blit_string "abc" 0 (Bytes.create 2) 0 3));
+  assert (raises (fun () -> String.index_from "abc" 4 'a'));
+  assert (raises (fun () -> String.rindex_from "abc" 3 'a'));
+  assert (try ignore (String.index "abc" 'z'); false with Not_found -> true);
+;;
+
+let () = print_endline "OK";;
@@ -0,0 +1,30 @@
+let () =
+  let w = Weak.create 2 in
+  let live = String.make 4 'a' in
+  Weak.set w 0 (Some live);
+  Weak.set w 1 (Some (String.make 4 'b'));
+  Gc.full_major ();
+  assert (Weak.check w 0);
+  assert (not (Weak.check w 1));
+  assert (Weak.get w 0 = Some live);
+;;
+
+let () =
+  let e = Ephemeron.K1.create () in
+  let key = ref 0 in
+  Ephemeron.K1.set_key e key;
+  Ephemeron.K1.set_data e "data";
+  Gc.full_major ();
+  assert (Ephemeron.K1.get_data e = Some "data");
+  key := 1;
+;;
+
+let () =
+  let w = Weak.create 1 in
+  let boxed = 0x1234567890L in
+  Weak.set w 0 (Some boxed);
+  (* Custom blocks are returned shared instead of being copied. *)
+  assert (Weak.get_copy w 0 = Some boxed);
+  Gc.full_major ();
+  assert (Weak.get w 0 = Some boxed);
+;;